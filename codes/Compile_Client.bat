@@ -0,0 +1 @@
+g++ -O3 -g -I. -pthread -o SIC-XE-Client.exe stream.cpp utility.cpp stats.cpp allocations.cpp client.cpp SIC-XE-Client.cpp
\ No newline at end of file
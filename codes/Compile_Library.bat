@@ -0,0 +1 @@
+g++ -O3 -g -I. -pthread -shared -fPIC -fvisibility=hidden -DSICXE_BUILD -o SIC-XE.dll assembler.cpp stream.cpp utility.cpp hex.cpp symbol_table.cpp stats.cpp tokenizer.cpp macro.cpp object_file.cpp incremental.cpp one_pass.cpp pipeline.cpp sections.cpp relax.cpp expression.cpp equates.cpp thread_pool.cpp library.cpp
\ No newline at end of file
@@ -1 +1 @@
-g++ -O3 -g -I. -o SIC-XE.exe assembler.cpp stream.cpp utility.cpp SIC-XE.cpp 
\ No newline at end of file
+g++ -O3 -g -I. -pthread -o SIC-XE.exe assembler.cpp stream.cpp utility.cpp hex.cpp symbol_table.cpp stats.cpp allocations.cpp tokenizer.cpp macro.cpp batch.cpp object_file.cpp loader.cpp simulator.cpp incremental.cpp one_pass.cpp pipeline.cpp sections.cpp relax.cpp expression.cpp equates.cpp linker.cpp server.cpp client.cpp thread_pool.cpp SIC-XE.cpp
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include<client.hpp>
+#include<stream.hpp>
+#include<iostream>
+#include<vector>
+#ifndef _WIN32
+#include<unistd.h>
+#endif
+
+using namespace std;
+
+// relative paths are the client's, the server has a working directory of its own
+static string absolute_path(string path) {
+#ifndef _WIN32
+    char directory[4096];
+    if(!path.empty() && path[0] != '/' && getcwd(directory, sizeof(directory)) != nullptr) return string(directory) + '/' + path;
+#endif
+    return path;
+}
+
+int main(int argc, char** argv) {
+    string socket_path = default_server_socket;
+    unsigned int flags = REQUEST_LISTING;
+    bool on_server = false;
+    bool stop = false;
+    vector<string> files;
+
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg.rfind("--socket=", 0) == 0) {
+            socket_path = arg.substr(9);
+        } else if(arg == "--binary") {
+            flags |= REQUEST_BINARY;
+        } else if(arg == "--on-server") {
+            on_server = true;
+        } else if(arg == "--stop") {
+            stop = true;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if(!stop && files.size() != 2) {
+        cout << "Usage: " << argv[0] << " [--socket=path] [--binary] [--on-server] input file output file" << endl;
+        cout << "       " << argv[0] << " [--socket=path] --stop" << endl;
+        cout << "assembles on a server started with SIC-XE --serve; the source is sent and the outputs come back," << endl;
+        cout << "with --on-server the server reads and writes the files itself" << endl;
+        return 1;
+    }
+
+    AssemblerClient client;
+    if(!client.connect(socket_path)) {
+        cout << "Cannot connect to " << socket_path << endl;
+        return 2;
+    }
+    server_response response;
+    string object, listing, binary;
+    if(stop) {
+        if(!client.request(REQUEST_STOP, "", "", response, object, listing, binary)) return 2;
+        cout << "Server stopped" << endl;
+        return 0;
+    }
+
+    bool sent;
+    if(on_server) {
+        sent = client.request(flags | REQUEST_SOURCE_PATH | REQUEST_WRITE_FILES, absolute_path(files[0]), absolute_path(files[1]), response, object, listing, binary);
+    } else {
+        FileInputStream input(files[0]);
+        sent = client.request(flags, input.getContents(), "", response, object, listing, binary);
+        if(sent) {
+            FileOutputStream object_file(files[1] + ".obj"), listing_file(files[1] + ".lst");
+            object_file.write(object);
+            listing_file.write(listing);
+            if(flags & REQUEST_BINARY) {
+                FileOutputStream binary_file(files[1] + ".bin", true);
+                binary_file.write(binary);
+            }
+        }
+    }
+    if(!sent) {
+        cout << "The server closed the connection" << endl;
+        return 2;
+    }
+    if(response.error_flag > 0 && (response.error_flag & response_write_failed)) cout << "The server could not write " << files[1] << ".obj, .lst or .bin" << endl;
+    cout << (response.success ? "Assembled successfully" : "Failed to assemble") << endl;
+    cout << "Error flag: " << response.error_flag << endl;
+    return response.success ? 0 : 2;
+}
@@ -1,44 +1,312 @@
 #include<assembler.hpp>
+#include<batch.hpp>
+#include<linker.hpp>
+#include<server.hpp>
+#include<simulator.hpp>
 #include<fstream>
 #include<iostream>
 
 using namespace std;
 
+int assemble_batch(BatchAssembler &batch) {
+    cout << "Assembling " << batch.getJobs().size() << " programs..." << endl;
+    bool result = batch.run();
+
+    const vector<BatchAssembler::job> &jobs = batch.getJobs();
+    for(unsigned int i = 0; i < jobs.size(); i++) {
+        cout << jobs[i].input << " -> " << jobs[i].output << ": " << (jobs[i].success ? "Assembled successfully" : "Failed to assemble")
+            << ", error flag: " << jobs[i].error_flag << endl;
+    }
+    cout << (result ? "All programs assembled successfully" : "Some programs failed to assemble") << endl;
+    return result ? 0 : 2;
+}
+
+int run_program(string object, int load_address, const vector<pair<unsigned char, string> > &devices, unsigned long long limit) {
+    FileInputStream input(object);
+    Simulator simulator;
+    ObjectLoader loader(simulator.getMemory(), 1 << 20);
+    bool loaded = BinaryObjectView::isBinary(input.getContents()) ? simulator.loadBinary(loader, input.getContents(), load_address)
+        : simulator.load(loader, &input, load_address);
+    if(!loaded) {
+        cout << "Failed to load " << object << ", error flag: " << loader.getErrorFlag() << endl;
+        return 2;
+    }
+
+    // devices live until the run is over, so everything they wrote is flushed by then
+    vector<unique_ptr<FileDevice> > files;
+    for(unsigned int i = 0; i < devices.size(); i++) {
+        files.push_back(unique_ptr<FileDevice>(new FileDevice(devices[i].second)));
+        simulator.attach(devices[i].first, files.back().get());
+    }
+    bool result = simulator.run(limit);
+    files.clear();
+
+    cout << "Running " << loader.getName() << " at " << hex_field(loader.getStartAddress(), 6) << ": "
+        << (result ? "Halted" : "Stopped") << ", error flag: " << simulator.getErrorFlag() << endl;
+    cout << simulator.report();
+    return result ? 0 : 2;
+}
+
+int convert_object(string from, string to, unsigned int record_size) {
+    // the format of 'from' is told by its magic, 'to' gets the other one
+    FileInputStream input(from);
+    ObjectProgram program;
+    bool binary = BinaryObjectView::isBinary(input.getContents());
+    if(!(binary ? program.readBinary(input.getContents()) : program.readText(&input))) {
+        cout << "Failed to read " << from << ", error flag: " << program.getErrorFlag() << endl;
+        return 2;
+    }
+
+    FileOutputStream output(to, !binary);
+    if(binary) program.writeText(&output, record_size);
+    else program.writeBinary(&output);
+    output.flush();
+    cout << "Converted " << from << " to " << (binary ? "text" : "binary") << " object " << to << endl;
+    return 0;
+}
+
+int link_objects(const vector<string> &objects, string to, int load_address, bool binary, unsigned int record_size, unsigned int threads) {
+    // objects are mapped until the linked one is written, the linker reads them in place
+    vector<unique_ptr<FileInputStream> > inputs;
+    vector<unsigned char> memory(1 << 20);
+    LinkingLoader linker(memory.data(), memory.size());
+    ThreadPool pool(threads > 0 ? threads : 1);
+    if(threads > 1) linker.setThreadPool(&pool);
+    for(unsigned int i = 0; i < objects.size(); i++) {
+        inputs.push_back(unique_ptr<FileInputStream>(new FileInputStream(objects[i])));
+        linker.addObject(inputs.back()->getContents());
+    }
+
+    if(!linker.link(load_address >= 0 ? load_address : 0)) {
+        cout << "Failed to link " << objects[linker.getErrorModule()] << ", error flag: " << linker.getErrorFlag() << endl;
+        return 2;
+    }
+    FileOutputStream output(to, binary);
+    if(!linker.writeObject(&output, binary, record_size)) {
+        cout << "Cannot relocate the linked program, a field subtracts an address" << endl;
+        return 2;
+    }
+    output.flush();
+    cout << "Linked " << objects.size() << " objects, " << linker.getSectionCount() << " sections, " << linker.getSymbolCount()
+        << " external symbols into " << to << " at " << hex_field(linker.getStartAddress(), 6) << ", length " << hex_field(linker.getProgramLength(), 6) << endl;
+    return 0;
+}
+
+int serve(string socket_path, unsigned int threads) {
+    AssemblerServer server(threads > 0 ? threads : 1);
+    if(!server.listen(socket_path)) {
+        cout << "Cannot listen on " << socket_path << endl;
+        return 2;
+    }
+    cout << "Serving on " << socket_path << " with " << max(threads, 1u) << " assembler(s)" << endl;
+    server.run();
+    cout << "Served " << server.getRequestCount() << " requests" << endl;
+    return 0;
+}
+
+int usage(const char *program) {
+    cout << "Usage: " << program << " [--stats[=json]] [--pipeline] [--relax] [--record-size=N] [--binary[=symbols]] [input file] [output file]" << endl;
+    cout << "       " << program << " [--stats[=json]] --one-pass [--record-size=N] [input file output file]" << endl;
+    cout << "       " << program << " [--stats[=json]] [--jobs=N] --batch input files..." << endl;
+    cout << "       " << program << " [--stats[=json]] [--jobs=N] --manifest=file [input files...]" << endl;
+    cout << "       " << program << " --run [--load=address] [--device=XX=file]... [--limit=N] object file" << endl;
+    cout << "       " << program << " --convert [--record-size=N] object file output file" << endl;
+    cout << "       " << program << " [--jobs=N] --link [--load=address] [--binary] [--record-size=N] output file object files..." << endl;
+    cout << "       " << program << " [--jobs=N] --serve[=socket]" << endl;
+    cout << "--pipeline reads and writes on threads of their own while assembling" << endl;
+    cout << "--relax makes instructions written without '+' format 4 where format 3 cannot reach their operand" << endl;
+    cout << "--record-size=N writes text records of up to N bytes, 30 by default, from 4 to 255" << endl;
+    cout << "--binary also writes a binary object, with the symbol table if =symbols; --convert turns a text object into a binary one and back" << endl;
+    cout << "--link links objects with external symbols into one object, a binary one with --binary" << endl;
+    cout << "--serve assembles requests of SIC-XE-Client on a Unix domain socket, with N assemblers kept warm" << endl;
+    cout << "--stats prints phase times and counters to stderr" << endl;
+    return 1;
+}
+
+void print_stats(int stats) {
+    // stderr, so the report never mixes with an object program written to stdout
+    if(stats > 0) cerr << Stats::report(stats == 2);
+}
+
 int main(int argc, char** argv) {
     InputStream* input;
-    fstream* intermediate;
+    ofstream* intermediate;
     OutputStream* output_object;
     OutputStream* output_listing;
+    OutputStream* object_file = nullptr;
+    OutputStream* listing_file = nullptr;
+    OutputStream* binary_file = nullptr;
+    vector<string> files;
+    string manifest = "";
+    bool batch = false;
+    bool one_pass = false;
+    bool run = false;
+    int binary = 0; // 1: code only, 2: with symbols
+    bool convert = false;
+    bool link = false;
+    string server_socket = "";
+    bool pipeline = false;
+    bool relax = false;
+    unsigned int record_size = SICXEAssembler::default_text_record_size;
+    int load_address = -1;
+    unsigned long long limit = 0;
+    vector<pair<unsigned char, string> > devices;
+    int stats = 0; // 1: table, 2: json
+    int threads = thread::hardware_concurrency();
+
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--batch") {
+            batch = true;
+        } else if(arg.rfind("--manifest=", 0) == 0) {
+            batch = true;
+            manifest = arg.substr(11);
+        } else if(arg == "--one-pass") {
+            one_pass = true;
+        } else if(arg == "--run") {
+            run = true;
+        } else if(arg == "--pipeline") {
+            pipeline = true;
+        } else if(arg == "--relax") {
+            relax = true;
+        } else if(arg == "--binary" || arg == "--binary=symbols") {
+            binary = arg == "--binary" ? 1 : 2;
+        } else if(arg == "--convert") {
+            convert = true;
+        } else if(arg == "--link") {
+            link = true;
+        } else if(arg == "--serve" || arg.rfind("--serve=", 0) == 0) {
+            server_socket = arg == "--serve" ? default_server_socket : arg.substr(8);
+        } else if(arg.rfind("--record-size=", 0) == 0) {
+            string digits = arg.substr(14);
+            if(digits == "" || digits.length() > 3 || digits.find_first_not_of("0123456789") != string::npos) return usage(argv[0]);
+            record_size = _stoi(digits, 10);
+            if(record_size < 4 || record_size > SICXEAssembler::max_text_record_size) return usage(argv[0]);
+        } else if(arg.rfind("--load=", 0) == 0) {
+            load_address = _stoi(arg.substr(7), 16);
+        } else if(arg.rfind("--limit=", 0) == 0) {
+            // a count of instructions, it may be past what an int holds
+            string digits = arg.substr(8);
+            if(digits == "" || digits.length() > 18 || digits.find_first_not_of("0123456789") != string::npos) return usage(argv[0]);
+            limit = 0;
+            for(unsigned int j = 0; j < digits.length(); j++) limit = limit * 10 + (digits[j] - '0');
+        } else if(arg.rfind("--device=", 0) == 0 && arg.length() > 12 && arg[11] == '=') {
+            // --device=F1=input.txt, the device number is two hex digits
+            devices.push_back(make_pair((unsigned char)_stoi(arg.substr(9, 2), 16), arg.substr(12)));
+        } else if(arg == "--stats" || arg == "--stats=json") {
+            stats = arg == "--stats" ? 1 : 2;
+        } else if(arg.rfind("--jobs=", 0) == 0) {
+            string digits = arg.substr(7);
+            if(digits == "" || digits.length() > 9 || digits.find_first_not_of("0123456789") != string::npos) return usage(argv[0]);
+            threads = _stoi(digits, 10);
+            if(threads <= 0) return usage(argv[0]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if(batch) {
+        // assemble every file in its own job, outputs are named after the inputs
+        BatchAssembler assembler(threads > 0 ? threads : 1);
+        if(manifest != "" && !assembler.loadManifest(manifest)) {
+            cout << "Cannot open manifest " << manifest << endl;
+            return 1;
+        }
+        for(unsigned int i = 0; i < files.size(); i++) assembler.addJob(files[i]);
+        if(assembler.getDuplicate() != "") {
+            cout << "More than one job writes " << assembler.getDuplicate() << ".obj and " << assembler.getDuplicate() << ".lst" << endl;
+            return 1;
+        }
+        int status = assemble_batch(assembler);
+        print_stats(stats);
+        return status;
+    }
+
+    if(convert && files.size() == 2) {
+        int status = convert_object(files[0], files[1], record_size);
+        print_stats(stats);
+        return status;
+    }
+
+    if(server_socket != "") {
+        int status = serve(server_socket, threads);
+        print_stats(stats);
+        return status;
+    }
+
+    if(link && files.size() >= 2) {
+        int status = link_objects(vector<string>(files.begin() + 1, files.end()), files[0], load_address, binary > 0, record_size, threads);
+        print_stats(stats);
+        return status;
+    }
+
+    if(run) {
+        if(files.size() != 1) return usage(argv[0]);
+        int status = run_program(files[0], load_address, devices, limit);
+        print_stats(stats);
+        return status;
+    }
+
+    if(one_pass && files.size() <= 2 && files.size() != 1) {
+        // encode while reading, only the object program is written
+        input = files.size() == 0 ? (InputStream*)new ConsoleInputStream(cin) : new FileInputStream(files[0]);
+        output_object = files.size() == 0 ? (OutputStream*)new ConsoleOutputStream(cout) : new BufferedOutputStream(object_file = new FileOutputStream(files[1] + ".obj"));
+        SICXEAssembler assembler(input, output_object);
+        assembler.setTextRecordSize(record_size);
+        bool result = assembler.assembleOnePass();
+        if(files.size() > 0) {
+            cout << (result ? "Assembled successfully" : "Failed to assemble") << endl;
+            cout << "Error flag: " << assembler.getErrorFlag() << endl;
+        }
+        delete input;
+        delete output_object;
+        delete object_file;
+        print_stats(stats);
+        return result ? 0 : 2;
+    }
 
-    if (argc == 1) {
+    if (files.size() == 0) {
         // Use stdin and stdout for input and output
         input = new ConsoleInputStream(cin);
-        intermediate = new fstream("intermediate.int", ios_base::in | ios_base::out | ios_base::trunc);
+        intermediate = nullptr;
         output_object = new ConsoleOutputStream(cout);
         output_listing = new ConsoleOutputStream(cout);
-    } else if(argc == 3) {
+    } else if(files.size() == 2) {
         // Use argv[1] as input file and argv[2] as output file
-        input = new FileInputStream(argv[1]);
-        intermediate = new fstream(string(argv[2]) + ".int", ios_base::in | ios_base::out | ios_base::trunc);
-        output_object = new FileOutputStream(string(argv[2]) + ".obj");
-        output_listing = new FileOutputStream(string(argv[2]) + ".lst");
+        input = new FileInputStream(files[0]);
+        intermediate = new ofstream(files[1] + ".int");
+        object_file = new FileOutputStream(files[1] + ".obj");
+        listing_file = new FileOutputStream(files[1] + ".lst");
+        output_object = new BufferedOutputStream(object_file);
+        output_listing = new BufferedOutputStream(listing_file);
+        if(binary) binary_file = new FileOutputStream(files[1] + ".bin", true);
     } else {
-        cout << "Usage: " << argv[0] << " [input file] [output file]" << endl;
-        return 1;
+        return usage(argv[0]);
     }
 
     SICXEAssembler assembler(input, output_object, intermediate, output_listing);
+    ThreadPool pool(threads > 0 ? threads : 1);
+    if(threads > 1) assembler.setThreadPool(&pool);
+    if(pipeline) assembler.setPipeline(true);
+    if(relax) assembler.setRelaxation(true);
+    assembler.setTextRecordSize(record_size);
+    if(binary_file != nullptr) assembler.setOutputBinaryStream(binary_file, binary == 2);
     cout << "Assembling..." << endl;
     cout << (assembler.assemble() ? "Assembled successfully" : "Failed to assemble") << endl;
     cout << "Error flag: " << assembler.getErrorFlag() << endl;
+    if(relax) cout << "Widened to format 4: " << assembler.getRelaxedCount() << endl;
+    if(binary_file != nullptr && assembler.hasControlSections()) cout << "No binary object for control sections" << endl;
 
-    intermediate->close();
     delete input;
     delete intermediate;
     delete output_object;
     delete output_listing;
+    delete object_file;
+    delete listing_file;
+    delete binary_file;
+    print_stats(stats);
 
     cout << "Exiting..." << endl;
         
     return 0;
-}
\ No newline at end of file
+}
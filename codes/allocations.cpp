@@ -0,0 +1,35 @@
+#include "stats.hpp"
+#include<cstdlib>
+#include<new>
+
+// every allocation of the program goes through here; only programs link this file, a shared
+// library that replaced the global operator new would count and serve the allocations of
+// whatever program loaded it
+#if STATS
+void* operator new(size_t size) {
+    Stats::count(Stats::ALLOCATIONS);
+    void *p = malloc(size > 0 ? size : 1);
+    if(p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+#endif
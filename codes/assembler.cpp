@@ -1,18 +1,5 @@
 #include "assembler.hpp"
 
-const unordered_map<string, unsigned char> SICXEAssembler::opcode_table = {
-    {"ADD", 0x18}, {"ADDF", 0x58}, {"ADDR", 0x90}, {"AND", 0x40}, {"CLEAR", 0xB4}, {"COMP", 0x28}, {"COMPF", 0x88}, {"COMPR", 0xA0}, {"DIV", 0x24}, {"DIVF", 0x64}, {"DIVR", 0x9C}, {"FIX", 0xC4}, {"FLOAT", 0xC0}, {"HIO", 0xF4}, {"J", 0x3C}, {"JEQ", 0x30}, {"JGT", 0x34}, {"JLT", 0x38}, {"JSUB", 0x48}, {"LDA", 0x00}, {"LDB", 0x68}, {"LDCH", 0x50}, {"LDF", 0x70}, {"LDL", 0x08}, {"LDS", 0x6C}, {"LDT", 0x74}, {"LDX", 0x04}, {"LPS", 0xD0}, {"MUL", 0x20}, {"MULF", 0x60}, {"MULR", 0x98}, {"NORM", 0xC8}, {"OR", 0x44}, {"RD", 0xD8}, {"RMO", 0xAC}, {"RSUB", 0x4C}, {"SHIFTL", 0xA4}, {"SHIFTR", 0xA8}, {"SIO", 0xF0}, {"SSK", 0xEC}, {"STA", 0x0C}, {"STB", 0x78}, {"STCH", 0x54}, {"STF", 0x80}, {"STI", 0xD4}, {"STL", 0x14}, {"STS", 0x7C}, {"STSW", 0xE8}, {"STT", 0x84}, {"STX", 0x10}, {"SUB", 0x1C}, {"SUBF", 0x5C}, {"SUBR", 0x94}, {"SVC", 0xB0}, {"TD", 0xE0}, {"TIO", 0xF8}, {"TIX", 0x2C}, {"TIXR", 0xB8}, {"WD", 0xDC}
-};
-
-const unordered_map<string, set<unsigned char>> SICXEAssembler::format_table = {
-    // SIC/XE format
-    // format 1 (1 byte)
-    // format 2 (2 bytes)
-    // format 3 (3 bytes)
-    // format 4 (4 bytes)
-    {"ADD", {3, 4}}, {"ADDF", {3, 4}}, {"ADDR", {2}}, {"AND", {3, 4}}, {"CLEAR", {2}}, {"COMP", {3, 4}}, {"COMPF", {3, 4}}, {"COMPR", {2}}, {"DIV", {3, 4}}, {"DIVF", {3, 4}}, {"DIVR", {2}}, {"FIX", {1}}, {"FLOAT", {1}}, {"HIO", {1}}, {"J", {3, 4}}, {"JEQ", {3, 4}}, {"JGT", {3, 4}}, {"JLT", {3, 4}}, {"JSUB", {3, 4}}, {"LDA", {3, 4}}, {"LDB", {3, 4}}, {"LDCH", {3, 4}}, {"LDF", {3, 4}}, {"LDL", {3, 4}}, {"LDS", {3, 4}}, {"LDT", {3, 4}}, {"LDX", {3, 4}}, {"LPS", {3, 4}}, {"MUL", {3, 4}}, {"MULF", {3, 4}}, {"MULR", {2}}, {"NORM", {1}}, {"OR", {3, 4}}, {"RD", {3, 4}}, {"RMO", {2}}, {"RSUB", {3, 4}}, {"SHIFTL", {2}}, {"SHIFTR", {2}}, {"SIO", {1}}, {"SSK", {3, 4}}, {"STA", {3, 4}}, {"STB", {3, 4}}, {"STCH", {3, 4}}, {"STF", {3, 4}}, {"STI", {3, 4}}, {"STL", {3, 4}}, {"STS", {3, 4}}, {"STSW", {3, 4}}, {"STT", {3, 4}}, {"STX", {3, 4}}, {"SUB", {3, 4}}, {"SUBF", {3, 4}}, {"SUBR", {2}}, {"SVC", {2}}, {"TD", {3, 4}}, {"TIO", {1}}, {"TIX", {3, 4}}, {"TIXR", {2}}, {"WD", {3, 4}}
-};
-
 const unordered_map<string, unsigned char> SICXEAssembler::register_table = {
     {"A", 0x00}, {"X", 0x01}, {"L", 0x02}, {"B", 0x03}, {"S", 0x04}, {"T", 0x05}, {"F", 0x06}, {"PC", 0x08}, {"SW", 0x09}
 };
@@ -32,53 +19,123 @@ SICXEAssembler::instruction SICXEAssembler::process_instruction(int &locctr, str
     _i.operand = operand;
     _i.address = locctr;
     _i.length = 0;
+    _i.comment = false;
+    _i.expression = -1;
 
+    bool extended, duplicate = false;
+    const mnemonic *entry = MnemonicTable::find(opcode, extended);
     if(label != "") {
-        if(this->symbol_table.find(label) != this->symbol_table.end()) {
+        int id = this->symbol_table.intern(label);
+        if(this->symbol_table.isDefined(id) || this->symbol_table.isExternal(id) || (!this->equates.empty() && this->equates.count(id) > 0)) {
             // duplicate symbol
             this->error_flag |= 4;
-        } else {
-            this->symbol_table[label] = locctr;
+            duplicate = true;
+        } else if(entry == nullptr || entry->directive != mnemonic::EQU) {
+            this->symbol_table.define(id, locctr);
         }
     }
-
-    set<unsigned char> formats;
-    if(opcode == "WORD") {
-        _i.length = 3;
-    } else if(opcode == "RESW") {
-        _i.length = 3 * _stoi(operand, 10);
-    } else if(opcode == "RESB") {
-        _i.length = _stoi(operand);
-    } else if(opcode == "BYTE") {
-        if(toupper(operand[0]) == 'C') {
-            _i.length = operand.length() - 3;
-        } else if(toupper(operand[0]) == 'X') {
-            _i.length = (operand.length() - 3) / 2;
-        } else {
-            // invalid operand
-            this->error_flag |= 8;
-        }
-    } else if(opcode_table.find(opcode) != opcode_table.end()) {
-        formats = format_table.at(opcode);
-        if(formats.find(1) != formats.end()) {
-            _i.length = 1;
-        } else if(formats.find(2) != formats.end())
-            _i.length = 2;
-        else if(formats.find(3) != formats.end())
-            _i.length = 3;
-        else 
-            this->error_flag |= 16;
-    } else if(isExtended(opcode) && opcode_table.find(getOpcode(opcode)) != opcode_table.end()) {
-        _i.length = 4;
-    } else if(opcode == "START") {
-        this->start_address = locctr = _i.address = _stoi(operand, 16);
-    } else if(opcode == "END") {
-        this->program_length = locctr - this->start_address;
-    } else if(opcode == "BASE" || opcode == "NOBASE") {
-        // do nothing
+    // pass 2 only sees the symbol id, a literal's id is its pool entry; an expression is compiled once
+    string symbol = this->referenced_symbol(_i);
+    if(symbol != "" && isLiteral(symbol) && opcode != "BASE") {
+        _i.symbol = this->intern_literal(symbol);
+        // invalid literal
+        if(_i.symbol < 0) this->error_flag |= 8;
+    } else if(symbol != "" && opcode != "BASE" && Expression::isExpression(symbol)) {
+        _i.symbol = -1;
+        _i.expression = this->compile_expression(symbol);
+        // invalid expression
+        if(_i.expression < 0) this->error_flag |= 8;
     } else {
+        _i.symbol = symbol != "" ? this->symbol_table.intern(symbol) : -1;
+    }
+
+    if(entry == nullptr) {
         // invalid opcode
         this->error_flag |= 16;
+    } else switch(entry->directive) {
+        case mnemonic::WORD:
+            _i.length = 3;
+            // anything but a number is an expression, pass 2 evaluates it
+            if(!isNumber(operand) || Expression::isExpression(operand)) {
+                _i.expression = this->compile_expression(operand);
+                if(_i.expression < 0) this->error_flag |= 8;
+            }
+            break;
+        case mnemonic::RESW:
+        case mnemonic::RESB:
+            // a count that is not a number has to be absolute and known by now
+            if(isNumber(operand) && !Expression::isExpression(operand)) {
+                _i.length = _stoi(operand, 10);
+            } else {
+                Expression::value count;
+                if(!this->absolute_value(operand, locctr, count)) this->error_flag |= 8;
+                _i.length = count.number;
+            }
+            if(entry->directive == mnemonic::RESW) _i.length *= 3;
+            break;
+        case mnemonic::BYTE:
+            if(toupper(operand[0]) == 'C') {
+                _i.length = operand.length() - 3;
+            } else if(toupper(operand[0]) == 'X') {
+                _i.length = (operand.length() - 3) / 2;
+            } else {
+                // invalid operand
+                this->error_flag |= 8;
+            }
+            break;
+        case mnemonic::INSTRUCTION:
+            _i.length = extended ? 4 : entry->length();
+            if(_i.length == 0) this->error_flag |= 16;
+            break;
+        case mnemonic::START:
+            this->start_address = locctr = _i.address = _stoi(operand, 16);
+            break;
+        case mnemonic::END:
+            this->program_length = locctr - this->start_address;
+            break;
+        case mnemonic::CSECT:
+            // only the first line of a section, read_program() sees to that; a section needs a name
+            if(label == "") this->error_flag |= 4;
+            this->start_address = locctr = _i.address = 0;
+            this->control_sections = true;
+            break;
+        case mnemonic::EXTDEF:
+        case mnemonic::EXTREF:
+            this->control_sections = true;
+            this->external_symbols(_i);
+            break;
+        case mnemonic::EQU:
+            // the value waits for the symbols it uses if they are not all defined yet
+            if(label == "") this->error_flag |= 4;
+            if(label == "" || duplicate) break;
+            _i.expression = this->compile_expression(operand);
+            if(_i.expression < 0) this->error_flag |= 8;
+            else this->add_equate(this->symbol_table.find(label), _i.expression, locctr);
+            break;
+        case mnemonic::ORG:
+            // ORG without an operand goes back to where the first ORG left
+            this->expression_lines = true;
+            if(operand == "") {
+                if(this->org_return < 0) this->error_flag |= 8;
+                else locctr = this->org_return;
+                this->org_return = -1;
+            } else {
+                Expression::value target;
+                if(!this->expression_value(operand, locctr, target) || !target.externals.empty()) {
+                    this->error_flag |= 8;
+                    break;
+                }
+                if(this->org_return < 0) this->org_return = locctr;
+                locctr = target.number;
+            }
+            // the listing shows where the location counter went
+            _i.address = locctr;
+            break;
+        case mnemonic::BASE:
+        case mnemonic::NOBASE:
+        case mnemonic::LTORG:
+            // do nothing, the pool after LTORG is placed by literal_pool()
+            break;
     }
 
     locctr += _i.length;
@@ -86,67 +143,230 @@ SICXEAssembler::instruction SICXEAssembler::process_instruction(int &locctr, str
     return _i;
 }
 
-void SICXEAssembler::write_intermediate_line(int &line_number, instruction &processed_instruction) const {
+int SICXEAssembler::intern_literal(const string &spelling) {
+    // the pool entry is named by the bytes, so =C'A' and =X'41' share it, and by the pool
+    string bytes;
+    if(!parse_literal(spelling, bytes)) return -1;
+    int count = this->symbol_table.size();
+    int id = this->symbol_table.intern("=" + hex_encode(bytes) + "@" + to_string(this->literal_pools));
+    if(id == count) this->literals.push_back(literal{id, (int)bytes.length(), spelling});
+    return id;
+}
+
+vector<SICXEAssembler::instruction> SICXEAssembler::literal_pool(int &locctr) {
+    // one line per literal used since the last pool, labeled '*' with the literal as its opcode
+    vector<instruction> pool;
+    for(unsigned int i = 0; i < this->literals.size(); i++) {
+        instruction _i;
+        _i.address = locctr;
+        _i.length = this->literals[i].length;
+        _i.comment = false;
+        _i.label = "*";
+        _i.opcode = this->literals[i].spelling;
+        _i.symbol = this->literals[i].symbol;
+        _i.expression = -1;
+        this->symbol_table.define(_i.symbol, locctr);
+        locctr += _i.length;
+        pool.push_back(_i);
+    }
+    this->literals.clear();
+    this->literal_pools++;
+    return pool;
+}
+
+string SICXEAssembler::format_line(const instruction &line) const {
     // every element must align to 10 characters
-    string element, line = "";
-    line += align_right(to_string(line_number * 5), 10, ' ') + "\t";
-    line += align_right(((processed_instruction.opcode == "END" || processed_instruction.opcode == "BASE" || processed_instruction.opcode == "NOBASE") ? "" : itos(processed_instruction.address, 16)), 10, ' ') + "\t";
-    line += align_right(processed_instruction.label, 10, ' ') + "\t";
-    line += align_right(processed_instruction.opcode, 10, ' ') + "\t";
-    line += align_right(processed_instruction.operand, 10, ' ') + "\n";
-    this->intermediate->write(line.c_str(), line.length());
+    return this->format_number(line) + this->format_fields(line);
 }
 
-void SICXEAssembler::write_comment(int &line_number, string &comment) const {
-    string line = "";
-    line += align_right(to_string(line_number * 5), 10) + "\t";
-    line += string(10, ' ') + "\t" + comment + "\n";
-    this->intermediate->write(line.c_str(), line.length());
+string SICXEAssembler::format_number(const instruction &line) const {
+    return align_right(to_string(line.line_number * 5), 10, ' ') + "\t";
 }
 
-SICXEAssembler::SICXEAssembler(InputStream *input, OutputStream *output_object, fstream *intermediate, OutputStream *output_listing) {
+string SICXEAssembler::format_fields(const instruction &line) const {
+    // the part of a line after its line number
+    if(line.comment) return string(10, ' ') + "\t" + line.operand;
+
+    string result = align_right(((line.opcode == "END" || line.opcode == "BASE" || line.opcode == "NOBASE" || line.opcode == "LTORG") ? "" : hex_field(line.address, 1)), 10, ' ') + "\t";
+    result += align_right(line.label, 10, ' ') + "\t";
+    result += align_right(line.opcode, 10, ' ') + "\t";
+    result += align_right(line.operand, 10, ' ');
+    return result;
+}
+
+string SICXEAssembler::header_record(const instruction &line) const {
+    // 'line' is the first line of the program that is not a comment
+    if(line.opcode == "START") {
+        return "H" + sep() + line.label + '\t' + sep() + align_right(line.operand, 6, '0') + sep() + hex_field(this->program_length, 6) + '\n';
+    }
+    if(line.opcode == "CSECT") {
+        return "H" + sep() + line.label + '\t' + sep() + "000000" + sep() + hex_field(this->program_length, 6) + '\n';
+    }
+    return "H" + sep() + "      " + '\t' + sep() + "000000" + sep() + hex_field(this->program_length, 6) + '\n';
+}
+
+SICXEAssembler::instruction SICXEAssembler::make_comment(string_view comment) const {
+    instruction _i;
+    _i.address = 0;
+    _i.length = 0;
+    _i.comment = true;
+    _i.operand = comment;
+    _i.symbol = -1;
+    _i.expression = -1;
+    Stats::count(Stats::COMMENTS);
+    return _i;
+}
+
+string SICXEAssembler::referenced_symbol(const instruction &line) const {
+    // the symbol the object code of 'line' depends on, "" if none
+    if(line.comment || line.operand == "") return "";
+    if(line.opcode == "BASE") return line.operand;
+
+    bool extended;
+    const mnemonic *entry = MnemonicTable::find(line.opcode, extended);
+    if(entry == nullptr || entry->directive != mnemonic::INSTRUCTION || !(entry->formats & mnemonic::FORMAT_3)) return "";
+
+    string operand = line.operand;
+    if(operand.length() >= 2 && isIndexed(operand)) operand = operand.substr(0, operand.length() - 2);
+    else if(isImmediate(operand) || isIndirect(operand)) operand = operand.substr(1);
+    return isNumber(operand) && !Expression::isExpression(operand) ? "" : operand;
+}
+
+void SICXEAssembler::write_intermediate() const {
+    string line;
+    Stats::Timer timer(Stats::OUTPUT);
+    for(unsigned int i = 0; i < this->sections.size(); i++) this->sections[i]->assembler->write_intermediate();
+    for(unsigned int i = 0; i < this->program.size(); i++) {
+        line = this->format_line(this->program[i]) + "\n";
+        this->intermediate->write(line.c_str(), line.length());
+    }
+}
+
+SICXEAssembler::SICXEAssembler(InputStream *input, OutputStream *output_object, ostream *intermediate, OutputStream *output_listing) {
     this->input = input;
     this->output_object = output_object;
     this->intermediate = intermediate;
-    intermediate->seekp(0, ios_base::beg);
     this->output_listing = output_listing;
+    this->output_binary = nullptr;
+    this->binary_symbols = true;
+    this->pool = nullptr;
+    this->pipelined = false;
+    this->pipeline_depth = 1024;
+    this->text_record_size = default_text_record_size;
+    this->generated_lines = false;
+    this->literal_pools = 0;
+    this->control_sections = false;
+    this->section_continues = false;
+    this->chunk_lines = 4096;
+    this->incremental_ready = false;
+    this->relaxing = false;
+    this->relaxed_lines = 0;
+    this->expression_lines = false;
+    this->org_return = -1;
 }
 
-OutputStream* SICXEAssembler::fake_output_stream = new NoneOutputStream();
-
 bool SICXEAssembler::pass1() {
-    string line, opcode, operand, label;
+    // the source is looked at whole for CSECT lines first; a buffered input is read where it is,
+    // only a stream that reads as it goes, like stdin, is copied into memory
+    string text;
+    InputStream *input = this->input;
+    if(!input->isBuffered()) {
+        Stats::Timer timer(Stats::READ);
+        while(!input->eof()) {
+            text.append(input->readline_view());
+            text += '\n';
+        }
+    }
+    MemoryInputStream buffered(input->isBuffered() ? input->getContents() : string_view(text));
+    this->input = &buffered;
+
+    vector<size_t> macro_ends;
+    vector<string_view> slices = find_sections(buffered.getContents(), macro_ends);
+    this->sections.clear();
+    bool result = slices.size() > 1 ? this->read_sections(slices, macro_ends, buffered.getContents())
+        : this->pipelined ? this->read_pipelined() : this->read_program();
+    this->input = input;
+
+    // the intermediate file is only a debug dump of the program
+    if(this->intermediate != nullptr) this->write_intermediate();
+    return result;
+}
+
+bool SICXEAssembler::read_source_line(source_line &line) {
+    // false at the end of the input; pass 1 always reads from memory, so the line is taken from
+    // the buffer without a virtual call
+    MemoryInputStream *memory = static_cast<MemoryInputStream*>(this->input);
+    if(memory->MemoryInputStream::eof()) return false;
+    string_view text = memory->MemoryInputStream::readline_view();
+    Stats::count(Stats::LINES);
+    line.comment = this->input_is_comment(text);
+    line.valid = line.comment || parse_input_line(text, line.label, line.opcode, line.operand);
+    // the macro processor splits lines that invoke or define a macro again, it knows their names
+    if(line.comment || !line.valid) line.operand.assign(text);
+    return true;
+}
+
+bool SICXEAssembler::read_program(SpscRing<source_line> *lines) {
+    // lines come from 'lines' when a reader thread splits them, else straight from the input;
+    // macro expansions are taken before the next line of the source
+    source_line line;
     instruction processed_instruction;
-    int locctr, line_number = 0;
+    MacroProcessor macros;
+    int locctr = 0, line_number = 0;
     bool first_line = true;
+    Stats::Timer timer(Stats::PASS1);
+    auto next = [this, lines, &macros](source_line &line) {
+        if(!macros.next(line) && !(lines != nullptr ? lines->pop(line) : this->read_source_line(line))) return false;
+        macros.take(line);
+        if(macros.getMacroCount() > 0) this->generated_lines = true;
+        return true;
+    };
+    auto pool = [this, &line_number](int &locctr) {
+        vector<instruction> lines = this->literal_pool(locctr);
+        for(unsigned int i = 0; i < lines.size(); i++) {
+            lines[i].line_number = ++line_number;
+            this->program.push_back(lines[i]);
+        }
+        if(!lines.empty()) this->generated_lines = true;
+    };
 
-    // restart intermediate file
-    this->intermediate->seekp(0, ios::beg);
     this->program_length = 0;
     this->error_flag = 0;
-    this->symbol_table = unordered_map<string, int>();
+    this->incremental_ready = false;
+    this->generated_lines = false;
+    this->control_sections = false;
+    this->symbol_table.clear();
+    this->literals.clear();
+    this->literal_pools = 0;
+    this->relaxed_lines = 0;
+    this->expressions.clear();
+    this->equates.clear();
+    this->equate_order.clear();
+    this->expression_lines = false;
+    this->org_return = -1;
+    this->program.clear();
+    this->define_macros(macros);
     while(true) {
-        if(input->eof()) { // empty file
+        if(!next(line)) { // empty file
             this->error_flag |= 1;
             return false;
         }
-        line = input->readline();
 
-        if(!this->input_is_comment(line)) break;
+        if(!line.comment) break;
         else {
-            line_number++;
-            this->write_comment(line_number, line);
+            this->program.push_back(this->make_comment(line.operand));
+            this->program.back().line_number = ++line_number;
         }
     }
 
-    if(parse_input_line(line, label, opcode, operand)){
-        if(opcode == "START"){
+    if(line.valid){
+        if(line.opcode == "START" || line.opcode == "CSECT"){
             first_line = false;
-            processed_instruction = this->process_instruction(locctr, label, opcode, operand);
+            processed_instruction = this->process_instruction(locctr, line.label, line.opcode, line.operand);
             if(this->error_flag) return false;
-            line_number++;
-            this->write_intermediate_line(line_number, processed_instruction);
-        } else if(opcode == "END") { // empty program
+            processed_instruction.line_number = ++line_number;
+            this->program.push_back(processed_instruction);
+        } else if(line.opcode == "END") { // empty program
             this->error_flag |= 1;
             return false;
         } else {
@@ -158,302 +378,450 @@ bool SICXEAssembler::pass1() {
     }
 
     if(first_line) {
-        processed_instruction = this->process_instruction(locctr, label, opcode, operand);
+        processed_instruction = this->process_instruction(locctr, line.label, line.opcode, line.operand);
         if(this->error_flag) return false;
-        line_number++;
-        this->write_intermediate_line(line_number, processed_instruction);
-    }
-
-    while(!input->eof()) {
-        line = input->readline();
-        if(!this->input_is_comment(line)) {
-            if(parse_input_line(line, label, opcode, operand)){
-                if(opcode == "END"){
-                    processed_instruction = this->process_instruction(locctr, label, opcode, operand);
-                    if(this->error_flag) return false;
-                    line_number++;
-                    this->write_intermediate_line(line_number, processed_instruction);
-                    return true;
-                } else {
-                    processed_instruction = this->process_instruction(locctr, label, opcode, operand);
-                    if(this->error_flag) return false;
-                    line_number++;
-                    this->write_intermediate_line(line_number, processed_instruction);
+        processed_instruction.line_number = ++line_number;
+        this->program.push_back(processed_instruction);
+    }
+
+    while(next(line)) {
+        if(!line.comment) {
+            if(line.valid){
+                if(line.opcode == "CSECT") { // sections are split before pass 1
+                    this->error_flag |= 2;
+                    return false;
                 }
+                // the last pool goes in front of END, so the program length covers it
+                if(line.opcode == "END") pool(locctr);
+                processed_instruction = this->process_instruction(locctr, line.label, line.opcode, line.operand);
+                if(this->error_flag) return false;
+                processed_instruction.line_number = ++line_number;
+                this->program.push_back(processed_instruction);
+                if(line.opcode == "LTORG") pool(locctr);
+                if(line.opcode == "END") return this->finish_program();
             } else { // invalid line
                 this->error_flag |= 2;
                 return false;
             }
         } else {
-            line_number++;
-            this->write_comment(line_number, line);
+            this->program.push_back(this->make_comment(line.operand));
+            this->program.back().line_number = ++line_number;
         }
     }
 
+    // a section followed by another one ends with its input
+    if(this->section_continues) {
+        pool(locctr);
+        this->program_length = locctr - this->start_address;
+        return this->finish_program();
+    }
+
     // no END statement
     this->error_flag |= 32;
     return false;
 }
 
+bool SICXEAssembler::finish_program() {
+    // EQU symbols still waiting for others are resolved before relaxation moves anything
+    if(!this->resolve_equates()) {
+        this->error_flag |= 4;
+        return false;
+    }
+    if(this->relaxing) this->relax_program();
+    return true;
+}
+
+void SICXEAssembler::define_macros(MacroProcessor &macros) const {
+    // a section sees the macros defined in the sections before it, nothing else of them
+    MemoryInputStream input(this->macro_source);
+    source_line line;
+    while(!input.eof()) {
+        string_view text = input.readline_view();
+        if(this->input_is_comment(text)) continue;
+        line.comment = false;
+        line.valid = parse_input_line(text, line.label, line.opcode, line.operand);
+        if(!line.valid) line.operand.assign(text);
+        if(macros.isDefining() || (line.valid && line.opcode == "MACRO")) macros.take(line);
+    }
+}
+
 bool SICXEAssembler::pass2() {
-    int line_number, address;
-    string line, opcode, operand, label, object_code, h_record, e_record, tmp_s;
+    unsigned int first, begin, end, i;
+    string e_record, tmp_s, no_code, name;
     text_record t_record;
-    instruction processed_instruction;
-    bool first_line = true;
+    ObjectProgram binary;
+    if(!this->sections.empty()) return this->encode_sections();
+    Stats::Timer timer(Stats::PASS2);
 
-    // restart intermediate file
-    this->intermediate->seekp(0, ios::beg);
-    this->base = -1;
     this->m_records.clear();
     this->error_flag = 0;
-    while(true) {
-        if(intermediate->eof()) { // empty file
-            this->error_flag |= 64 | 1;
-            return false;
-        }
-        getline(*this->intermediate, line);
+    for(first = 0; first < this->program.size() && this->program[first].comment; first++);
+    if(first >= this->program.size() || this->program[first].opcode == "END") { // empty program
+        this->error_flag |= 64 | 1;
+        return false;
+    }
+    if(this->program.back().opcode != "END" && !this->section_continues) { // no END statement
+        this->error_flag |= 64 | 32;
+        return false;
+    }
 
-        if(!this->intermediate_is_comment(line)) break;
-        else this->output_listing->write(line + '\n');
+    const instruction &line = this->program[first];
+    begin = (line.opcode == "START" || line.opcode == "CSECT") ? first + 1 : first;
+    this->output_object->write(this->header_record(line));
+    if(this->control_sections && !this->write_link_records(first)) return false;
+    binary.setHeader(line.opcode == "START" ? line.label : "      ", this->start_address, this->program_length);
+    for(i = 0; i < begin; i++) this->write_listing_line(this->program[i], no_code);
+
+    // a section that another one follows may have no END line
+    end = this->program.back().opcode == "END" ? this->program.size() - 1 : this->program.size();
+    this->start_text_record(t_record, line.address);
+    // the pipeline writes text records and listing lines on a thread of their own
+    bool encoded = this->pipelined ? this->encode_pipelined(begin, end, t_record, binary) : this->encode_program(begin, end, t_record, binary);
+    if(!encoded) return false;
+
+    if(t_record.length > 0) {
+        this->write_text_record(t_record, this->output_object);
+    }
+    if(end < this->program.size()) this->write_listing_line(this->program[end], no_code);
+
+    // write modification records and the end record in one batch; in control sections they name
+    // the symbol they add, the section's own name for relocation
+    tmp_s.reserve(m_records.size() * 10 + 8);
+    for(unsigned int j = 0; j < m_records.size(); j++) {
+        tmp_s += "M" + sep() + hex_field(m_records[j].address, 6) + sep() + hex_field(m_records[j].length, 2);
+        if(this->control_sections) {
+            name = m_records[j].symbol >= 0 ? string(this->symbol_table.getName(m_records[j].symbol)) : line.label;
+            tmp_s += sep() + (m_records[j].negative ? "-" : "+") + name;
+        }
+        tmp_s += '\n';
     }
 
-    if(parse_intermediate_line(line, line_number, address, label, opcode, operand)){
-        if(opcode == "START"){
-            first_line = false;
+    // only the first section has an entry point
+    e_record = "E" + sep() + (line.opcode == "CSECT" ? "" : hex_field(this->start_address, 6)) + '\n';
+    this->output_object->write_batch({tmp_s, e_record});
+    Stats::count(Stats::M_RECORDS, m_records.size());
 
-            h_record = "H" + sep() + label + '\t' + sep() + align_right(operand, 6, '0') + sep() + align_right(itos(this->program_length, 16), 6, '0') + '\n';
-            this->output_object->write(h_record);
-            this->write_listing_line(line, object_code);
-        } else if(opcode == "END") { // empty program
-            this->error_flag |= 64 | 1;
-            return false;
-        } else {
-            h_record = "H" + sep() + "      " + '\t' + sep() + "000000" + sep() + align_right(itos(this->program_length, 16), 6, '0') + '\n';
-            this->output_object->write(h_record);
+    if(this->binary_output()) {
+        for(unsigned int j = 0; j < m_records.size(); j++) binary.addRelocation(m_records[j].address, m_records[j].length);
+        for(int id = 0; this->binary_symbols && id < this->symbol_table.size(); id++) {
+            // literal pool entries are not symbols of the program
+            if(this->symbol_table.isDefined(id) && !isLiteral(string(this->symbol_table.getName(id)))) binary.addSymbol(this->symbol_table.getName(id), this->symbol_table.getValue(id));
         }
-    } else { // invalid line
-        this->error_flag |= 64 | 2;
-        return false;
+        binary.setEntry(this->start_address);
+        binary.writeBinary(this->output_binary);
     }
+    return true;
+}
 
-    t_record = initialize_text_record(address);
+bool SICXEAssembler::encode_program(unsigned int begin, unsigned int end, text_record &t_record, ObjectProgram &binary) {
+    unsigned int chunk_size, i;
+    int base;
+    vector<pass2_chunk> chunks;
+    vector<object_code> object_codes;
+
+    // every line between the header and END is encoded independently in chunks
+    chunk_size = (this->pool == nullptr || end - begin < 2 * this->chunk_lines) ? max(end - begin, 1u) : this->chunk_lines;
+    for(i = begin; i < end || chunks.empty(); i += chunk_size) {
+        pass2_chunk chunk = pass2_chunk();
+        chunk.begin = i;
+        chunk.end = min(i + chunk_size, end);
+        chunks.push_back(chunk);
+    }
+    object_codes.resize(this->program.size());
 
-    if(first_line) {
-        if(opcode == "BASE") {
-            object_code = "";
-            this->base = symbol_table.at(operand);
-        } else if(opcode == "NOBASE") {
-            object_code = "";
-            this->base = -1;
-        } else {
-            object_code = this->toObjCode(address, opcode, operand);
-            this->process_text_record(t_record, address, object_code);
+    if(chunks.size() == 1) {
+        chunks[0].base = -1;
+        this->encode_chunk(chunks[0], object_codes);
+    } else {
+        TaskGroup group;
+
+        // prefix scan of the BASE state: find the last BASE/NOBASE of every chunk,
+        // then carry it into the chunks that follow
+        for(i = 0; i < chunks.size(); i++) {
+            pass2_chunk *chunk = &chunks[i];
+            this->pool->submit(group, [this, chunk] { chunk->base_out = this->last_base(*chunk); });
+        }
+        this->pool->wait(group);
+        for(i = 0, base = -1; i < chunks.size(); i++) {
+            chunks[i].base = base;
+            if(chunks[i].base_out != -2) base = chunks[i].base_out;
         }
 
-        this->write_listing_line(line, object_code);
-        if(this->error_flag) return false;
+        for(i = 0; i < chunks.size(); i++) {
+            pass2_chunk *chunk = &chunks[i];
+            this->pool->submit(group, [this, chunk, &object_codes] { this->encode_chunk(*chunk, object_codes); });
+        }
+        this->pool->wait(group);
     }
 
-    while(!intermediate->eof()) {
-        getline(*this->intermediate, line);
-        if(!this->intermediate_is_comment(line)) {
-            if(parse_intermediate_line(line, line_number, address, label, opcode, operand)){
-                if(opcode == "END"){
-                    object_code = "";
-                    if(t_record.length > 0) {
-                        this->write_text_record(t_record);
-                    }
-                    this->write_listing_line(line, object_code);
-
-                    // write modification records
-                    for(int i = 0; i < m_records.size(); i++) {
-                        tmp_s = "M" + sep() + align_right(itos(m_records[i].address, 16), 6, '0') + sep() + align_right(itos(m_records[i].length, 16), 2, '0') + '\n';
-                        this->output_object->write(tmp_s);
-                    }
-
-                    e_record = "E" + sep() + align_right(itos(this->start_address, 16), 6, '0') + '\n';
-                    this->output_object->write(e_record);
-                    return true;
-                } else {
-                    if(opcode == "BASE") {
-                        object_code = "";
-                        this->base = symbol_table.at(operand);
-                    } else if(opcode == "NOBASE") {
-                        object_code = "";
-                        this->base = -1;
-                    } else {
-                        object_code = this->toObjCode(address, opcode, operand);
-                        this->process_text_record(t_record, address, object_code);
-                    }
-
-                    this->write_listing_line(line, object_code);
-                    if(this->error_flag) return false;
-                }
-            } else { // invalid line
-                this->error_flag |= 64 | 2;
-                return false;
+    // merge in program order, stopping at the first line that failed
+    Stats::Timer merge_timer(Stats::TEXT_RECORDS);
+    for(i = 0; i < chunks.size(); i++) {
+        pass2_chunk &chunk = chunks[i];
+        if(this->output_listing != nullptr) this->output_listing->write(chunk.listing);
+        for(unsigned int j = chunk.begin; j < chunk.end && j <= chunk.error_line; j++) {
+            const instruction &current = this->program[j];
+            if(!current.comment && current.opcode != "BASE" && current.opcode != "NOBASE") {
+                string_view bytes = string_view(chunk.bytes).substr(object_codes[j].offset, object_codes[j].length);
+                this->process_text_record(t_record, current.address, bytes, this->output_object);
+                if(this->binary_output()) binary.addCode(current.address, bytes);
             }
-        } else {
-            this->output_listing->write(line + '\n');
+        }
+        this->m_records.insert(this->m_records.end(), chunk.m_records.begin(), chunk.m_records.end());
+        if(chunk.error_line < chunk.end) {
+            this->error_flag = chunk.error_flag;
+            return false;
         }
     }
+    return true;
+}
 
-    // no END statement
-    this->error_flag |= 64 | 32;
-    return false;
+int SICXEAssembler::last_base(const pass2_chunk &chunk) const {
+    // value of the last BASE/NOBASE in the chunk, -2 if there is none
+    for(unsigned int i = chunk.end; i > chunk.begin; i--) {
+        const instruction &line = this->program[i - 1];
+        if(line.comment) continue;
+        if(line.opcode == "NOBASE") return -1;
+        if(line.opcode == "BASE") {
+            return this->symbol_table.isDefined(line.symbol) ? this->symbol_table.getValue(line.symbol) : -1;
+        }
+    }
+    return -2;
+}
+
+void SICXEAssembler::encode_chunk(pass2_chunk &chunk, vector<object_code> &object_codes) const {
+    // only reads the program and the symbol table, so chunks can run concurrently
+    chunk.error_flag = 0;
+    chunk.error_line = chunk.end;
+    for(unsigned int i = chunk.begin; i < chunk.end; i++) {
+        chunk.listing += this->format_number(this->program[i]);
+        this->encode_line(this->program[i], chunk, object_codes[i]);
+        if(chunk.error_flag) {
+            chunk.error_line = i;
+            return;
+        }
+    }
 }
 
-string SICXEAssembler::toObjCode(int &locctr, string &opcode, string &operand) {
+void SICXEAssembler::encode_line(const instruction &line, pass2_chunk &chunk, object_code &code) const {
+    // appends the object code of 'line' to the chunk and its listing text after the line number
+    string hex;
+    this->encode_object(line, chunk, code);
+    if(line.comment) {
+        chunk.listing += this->format_fields(line) + '\n';
+        return;
+    }
+
+    // object code only becomes text for the listing
+    hex.resize(code.length * 2);
+    hex_encode((const unsigned char*)chunk.bytes.data() + code.offset, code.length, &hex[0]);
+    chunk.listing += this->format_fields(line) + '\t' + align_right(hex, 10, ' ') + '\n';
+}
+
+void SICXEAssembler::encode_object(const instruction &line, pass2_chunk &chunk, object_code &code) const {
+    // appends the object code of 'line' to the chunk, BASE and NOBASE only change its state
+    code.offset = chunk.bytes.length();
+    code.length = 0;
+    if(line.comment) return;
+
+    if(line.opcode == "BASE") {
+        if(this->symbol_table.isDefined(line.symbol)) chunk.base = this->symbol_table.getValue(line.symbol);
+        else chunk.error_flag |= 64 | 4;
+    } else if(line.opcode == "NOBASE") {
+        chunk.base = -1;
+    } else {
+        this->toObjCode(line.address, line.opcode, line.operand, line.symbol, line.expression, chunk);
+        code.length = chunk.bytes.length() - code.offset;
+    }
+}
+
+// appends the lowest 'length' bytes of 'word', most significant first
+static void append_word(string &bytes, unsigned int word, int length) {
+    for(int shift = (length - 1) * 8; shift >= 0; shift -= 8) bytes += (char)(word >> shift);
+}
+
+void SICXEAssembler::toObjCode(int locctr, const string &opcode, const string &operand, int symbol, int expression, pass2_chunk &chunk) const {
     #define flag_n 32
     #define flag_i 16
     #define flag_x 8
     #define flag_b 4
     #define flag_p 2
     #define flag_e 1
-    string objCode, tmp_s;
-    int opcode_i, flags = 0, disp = 0;
-    set<unsigned char> format;
+    unsigned int opcode_i, flags = 0, disp = 0;
     vector<string> operands;
+    bool extended;
+    if(isLiteral(opcode)) { // a pool entry, its opcode is the literal
+        string bytes;
+        if(parse_literal(opcode, bytes)) chunk.bytes += bytes;
+        else chunk.error_flag |= 64 | 8;
+        return;
+    }
+
+    const mnemonic *entry = MnemonicTable::find(opcode, extended);
+    mnemonic::kind directive = entry != nullptr ? entry->directive : mnemonic::START;
 
-    if(isExtended(opcode) && opcode_table.find(getOpcode(opcode)) != opcode_table.end()) {
-        opcode_i = opcode_table.at(getOpcode(opcode));
+    if(directive == mnemonic::INSTRUCTION && extended) {
+        opcode_i = entry->opcode;
         flags |= flag_e;
         if(operand == "") {
             flags |= flag_n | flag_i;
-            objCode = align_right(itos(opcode_i << 24 | flags << 20, 16), 8, '0');
         } else {
             if(isIndexed(operand)) {
                 flags |= flag_n | flag_i | flag_x;
-                disp = getAddress(locctr, operand.substr(0, operand.length() - 2));
+                disp = getAddress(locctr, operand.substr(0, operand.length() - 2), symbol, expression, chunk);
             } else if(isImmediate(operand)) {
                 flags |= flag_i;
-                disp = getAddress(locctr, operand.substr(1));
+                disp = getAddress(locctr, operand.substr(1), symbol, expression, chunk);
             } else if(isIndirect(operand)) {
                 flags |= flag_n;
-                disp = getAddress(locctr, operand.substr(1));
+                disp = getAddress(locctr, operand.substr(1), symbol, expression, chunk);
             } else {
                 flags |= flag_n | flag_i;
-                disp = getAddress(locctr, operand);
+                disp = getAddress(locctr, operand, symbol, expression, chunk);
             }
-
-            objCode = align_right(itos(opcode_i << 24 | flags << 20 | disp, 16), 8, '0');
         }
-    } else if(opcode_table.find(opcode) != opcode_table.end()) {
-        format = format_table.at(opcode);
-        if(format.find(1) != format.end()) {
-            objCode = align_right(itos(opcode_table.at(opcode), 16), 2, '0');
-        } else if(format.find(2) != format.end()) {
+
+        // opcode (6 bits) | nixbpe | 20 bit address
+        append_word(chunk.bytes, opcode_i << 24 | flags << 20 | (disp & 0xFFFFF), 4);
+    } else if(directive == mnemonic::INSTRUCTION) {
+        opcode_i = entry->opcode;
+        if(entry->formats & mnemonic::FORMAT_1) {
+            append_word(chunk.bytes, opcode_i, 1);
+        } else if(entry->formats & mnemonic::FORMAT_2) {
             operands = split(operand, ",");
-            opcode_i = opcode_table.at(opcode);
             if(operands.size() == 2) {
                 if(register_table.find(operands[0]) != register_table.end() && register_table.find(operands[1]) != register_table.end()) {
-                    objCode = align_right(itos(opcode_i << 8 | register_table.at(operands[0]) << 4 | register_table.at(operands[1]), 16), 4, '0');
+                    append_word(chunk.bytes, opcode_i << 8 | register_table.at(operands[0]) << 4 | register_table.at(operands[1]), 2);
                 } else {
-                    this->error_flag |= 64 | 8;
-                    objCode = "";
+                    chunk.error_flag |= 64 | 8;
                 }
             } else if(operands.size() == 1) {
                 if(register_table.find(operands[0]) != register_table.end()) {
-                    objCode = align_right(itos(opcode_i << 8 | register_table.at(operands[0]) << 4, 16), 4, '0');
+                    append_word(chunk.bytes, opcode_i << 8 | register_table.at(operands[0]) << 4, 2);
                 } else {
-                    this->error_flag |= 64 | 8;
-                    objCode = "";
+                    chunk.error_flag |= 64 | 8;
                 }
             } else {
-                this->error_flag |= 64 | 8;
-                objCode = "";
+                chunk.error_flag |= 64 | 8;
             }
         } else {
-            opcode_i = opcode_table.at(opcode);
             if(operand == "") {
                 flags |= flag_n | flag_i;
-                objCode = align_right(itos(opcode_i << 16 | flags << 12, 16), 6, '0');
             } else {
                 locctr += 3;
                 if(isIndexed(operand)) {
                     flags |= flag_n | flag_i | flag_x;
-                    disp = getDisplacement(locctr, flags, operand.substr(0, operand.length() - 2));
+                    disp = getDisplacement(locctr, flags, operand.substr(0, operand.length() - 2), symbol, expression, chunk);
                 } else if(isImmediate(operand)) {
                     flags |= flag_i;
-                    disp = getDisplacement(locctr, flags, operand.substr(1));
+                    disp = getDisplacement(locctr, flags, operand.substr(1), symbol, expression, chunk);
                 } else if(isIndirect(operand)) {
                     flags |= flag_n;
-                    disp = getDisplacement(locctr, flags, operand.substr(1));
+                    disp = getDisplacement(locctr, flags, operand.substr(1), symbol, expression, chunk);
                 } else {
                     flags |= flag_n | flag_i;
-                    disp = getDisplacement(locctr, flags, operand);
+                    disp = getDisplacement(locctr, flags, operand, symbol, expression, chunk);
                 }
-
                 locctr -= 3;
-                objCode = align_right(itos(opcode_i << 16 | flags << 12 | disp, 16), 6, '0');
             }
+
+            // opcode (6 bits) | nixbpe | 12 bit displacement
+            append_word(chunk.bytes, opcode_i << 16 | flags << 12 | (disp & 0xFFF), 3);
         }
-    } else if(opcode == "BYTE") {
+    } else if(directive == mnemonic::BYTE) {
         if(toupper(operand[0]) == 'C') {
-            for(int i = 2; i < operand.length() - 1; i++) {
-                objCode += align_right(itos(operand[i], 16), 2, '0');
+            if(operand.length() >= 3) chunk.bytes.append(operand, 2, operand.length() - 3);
+        } else if(toupper(operand[0]) == 'X' && operand.length() >= 3 && operand.length() % 2 == 1) {
+            for(unsigned int i = 2; i + 1 < operand.length(); i += 2) {
+                int high = hex_digit(operand[i]), low = hex_digit(operand[i + 1]);
+                if(high < 0 || low < 0) { // invalid operand
+                    chunk.error_flag |= 64 | 8;
+                    return;
+                }
+                chunk.bytes += (char)(high << 4 | low);
             }
-        } else if(toupper(operand[0]) == 'X') {
-            objCode = operand.substr(2, operand.length() - 3);
         } else { // invalid operand
-            this->error_flag |= 64 | 8;
-            objCode = "";
+            chunk.error_flag |= 64 | 8;
         }
-    } else if(opcode == "WORD") {
-        disp = _stoi(operand, 10);
-        if(disp < 0) disp += 1 << 24;
-        objCode = align_right(itos(disp, 16), 6, '0');
-    } else if(opcode == "RESB" || opcode == "RESW") {
-        objCode = "";
+    } else if(directive == mnemonic::WORD && expression >= 0) {
+        // a relative word moves with the program, an external one is added at link time
+        Expression::value word;
+        if(!this->operand_value(-1, expression, locctr, word)) {
+            chunk.error_flag |= 64 | 4;
+            return;
+        }
+        if(word.relative == 1) chunk.m_records.push_back(modification_record{locctr, 6, -1, false});
+        for(unsigned int i = 0; i < word.externals.size(); i++) {
+            chunk.m_records.push_back(modification_record{locctr, 6, word.externals[i].symbol, word.externals[i].negative});
+        }
+        append_word(chunk.bytes, word.number & 0xFFFFFF, 3);
+    } else if(directive == mnemonic::WORD) {
+        append_word(chunk.bytes, _stoi(operand, 10) & 0xFFFFFF, 3);
+    } else if(directive == mnemonic::RESB || directive == mnemonic::RESW || directive == mnemonic::LTORG
+        || directive == mnemonic::EXTDEF || directive == mnemonic::EXTREF || directive == mnemonic::EQU || directive == mnemonic::ORG) {
+        // reserved storage has no object code, pool entries have lines of their own
     } else { // invalid opcode
-        this->error_flag |= 64 | 16;
-        objCode = "";
+        chunk.error_flag |= 64 | 16;
     }
-
-    return objCode;
 }
 
-int SICXEAssembler::getAddress(int &locctr, string operand) {
-    if(isNumber(operand)) {
+int SICXEAssembler::getAddress(int locctr, string operand, int symbol, int expression, pass2_chunk &chunk) const {
+    Expression::value target;
+    if(expression < 0 && isNumber(operand)) {
         return _stoi(operand);
-    } else if(symbol_table.find(operand) != symbol_table.end()) {
-        modification_record m_record;
-        m_record.address = locctr + 1;
-        m_record.length = 5;
-        this->m_records.push_back(m_record);
-        return symbol_table.at(operand);
+    } else if(this->operand_value(symbol, expression, locctr, target)) {
+        // a relative address moves with the program, an external one is all in its M record
+        if(target.relative == 1) chunk.m_records.push_back(modification_record{locctr + 1, 5, -1, false});
+        for(unsigned int i = 0; i < target.externals.size(); i++) {
+            chunk.m_records.push_back(modification_record{locctr + 1, 5, target.externals[i].symbol, target.externals[i].negative});
+        }
+        return target.number;
     } else {
-        this->error_flag |= 64 | 4;
+        chunk.error_flag |= 64 | 4;
         return 0;
     }
 }
 
-int SICXEAssembler::getDisplacement(int &locctr, int &flags, string operand) {
+int SICXEAssembler::getDisplacement(int locctr, unsigned int &flags, string operand, int symbol, int expression, pass2_chunk &chunk) const {
     int disp = 0;
-    if(isNumber(operand)) {
+    Expression::value target;
+    if(expression < 0 && isNumber(operand)) {
         disp = _stoi(operand);
-    } else if(symbol_table.find(operand) != symbol_table.end()) {
-        disp = symbol_table.at(operand);
-        if(disp - locctr >= -2048 && disp - locctr <= 2047) { // Use PC relative
+    } else if(this->operand_value(symbol, expression, locctr - 3, target) && target.externals.empty()) {
+        disp = target.number;
+        if(target.relative == 0) { // an absolute value is the displacement itself
+            if(disp < 0 || disp > 4095) {
+                chunk.error_flag |= 64 | 8;
+                disp = 0;
+            }
+        } else if(disp - locctr >= -2048 && disp - locctr <= 2047) { // Use PC relative
             flags |= flag_p;
             disp -= locctr;
             if(disp < 0) disp += 1 << 12;
-        } else if(this->base != -1 && disp - this->base >= 0 && disp - this->base <= 4095) { // Use base relative
+        } else if(chunk.base != -1 && disp - chunk.base >= 0 && disp - chunk.base <= 4095) { // Use base relative
             flags |= flag_b;
-            disp -= this->base;
+            disp -= chunk.base;
         } else {
-            this->error_flag |= 64 | 8;
+            chunk.error_flag |= 64 | 8;
             disp = 0;
         }
-    } else {
-        this->error_flag |= 64 | 8;
+    } else { // undefined, or external and only reachable by format 4
+        chunk.error_flag |= 64 | 8;
         disp = 0;
     }
 
     return disp;
 }
 
+bool SICXEAssembler::isOperation(string_view token) {
+    // operations that may appear without a label or without an operand
+    const mnemonic *entry = MnemonicTable::find(token);
+    return entry != nullptr && (entry->directive == mnemonic::INSTRUCTION || entry->directive == mnemonic::START
+        || entry->directive == mnemonic::END || entry->directive == mnemonic::BASE || entry->directive == mnemonic::NOBASE
+        || entry->directive == mnemonic::LTORG || entry->directive == mnemonic::CSECT || entry->directive == mnemonic::EXTDEF
+        || entry->directive == mnemonic::EXTREF || entry->directive == mnemonic::ORG);
+}
+
 bool SICXEAssembler::isImmediate(string operand) {
     return operand[0] == '#';
 }
@@ -466,38 +834,97 @@ bool SICXEAssembler::isIndexed(string operand) {
     return operand[operand.length() - 2] == ',' && operand[operand.length() - 1] == 'X';
 }
 
-void SICXEAssembler::process_text_record(text_record &t_record, int &address, string &obj_code) {
-    if(t_record.start_address + t_record.length < address) {
-        if(obj_code != "") {
-            this->write_text_record(t_record);
-            t_record = initialize_text_record(address);
-        } else return;
+bool SICXEAssembler::isLiteral(string operand) {
+    return operand[0] == '=';
+}
+
+bool SICXEAssembler::parse_literal(string_view literal, string &bytes) {
+    bytes.clear();
+    if(literal.length() < 2 || literal[0] != '=') return false;
+    literal.remove_prefix(1);
+
+    char kind = toupper(literal[0]);
+    if((kind == 'C' || kind == 'X') && literal.length() >= 4 && literal[1] == '\'' && literal.back() == '\'') {
+        string_view text = literal.substr(2, literal.length() - 3);
+        if(kind == 'C') {
+            bytes.assign(text);
+            return true;
+        }
+        if(text.length() % 2 == 1) return false;
+        for(unsigned int i = 0; i < text.length(); i += 2) {
+            int high = hex_digit(text[i]), low = hex_digit(text[i + 1]);
+            if(high < 0 || low < 0) return false;
+            bytes += (char)(high << 4 | low);
+        }
+        return true;
     }
 
-    string obj_code_tmp = obj_code;
-    int tmp;
-    while(t_record.length * 2 + obj_code_tmp.length() > 60) {
-        tmp = 60 - t_record.length * 2;
-        if(tmp > 6) {
-            t_record.object_codes += obj_code_tmp.substr(0, tmp);
-            obj_code_tmp = obj_code_tmp.substr(tmp, obj_code_tmp.length() - tmp);
-            t_record.length += tmp / 2;
+    // a decimal number is a word, like WORD
+    for(unsigned int i = literal[0] == '-' ? 1 : 0; i < literal.length(); i++) {
+        if(literal[i] < '0' || literal[i] > '9') return false;
+    }
+    if(literal == "-") return false;
+    append_word(bytes, _stoi(string(literal), 10) & 0xFFFFFF, 3);
+    return true;
+}
+
+void SICXEAssembler::start_text_record(text_record &t_record, int address) const {
+    // reserving is a no-op once the buffer has held a record of this size
+    t_record.start_address = address;
+    t_record.length = 0;
+    t_record.object_codes.clear();
+    t_record.object_codes.reserve(this->text_record_size);
+}
+
+void SICXEAssembler::process_text_record(text_record &t_record, int address, string_view obj_code, OutputStream *out) const {
+    // object code is raw bytes here, a record holds at most 'text_record_size' bytes
+    if(t_record.start_address + t_record.length != address) {
+        if(obj_code.length() == 0) return;
+        // reserved storage left a gap, or ORG moved the location counter back
+        if(t_record.length > 0 || t_record.start_address < address) this->write_text_record(t_record, out);
+        this->start_text_record(t_record, address);
+    }
+
+    int size = this->text_record_size, room;
+    while(t_record.length + (int)obj_code.length() > size) {
+        room = size - t_record.length;
+        // only what is longer than an instruction fills the record up
+        if(room > 3) {
+            t_record.object_codes.append(obj_code.data(), room);
+            obj_code.remove_prefix(room);
+            t_record.length += room;
         }
-        this->write_text_record(t_record);
-        tmp = t_record.start_address + t_record.length;
-        t_record = initialize_text_record(tmp);
+        this->write_text_record(t_record, out);
+        this->start_text_record(t_record, t_record.start_address + t_record.length);
     }
-    t_record.object_codes += obj_code_tmp;
-    t_record.length += obj_code_tmp.length() / 2;
+    t_record.object_codes.append(obj_code.data(), obj_code.length());
+    t_record.length += obj_code.length();
+}
+
+void SICXEAssembler::write_text_record(const text_record &t_record, OutputStream *out) const {
+    // the digits go to a buffer on the stack, the stream gets views of it
+    static const string separator = sep();
+    unsigned char fields[4] = {(unsigned char)(t_record.start_address >> 16), (unsigned char)(t_record.start_address >> 8),
+        (unsigned char)t_record.start_address, (unsigned char)t_record.length};
+    char digits[8 + 2 * max_text_record_size + 1];
+    hex_encode(fields, 4, digits);
+    hex_encode((const unsigned char*)t_record.object_codes.data(), t_record.length, digits + 8);
+    digits[8 + 2 * t_record.length] = '\n';
+    Stats::count(Stats::T_RECORDS);
+    out->write_batch({"T", separator, string_view(digits, 6), separator, string_view(digits + 6, 2), separator,
+        string_view(digits + 8, 2 * t_record.length + 1)});
 }
 
-void SICXEAssembler::write_text_record(text_record &t_record) const {
-    this->output_object->write("T" + sep() + align_right(itos(t_record.start_address, 16), 6, '0')
-    + sep() + align_right(itos(t_record.length, 16), 2, '0') + sep() + t_record.object_codes + '\n');
+void SICXEAssembler::write_listing_line(const instruction &line, string &obj_code) const {
+    // no listing stream means no listing
+    if(this->output_listing == nullptr) return;
+    if(line.comment) this->output_listing->write_batch({this->format_line(line), "\n"});
+    else this->output_listing->write_batch({this->format_line(line), "\t", align_right(obj_code, 10, ' '), "\n"});
 }
 
-void SICXEAssembler::write_listing_line(string &intermediate_line, string &obj_code) const {
-    this->output_listing->write(intermediate_line + '\t' + align_right(obj_code, 10, ' ') + '\n');
+bool SICXEAssembler::binary_output() const {
+    // binary objects have no place for external symbols
+    return this->output_binary != nullptr && !this->control_sections;
 }
 
 bool SICXEAssembler::assemble() {
@@ -505,102 +932,33 @@ bool SICXEAssembler::assemble() {
         return false;
     }
 
-    if (!pass2()) {
-        return false;
-    }
-
-    return true;
+    bool result = pass2();
+    this->output_object->flush();
+    if(this->output_listing != nullptr) this->output_listing->flush();
+    if(this->output_binary != nullptr) this->output_binary->flush();
+    return result;
 }
 
-bool SICXEAssembler::parse_input_line(string line, string& label, string& opcode, string& operand) {
+bool SICXEAssembler::parse_input_line(string_view line, string& label, string& opcode, string& operand) {
     // split 'line' into 'label', 'opcode', and 'operand'
     // return true if parsing is successful, false otherwise
     // if 'line' is empty, return false
-    line = dealign_left(line, '\t');
-    
-    vector<string> tokens;
-    string token = "";
-    for(int i = 0; i < line.length(); i++) {
-        if(!isSpace(line[i])) {
-            token += line[i];
-        } else {
-            if(tokens.size() >= 2) {
-                token += line[i];
-            } else if(token != "") {
-                tokens.push_back(token);
-                token = "";
-            }
-        }
+    source_tokens tokens;
+    if(!tokenize_line(line, tokens)) return false;
+
+    // assigning reuses the strings' buffers, so steady state parsing does not allocate
+    label.assign(tokens.label);
+    opcode.assign(tokens.opcode);
+    operand.assign(tokens.operand);
+    if(tokens.opcode.data() != tokens.folded) {
+        for(unsigned int i = 0; i < opcode.length(); i++) opcode[i] = toupper(opcode[i]);
     }
-
-    token = dealign_left(dealign_right(token, ' '), ' ');
-    if(token != "") tokens.push_back(token);
-
-    if(tokens.size() == 0) return false;
-    if(tokens.size() == 1) {
-        label = "";
-        opcode = upper(tokens[0]);
-        operand = "";
-    } else if(tokens.size() == 2) {
-        if(opcode_table.find(upper(tokens[0])) != opcode_table.end() || (isExtended(tokens[0]) && opcode_table.find(getOpcode(tokens[0])) != opcode_table.end()) || upper(tokens[0]) == "START" || upper(tokens[0]) == "END" || upper(tokens[0]) == "BASE" || upper(tokens[0]) == "NOBASE") {
-            label = "";
-            opcode = upper(tokens[0]);
-            operand = tokens[1];
-        } else {
-            if(opcode_table.find(upper(tokens[1])) != opcode_table.end() || (isExtended(tokens[1]) && opcode_table.find(getOpcode(tokens[1])) != opcode_table.end()) || upper(tokens[1]) == "START" || upper(tokens[1]) == "END" || upper(tokens[1]) == "BASE" || upper(tokens[1]) == "NOBASE") {
-                label = tokens[0];
-                opcode = upper(tokens[1]);
-                operand = "";
-            } else return false;
-        }
-    } else {
-        label = tokens[0];
-        opcode = upper(tokens[1]);
-        operand = tokens[2];
-    }
-
-    return true;
-}
-
-bool SICXEAssembler::input_is_comment(string line) {
-    // return true if 'line' is a comment, false otherwise
-    return line[0] == '.' || line == "";
-}
-
-bool SICXEAssembler::parse_intermediate_line(string line, int &line_number, int& address, string& label, string& opcode, string& operand) {
-    vector<string> tokens = split(line, "\t");
-    if(tokens.size() != 5) return false;
-    line_number = _stoi(dealign_right(tokens[0], ' '), 10);
-    address = _stoi(dealign_right(tokens[1], ' '), 16);
-    label = dealign_right(tokens[2], ' ');
-    opcode = dealign_right(tokens[3], ' ');
-    operand = dealign_right(tokens[4], ' ');
-    if(opcode == "") return false;
     return true;
 }
 
-bool SICXEAssembler::intermediate_is_comment(string line) {
+bool SICXEAssembler::input_is_comment(string_view line) {
     // return true if 'line' is a comment, false otherwise
-    int i = 0;
-    for(; i < line.length() && line[i] != '\t'; i++);
-    if(i >= line.length()) return true;
-    else {
-        i++;
-        for(; i < line.length() && line[i] != '\t'; i++);
-        if(i >= line.length()) return true;
-        else {
-            return line[i+1] == '.';
-        }
-    }
-}
-
-SICXEAssembler::text_record SICXEAssembler::initialize_text_record(int address) {
-    // return the initialized text record
-    text_record t_record;
-    t_record.start_address = address;
-    t_record.length = 0;
-    t_record.object_codes = "";
-    return t_record;
+    return line.empty() || line[0] == '.';
 }
 
 void SICXEAssembler::setInputStream(InputStream *input) {
@@ -611,7 +969,7 @@ void SICXEAssembler::setOutputObjectStream(OutputStream *output_object) {
     this->output_object = output_object;
 }
 
-void SICXEAssembler::setIntermediateStream(fstream *intermediate) {
+void SICXEAssembler::setIntermediateStream(ostream *intermediate) {
     this->intermediate = intermediate;
 }
 
@@ -619,14 +977,41 @@ void SICXEAssembler::setOutputListingStream(OutputStream *output_listing) {
     this->output_listing = output_listing;
 }
 
-void SICXEAssembler::setSymbolTable(unordered_map<string, int> symbol_table) {
-    this->symbol_table = symbol_table;
+void SICXEAssembler::setOutputBinaryStream(OutputStream *output_binary, bool symbols) {
+    this->output_binary = output_binary;
+    this->binary_symbols = symbols;
+}
+
+void SICXEAssembler::setSymbolTable(const unordered_map<string, int> &symbol_table) {
+    this->symbol_table.clear();
+    for(unordered_map<string, int>::const_iterator it = symbol_table.begin(); it != symbol_table.end(); it++) {
+        this->symbol_table.define(this->symbol_table.intern(it->first), it->second);
+    }
 }
 
 void SICXEAssembler::setProgramLength(int program_length) {
     this->program_length = program_length;
 }
 
+void SICXEAssembler::setPipeline(bool pipelined, unsigned int depth) {
+    this->pipelined = pipelined;
+    this->pipeline_depth = depth > 0 ? depth : 1;
+}
+
+void SICXEAssembler::setRelaxation(bool relaxing) {
+    this->relaxing = relaxing;
+}
+
+void SICXEAssembler::setTextRecordSize(unsigned int size) {
+    // a record always has room for a format 4 instruction, instructions are never split
+    this->text_record_size = min(max(size, 4u), max_text_record_size);
+}
+
+void SICXEAssembler::setThreadPool(ThreadPool *pool, unsigned int chunk_lines) {
+    this->pool = pool;
+    this->chunk_lines = chunk_lines > 0 ? chunk_lines : 1;
+}
+
 InputStream *SICXEAssembler::getInputStream() {
     return this->input;
 }
@@ -635,7 +1020,7 @@ OutputStream *SICXEAssembler::getOutputObjectStream() {
     return this->output_object;
 }
 
-fstream *SICXEAssembler::getIntermediateStream() {
+ostream *SICXEAssembler::getIntermediateStream() {
     return this->intermediate;
 }
 
@@ -643,8 +1028,30 @@ OutputStream *SICXEAssembler::getOutputListingStream() {
     return this->output_listing;
 }
 
-unordered_map<string, int> SICXEAssembler::getSymbolTable() {
-    return this->symbol_table;
+OutputStream *SICXEAssembler::getOutputBinaryStream() {
+    return this->output_binary;
+}
+
+const SymbolTable& SICXEAssembler::getSymbolTable() const {
+    return this->sections.empty() ? this->symbol_table : this->sections[0]->assembler->symbol_table;
+}
+
+unsigned int SICXEAssembler::getSectionCount() const {
+    return this->sections.size();
+}
+
+bool SICXEAssembler::hasControlSections() const {
+    return !this->sections.empty() || this->control_sections;
+}
+
+unsigned int SICXEAssembler::getRelaxedCount() const {
+    unsigned int count = this->relaxed_lines;
+    for(unsigned int i = 0; i < this->sections.size(); i++) count += this->sections[i]->assembler->relaxed_lines;
+    return count;
+}
+
+unsigned int SICXEAssembler::getTextRecordSize() const {
+    return this->text_record_size;
 }
 
 int SICXEAssembler::getProgramLength() {
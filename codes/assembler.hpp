@@ -1,6 +1,18 @@
+#pragma once
 #include<stream.hpp>
 #include<utility.hpp>
-#include<set>
+#include<mnemonic_table.hpp>
+#include<symbol_table.hpp>
+#include<tokenizer.hpp>
+#include<macro.hpp>
+#include<hex.hpp>
+#include<thread_pool.hpp>
+#include<spsc_ring.hpp>
+#include<stats.hpp>
+#include<object_file.hpp>
+#include<expression.hpp>
+#include<functional>
+#include<memory>
 #include<unordered_map>
 #include<vector>
 
@@ -8,84 +20,333 @@ using namespace std;
 
 class SICXEAssembler {
     struct instruction {
+        int line_number;
+        int address;
+        int length;
+        bool comment; // comment lines keep their text in 'operand'
         string label;
         string opcode;
         string operand;
-        int address;
+        int symbol; // id of the symbol the operand refers to, -1 if none
+        int expression; // compiled operand if it is an expression, -1 if not
+    };
+
+    // a literal waiting for the next LTORG or END to place its pool
+    struct literal {
+        int symbol; // pool entry, named by the literal's bytes and pool
         int length;
+        string spelling; // as first written, the pool line shows it
     };
 
+    // the record being filled; its buffer is reserved for a whole record once and appended to in
+    // place, starting the next record clears it without giving the storage back
     struct text_record {
         int start_address;
         int length;
-        string object_codes;
+        string object_codes; // raw bytes, hex encoded when written
     };
 
     struct modification_record {
         int address;
         int length;
+        int symbol; // external symbol whose value is added, -1 for the section's own address
+        bool negative; // the value is subtracted
+    };
+
+    // where the bytes of one line are in its chunk's buffer
+    struct object_code {
+        unsigned int offset;
+        unsigned int length;
+    };
+
+    // pass 2 state of a run of program lines, chunks are encoded independently
+    struct pass2_chunk {
+        unsigned int begin;
+        unsigned int end;
+        int base; // BASE in effect while encoding
+        int base_out; // BASE after the chunk, -2 if the chunk does not change it
+        int error_flag;
+        unsigned int error_line; // first failing line, 'end' if none
+        vector<modification_record> m_records;
+        string bytes; // raw object code of the chunk
+        string listing;
+    };
+
+    // how the object code of a line depends on the symbol it refers to: not at all, on the
+    // distance to it, on the distances to it and to BASE, or on where it is (format 4)
+    enum dependency { INDEPENDENT, PC_RELATIVE, BASE_RELATIVE, ABSOLUTE };
+
+    // what incremental reassembly remembers about one program line
+    struct line_state {
+        int base; // symbol whose value is the BASE in effect before the line, -1 if none
+        dependency uses;
+        string bytes; // raw object code
+        text_record after; // text record being built after this line
+    };
+
+    // an output of incremental reassembly kept whole between edits, with a piece of it per
+    // program line; the Fenwick tree finds where a piece starts without adding up the lines before
+    struct line_text {
+        string text;
+        string spare; // the text is merged into it when pieces change length, then they swap
+        vector<unsigned int> lengths; // of each line's piece
+        vector<size_t> offsets; // Fenwick tree of 'lengths', one element more than there are lines
+    };
+
+    // the object code of one line on its way to the writer
+    struct encoded_line {
+        unsigned int index;
+        string bytes;
+    };
+
+    // a forward reference of the one-pass mode, patched when its symbol is defined
+    struct fixup {
+        int address;
+        unsigned int word; // object code with an empty address field
+        bool extended;
+        int symbol; // symbol the instruction addresses
+        int base; // BASE in effect, -1 if none
+        int base_symbol; // BASE symbol that was still undefined, -1 if none
+    };
+
+    // a symbol defined by EQU; one whose expression uses symbols not yet defined waits
+    // for them and is resolved when its value is first asked for
+    struct equate {
+        int expression;
+        int location; // of the EQU line, for '*'
+        unsigned int line; // index of the EQU line in the program
+        int state; // 0 waiting, 1 being resolved, 2 defined, 3 failed to evaluate
+    };
+
+    // an instruction relaxation may widen, with the lines its displacement depends on
+    struct relax_candidate {
+        unsigned int line;
+        int symbol; // operand, -1 if it is an expression
+        int expression;
+        int base; // BASE symbol in effect, -1 if none
+        unsigned int low, high; // a line widened in [low, high) changes the displacement
+        bool widened;
+    };
+
+    // symbol values as the lines widened so far moved them
+    struct relax_state {
+        vector<int> widened; // Fenwick tree of the widened lines
+        vector<int> defined_at; // symbol id -> line of its label, -1 if none
+        vector<bool> equate; // the symbol is defined by EQU
+        vector<int> equated; // value of an EQU symbol, evaluated again every round
+    };
+
+    // one control section of a program that has several, assembled by an assembler of its own
+    struct control_section {
+        MemoryInputStream input;
+        StringOutputStream object;
+        StringOutputStream listing;
+        unique_ptr<SICXEAssembler> assembler;
+        bool result;
     };
 
     private:
         InputStream* input;
         OutputStream* output_object;
-        fstream* intermediate;
+        ostream* intermediate;
         OutputStream* output_listing;
-        unordered_map<string, int> symbol_table;
+        OutputStream* output_binary;
+        bool binary_symbols;
+        SymbolTable symbol_table;
+        vector<instruction> program; // pass 1 -> pass 2 handoff
         vector<modification_record> m_records;
-        int base;
+        ThreadPool* pool;
+        unsigned int chunk_lines;
+        bool pipelined;
+        unsigned int pipeline_depth;
+        unsigned int text_record_size; // bytes a text record holds at most
         int start_address;
         int program_length;
         int error_flag;
+        bool generated_lines; // macro expansions or literal pools, so program lines no longer match source lines
+        vector<literal> literals; // used since the last pool
+        int literal_pools; // pools placed so far
+        // control sections
+        bool control_sections; // CSECT, EXTDEF or EXTREF are used, M records name what they add
+        bool section_continues; // more sections follow, this one ends with its input instead of END
+        string_view macro_source; // earlier source text whose macro definitions apply to this section
+        vector<unique_ptr<control_section> > sections; // empty unless the program was split
+        // incremental reassembly
+        bool incremental_ready;
+        vector<string> source_lines;
+        vector<line_state> line_cache;
+        vector<vector<unsigned int> > references; // symbol id -> lines that use it
+        vector<unsigned int> positional_lines; // base relative and ABSOLUTE lines, in order
+        line_text listing_text;
+        line_text record_text; // text records completed by each line
+        line_text modification_text; // modification record of each line
+        // one-pass mode
+        unordered_map<int, vector<fixup> > fixups; // undefined symbol id -> references waiting for it
+        size_t length_field; // where the one-pass H record's length went in the object, npos if the stream cannot go back
+        // expressions
+        vector<Expression> expressions; // operands and EQU values, by index
+        unordered_map<int, equate> equates; // symbol id -> its EQU line
+        vector<int> equate_order; // EQU symbols in the order they were defined, dependencies first
+        bool expression_lines; // EQU, ORG or an expression operand is used
+        int org_return; // location counter before the last ORG with an operand, -1 if none
+        // relaxation
+        bool relaxing;
+        unsigned int relaxed_lines;
 
-        void write_comment(int &line_number, string &comment) const;
+        string format_line(const instruction &line) const;
+        string format_number(const instruction &line) const;
+        string format_fields(const instruction &line) const;
+        string header_record(const instruction &line) const;
         // pass 1
+        bool read_source_line(source_line &line);
+        bool read_program(SpscRing<source_line> *lines = nullptr);
+        void define_macros(MacroProcessor &macros) const;
         instruction process_instruction(int &locctr, string &label, string &opcode, string &operand);
-        void write_intermediate_line(int &line_number, instruction &processed_instruction) const;
+        instruction make_comment(string_view comment) const;
+        int intern_literal(const string &spelling);
+        vector<instruction> literal_pool(int &locctr);
+        string referenced_symbol(const instruction &line) const;
+        void write_intermediate() const;
+        void external_symbols(const instruction &line);
+        bool finish_program();
+        // expressions
+        int compile_expression(string_view text);
+        bool expression_value(string_view text, int location, Expression::value &result);
+        bool absolute_value(string_view text, int location, Expression::value &result);
+        void add_equate(int symbol, int expression, int location);
+        bool resolve_equate(int symbol);
+        bool resolve_equates();
+        bool operand_value(int symbol, int expression, int location, Expression::value &result) const;
         // pass 2
-        string toObjCode(int &address, string &opcode, string &operand);
-        int getAddress(int &locctr, string operand);
-        int getDisplacement(int &locctr, int &flags, string operand);
-        void process_text_record(text_record& t_record, int &address, string &obj_code);
-        void write_text_record(text_record& t_record) const;
-        void write_listing_line(string &intermediate_line, string &obj_code) const;
-
-        static OutputStream *fake_output_stream;
-        static const unordered_map<string, unsigned char> opcode_table;
-        static const unordered_map<string, set<unsigned char>> format_table;
+        bool encode_program(unsigned int begin, unsigned int end, text_record &t_record, ObjectProgram &binary);
+        int last_base(const pass2_chunk &chunk) const;
+        void encode_chunk(pass2_chunk &chunk, vector<object_code> &object_codes) const;
+        void encode_line(const instruction &line, pass2_chunk &chunk, object_code &code) const;
+        void encode_object(const instruction &line, pass2_chunk &chunk, object_code &code) const;
+        void toObjCode(int locctr, const string &opcode, const string &operand, int symbol, int expression, pass2_chunk &chunk) const;
+        int getAddress(int locctr, string operand, int symbol, int expression, pass2_chunk &chunk) const;
+        int getDisplacement(int locctr, unsigned int &flags, string operand, int symbol, int expression, pass2_chunk &chunk) const;
+        void start_text_record(text_record& t_record, int address) const;
+        void process_text_record(text_record& t_record, int address, string_view obj_code, OutputStream* out) const;
+        void write_text_record(const text_record& t_record, OutputStream* out) const;
+        void write_listing_line(const instruction &line, string &obj_code) const;
+        bool write_link_records(unsigned int first);
+        bool binary_output() const;
+        // control sections
+        static vector<string_view> find_sections(string_view source, vector<size_t> &macro_ends);
+        bool read_sections(const vector<string_view> &slices, const vector<size_t> &macro_ends, string_view source);
+        bool encode_sections();
+        void run_sections(const function<bool(SICXEAssembler&)> &step);
+        // pipeline
+        bool read_pipelined();
+        bool encode_pipelined(unsigned int begin, unsigned int end, text_record &t_record, ObjectProgram &binary);
+        void write_pipelined(SpscRing<encoded_line> &lines, text_record &t_record, ObjectProgram &binary) const;
+        // incremental reassembly
+        bool rebuild_incremental();
+        bool program_bounds(unsigned int &first, unsigned int &begin, unsigned int &end) const;
+        void add_reference(unsigned int index);
+        void remove_reference(unsigned int index);
+        void move_lines(unsigned int from, int shift, bool renumber);
+        void crossing_lines(unsigned int moved, int edit_address, int shift, vector<unsigned int> &affected) const;
+        int base_after(unsigned int index) const;
+        void set_dependency(unsigned int index, dependency uses);
+        bool reencode_lines(vector<unsigned int> &affected, vector<unsigned int> &changed);
+        void rebuild_text_records(const vector<unsigned int> &changed);
+        void write_incremental() const;
+        static line_state empty_line_state();
+        static size_t piece_offset(const line_text &text, unsigned int line);
+        static void index_pieces(line_text &text);
+        static void splice_pieces(line_text &text, unsigned int first, unsigned int removed, unsigned int inserted);
+        static void replace_pieces(line_text &text, const vector<unsigned int> &lines, const vector<string> &pieces);
+        // one-pass mode
+        bool encode_one_pass(const instruction &line, int base, int base_symbol, text_record &t_record);
+        bool define_symbol(int symbol, text_record &t_record);
+        bool encode_literals(int &locctr, text_record &t_record);
+        void patch_object_code(int address, string_view bytes, text_record &t_record) const;
+        void write_one_pass_header(const instruction &line);
+        void write_m_records(const text_record &t_record, bool all);
+        bool finish_one_pass(bool result);
+        // relaxation
+        void relax_program();
+        int relax_value(int symbol, const relax_state &state) const;
+        void relax_equates(relax_state &state) const;
+        bool relax_fits(const relax_candidate &c, const relax_state &state) const;
+
         static const unordered_map<string, unsigned char> register_table;
 
     public:
-        SICXEAssembler(InputStream* input, OutputStream* output_object, fstream* intermediate, OutputStream* output_listing = fake_output_stream);
+        SICXEAssembler(InputStream* input, OutputStream* output_object, ostream* intermediate = nullptr, OutputStream* output_listing = nullptr);
         bool pass1();
         bool pass2();
         bool assemble();
+        // assemble like assemble() but remember per line state, so edits can be
+        // reassembled by re-encoding only the lines they affect; no intermediate file
+        bool assembleIncremental();
+        // replace 'removed' lines starting at 'first' with 'lines'; only the lines whose object
+        // code the edit changes are encoded again and only their records rebuilt, the lines it
+        // merely moves get their addresses patched, then the whole object program and listing
+        // are written again
+        bool updateLines(unsigned int first, unsigned int removed, const vector<string> &lines);
+        // diff 'input' against the last source and reassemble the changed lines
+        bool reassemble(InputStream* input);
+        // assemble while reading, forward references are patched with extra text records once
+        // their symbol is defined; no listing, no intermediate file and no stored source, the
+        // H record carries a zero length because the length is only known at END
+        bool assembleOnePass();
 
         void setInputStream(InputStream* input);
         void setOutputObjectStream(OutputStream* output_object);
-        void setIntermediateStream(fstream* intermediate);
+        void setIntermediateStream(ostream* intermediate);
         void setOutputListingStream(OutputStream* output_listing);
-        void setSymbolTable(unordered_map<string, int> symbol_table);
+        // pass 2 also writes a binary object, with the defined symbols if 'symbols'; nullptr for none
+        void setOutputBinaryStream(OutputStream* output_binary, bool symbols = true);
+        void setSymbolTable(const unordered_map<string, int> &symbol_table);
         void setProgramLength(int program_length);
+        // encode pass 2 in chunks of 'chunk_lines' lines on 'pool', nullptr to stay on the calling thread
+        void setThreadPool(ThreadPool* pool, unsigned int chunk_lines = 4096);
+        // read and split lines on a reader thread and write text records and the listing on a
+        // writer thread, connected to the assembling thread by rings of 'depth' lines; pass 2
+        // then encodes on the calling thread and the thread pool is not used
+        void setPipeline(bool pipelined, unsigned int depth = 1024);
+        // pass 1 picks the format of instructions written without '+': format 3 unless the
+        // operand is out of its reach; one-pass mode writes format 3 regardless and so do
+        // programs with ORG, whose lines do not all move with the lines before them
+        void setRelaxation(bool relaxing);
+        // text records hold up to 'size' bytes, 30 like the textbook's by default and at most
+        // 255, all a record's length field can count; data longer than an instruction is split
+        void setTextRecordSize(unsigned int size);
 
         InputStream* getInputStream();
         OutputStream* getOutputObjectStream();
-        fstream* getIntermediateStream();
+        ostream* getIntermediateStream();
         OutputStream* getOutputListingStream();
-        unordered_map<string, int> getSymbolTable();
+        OutputStream* getOutputBinaryStream();
+        // a view of the symbol table, valid until the next assembly; the first section's if
+        // the program has several
+        const SymbolTable& getSymbolTable() const;
+        // 0 for a program without CSECT
+        unsigned int getSectionCount() const;
+        // CSECT, EXTDEF or EXTREF are used; such programs get no binary object
+        bool hasControlSections() const;
+        // instructions the last pass 1 widened to format 4
+        unsigned int getRelaxedCount() const;
+        unsigned int getTextRecordSize() const;
         int getProgramLength();
         int getErrorFlag();
 
         static bool isExtended(string opcode);
         static string getOpcode(string extend_opcode);
+        static bool isOperation(string_view token);
         static bool isImmediate(string operand);
         static bool isIndirect(string operand);
         static bool isIndexed(string operand);
+        static bool isLiteral(string operand);
+        // bytes of =C'text', =X'hex' or =decimal (a word), false if 'literal' is none of them
+        static bool parse_literal(string_view literal, string &bytes);
         // pass 1
-        static bool parse_input_line(string line, string& label, string& opcode, string& operand);
-        static bool input_is_comment(string line);
-        // pass 2
-        static bool parse_intermediate_line(string line, int &line_number, int& address, string& label, string& opcode, string& operand);
-        static bool intermediate_is_comment(string line);
-        static text_record initialize_text_record(int address);
+        static bool parse_input_line(string_view line, string& label, string& opcode, string& operand);
+        static bool input_is_comment(string_view line);
+
+        static constexpr unsigned int default_text_record_size = 30;
+        static constexpr unsigned int max_text_record_size = 255;
 };
\ No newline at end of file
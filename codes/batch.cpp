@@ -0,0 +1,88 @@
+#include "batch.hpp"
+#include<fstream>
+
+BatchAssembler::BatchAssembler(unsigned int threads): threads(threads) { }
+
+string BatchAssembler::getOutputName(string input) {
+    // drop the extension of the file name, so 'dir/prog.asm' gives 'dir/prog'
+    size_t slash = input.find_last_of("/\\");
+    size_t dot = input.find_last_of('.');
+    if(dot == string::npos || (slash != string::npos && dot < slash) || dot == (slash == string::npos ? 0 : slash + 1)) return input;
+    return input.substr(0, dot);
+}
+
+bool BatchAssembler::addJob(string input, string output) {
+    job j;
+    j.input = input;
+    j.output = output == "" ? getOutputName(input) : output;
+    j.success = false;
+    j.error_flag = 0;
+    // 'a.asm' and 'a.s' both give 'a'
+    if(!this->outputs.insert(j.output).second) {
+        if(this->duplicate == "") this->duplicate = j.output;
+        return false;
+    }
+    this->jobs.push_back(j);
+    return true;
+}
+
+bool BatchAssembler::loadManifest(string filename) {
+    ifstream manifest(filename);
+    string line;
+    if(!manifest.is_open()) return false;
+
+    while(getline(manifest, line)) {
+        vector<string> fields;
+        string field = "";
+        for(unsigned int i = 0; i <= line.length(); i++) {
+            if(i == line.length() || isSpace(line[i]) || line[i] == '\r') {
+                if(field != "") fields.push_back(field);
+                field = "";
+            } else field += line[i];
+        }
+
+        if(fields.size() == 0 || fields[0][0] == '#') continue;
+        this->addJob(fields[0], fields.size() > 1 ? fields[1] : "");
+    }
+    return true;
+}
+
+void BatchAssembler::run_job(job &j) {
+    // every job owns its streams and assembler, nothing is shared between jobs
+    FileInputStream input(j.input);
+    FileOutputStream object_file(j.output + ".obj");
+    FileOutputStream listing_file(j.output + ".lst");
+    BufferedOutputStream output_object(&object_file);
+    BufferedOutputStream output_listing(&listing_file);
+    SICXEAssembler assembler(&input, &output_object, nullptr, &output_listing);
+
+    try {
+        j.success = assembler.assemble();
+    } catch(exception &e) { // e.g. BASE with an undefined symbol
+        j.success = false;
+    }
+    j.error_flag = assembler.getErrorFlag();
+}
+
+bool BatchAssembler::run() {
+    ThreadPool pool(this->threads);
+    TaskGroup group;
+    bool result = true;
+
+    for(unsigned int i = 0; i < this->jobs.size(); i++) {
+        job *j = &this->jobs[i];
+        pool.submit(group, [j] { run_job(*j); });
+    }
+    pool.wait(group);
+
+    for(unsigned int i = 0; i < this->jobs.size(); i++) result = result && this->jobs[i].success;
+    return result;
+}
+
+const vector<BatchAssembler::job>& BatchAssembler::getJobs() const {
+    return this->jobs;
+}
+
+const string& BatchAssembler::getDuplicate() const {
+    return this->duplicate;
+}
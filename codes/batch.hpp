@@ -0,0 +1,40 @@
+#pragma once
+#include<assembler.hpp>
+#include<thread_pool.hpp>
+#include<unordered_set>
+
+using namespace std;
+
+// assembles many independent programs at once, one SICXEAssembler per job
+class BatchAssembler {
+    public:
+        struct job {
+            string input;
+            string output; // output path without extension
+            bool success;
+            int error_flag;
+        };
+
+    private:
+        vector<job> jobs;
+        unordered_set<string> outputs; // output names taken by a job
+        string duplicate; // the first output name a job was refused for
+        unsigned int threads;
+
+        static void run_job(job &j);
+
+    public:
+        BatchAssembler(unsigned int threads = thread::hardware_concurrency());
+        // false if another job already writes 'output', two jobs would write the same files at once
+        bool addJob(string input, string output = "");
+        // one job per line: an input file, optionally followed by an output name; false if the
+        // file cannot be opened, a line whose output is taken is refused like addJob() does
+        bool loadManifest(string filename);
+        bool run();
+
+        const vector<job>& getJobs() const;
+        // empty if no job was refused
+        const string& getDuplicate() const;
+
+        static string getOutputName(string input);
+};
@@ -0,0 +1,973 @@
+#include<assembler.hpp>
+#include<sicxe.h>
+#include<batch.hpp>
+#include<linker.hpp>
+#include<server.hpp>
+#include<simulator.hpp>
+#include<chrono>
+#include<algorithm>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<random>
+#include<set>
+#include<sstream>
+#include<string>
+#include<unordered_map>
+#include<vector>
+#ifndef _WIN32
+#include<sys/resource.h>
+#include<sys/wait.h>
+#include<fcntl.h>
+#include<spawn.h>
+#include<unistd.h>
+#endif
+
+using namespace std;
+
+// keeps the optimizer from dropping benchmark results
+static volatile long long sink;
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(string name, long long operations, double seconds) {
+    cout << name << ": " << operations / seconds / 1e6 << " M lookups/s (" << seconds * 1e9 / operations << " ns/lookup)" << endl;
+}
+
+// the hash maps the assembler used before MnemonicTable, kept here for comparison
+static const unordered_map<string, unsigned char> map_opcode_table = {
+    {"ADD", 0x18}, {"ADDF", 0x58}, {"ADDR", 0x90}, {"AND", 0x40}, {"CLEAR", 0xB4}, {"COMP", 0x28}, {"COMPF", 0x88}, {"COMPR", 0xA0}, {"DIV", 0x24}, {"DIVF", 0x64}, {"DIVR", 0x9C}, {"FIX", 0xC4}, {"FLOAT", 0xC0}, {"HIO", 0xF4}, {"J", 0x3C}, {"JEQ", 0x30}, {"JGT", 0x34}, {"JLT", 0x38}, {"JSUB", 0x48}, {"LDA", 0x00}, {"LDB", 0x68}, {"LDCH", 0x50}, {"LDF", 0x70}, {"LDL", 0x08}, {"LDS", 0x6C}, {"LDT", 0x74}, {"LDX", 0x04}, {"LPS", 0xD0}, {"MUL", 0x20}, {"MULF", 0x60}, {"MULR", 0x98}, {"NORM", 0xC8}, {"OR", 0x44}, {"RD", 0xD8}, {"RMO", 0xAC}, {"RSUB", 0x4C}, {"SHIFTL", 0xA4}, {"SHIFTR", 0xA8}, {"SIO", 0xF0}, {"SSK", 0xEC}, {"STA", 0x0C}, {"STB", 0x78}, {"STCH", 0x54}, {"STF", 0x80}, {"STI", 0xD4}, {"STL", 0x14}, {"STS", 0x7C}, {"STSW", 0xE8}, {"STT", 0x84}, {"STX", 0x10}, {"SUB", 0x1C}, {"SUBF", 0x5C}, {"SUBR", 0x94}, {"SVC", 0xB0}, {"TD", 0xE0}, {"TIO", 0xF8}, {"TIX", 0x2C}, {"TIXR", 0xB8}, {"WD", 0xDC}
+};
+
+static const unordered_map<string, set<unsigned char>> map_format_table = {
+    {"ADD", {3, 4}}, {"ADDF", {3, 4}}, {"ADDR", {2}}, {"AND", {3, 4}}, {"CLEAR", {2}}, {"COMP", {3, 4}}, {"COMPF", {3, 4}}, {"COMPR", {2}}, {"DIV", {3, 4}}, {"DIVF", {3, 4}}, {"DIVR", {2}}, {"FIX", {1}}, {"FLOAT", {1}}, {"HIO", {1}}, {"J", {3, 4}}, {"JEQ", {3, 4}}, {"JGT", {3, 4}}, {"JLT", {3, 4}}, {"JSUB", {3, 4}}, {"LDA", {3, 4}}, {"LDB", {3, 4}}, {"LDCH", {3, 4}}, {"LDF", {3, 4}}, {"LDL", {3, 4}}, {"LDS", {3, 4}}, {"LDT", {3, 4}}, {"LDX", {3, 4}}, {"LPS", {3, 4}}, {"MUL", {3, 4}}, {"MULF", {3, 4}}, {"MULR", {2}}, {"NORM", {1}}, {"OR", {3, 4}}, {"RD", {3, 4}}, {"RMO", {2}}, {"RSUB", {3, 4}}, {"SHIFTL", {2}}, {"SHIFTR", {2}}, {"SIO", {1}}, {"SSK", {3, 4}}, {"STA", {3, 4}}, {"STB", {3, 4}}, {"STCH", {3, 4}}, {"STF", {3, 4}}, {"STI", {3, 4}}, {"STL", {3, 4}}, {"STS", {3, 4}}, {"STSW", {3, 4}}, {"STT", {3, 4}}, {"STX", {3, 4}}, {"SUB", {3, 4}}, {"SUBF", {3, 4}}, {"SUBR", {2}}, {"SVC", {2}}, {"TD", {3, 4}}, {"TIO", {1}}, {"TIX", {3, 4}}, {"TIXR", {2}}, {"WD", {3, 4}}
+};
+
+// look up opcode, length and directive kind the way process_instruction did
+static int map_lookup(const string &opcode) {
+    if(opcode == "WORD" || opcode == "RESW" || opcode == "RESB" || opcode == "BYTE") return 3;
+    auto it = map_opcode_table.find(opcode);
+    if(it != map_opcode_table.end()) {
+        const set<unsigned char> &formats = map_format_table.at(opcode);
+        return it->second + *formats.begin();
+    }
+    if(opcode[0] == '+' && map_opcode_table.find(opcode.substr(1)) != map_opcode_table.end()) return map_opcode_table.at(opcode.substr(1)) + 4;
+    if(opcode == "START" || opcode == "END" || opcode == "BASE" || opcode == "NOBASE") return 0;
+    return -1;
+}
+
+static int table_lookup(const string &opcode) {
+    bool extended;
+    const mnemonic *entry = MnemonicTable::find(opcode, extended);
+    if(entry == nullptr) return -1;
+    if(entry->directive != mnemonic::INSTRUCTION) return entry->directive == mnemonic::START || entry->directive == mnemonic::END
+        || entry->directive == mnemonic::BASE || entry->directive == mnemonic::NOBASE ? 0 : 3;
+    return entry->opcode + (extended ? 4 : entry->length());
+}
+
+static void bench_mnemonic(long long iterations) {
+    // a mix close to real programs: mostly format 3, some extended, directives and misses
+    vector<string> mnemonics = {"LDA", "STA", "JEQ", "+JSUB", "COMP", "CLEAR", "TIXR", "LDCH", "WORD", "RESW", "BYTE", "J", "RSUB", "BASE", "+LDT", "COMPR", "FIX", "TD", "RD", "WD", "STX", "LABEL1", "BUFFER", "END"};
+    long long total = iterations * mnemonics.size();
+    long long sum = 0;
+
+    for(unsigned int i = 0; i < mnemonics.size(); i++) {
+        if(map_lookup(mnemonics[i]) != table_lookup(mnemonics[i])) {
+            cout << "mismatch for " << mnemonics[i] << endl;
+            return;
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    for(long long n = 0; n < iterations; n++) {
+        for(unsigned int i = 0; i < mnemonics.size(); i++) sum += map_lookup(mnemonics[i]);
+    }
+    report("unordered_map opcode_table + format_table", total, seconds_since(start));
+
+    start = chrono::steady_clock::now();
+    for(long long n = 0; n < iterations; n++) {
+        for(unsigned int i = 0; i < mnemonics.size(); i++) sum += table_lookup(mnemonics[i]);
+    }
+    report("perfect hash MnemonicTable", total, seconds_since(start));
+    sink = sum;
+}
+
+static void bench_symbols(long long count) {
+    // defining and looking up 'count' labels the way pass 1 and pass 2 do
+    vector<string> names;
+    mt19937 random(1);
+    for(long long i = 0; i < count; i++) names.push_back("L" + to_string(random() % 1000000) + "_" + to_string(i));
+    vector<unsigned int> order(count);
+    for(long long i = 0; i < count; i++) order[i] = random() % count;
+    long long sum = 0;
+
+    auto start = chrono::steady_clock::now();
+    unordered_map<string, int> map_table;
+    for(long long i = 0; i < count; i++) {
+        if(map_table.find(names[i]) == map_table.end()) map_table[names[i]] = i;
+    }
+    report("unordered_map define", count, seconds_since(start));
+    start = chrono::steady_clock::now();
+    for(long long i = 0; i < count; i++) {
+        const string &name = names[order[i]];
+        if(map_table.find(name) != map_table.end()) sum += map_table.at(name);
+    }
+    report("unordered_map find + at", count, seconds_since(start));
+
+    start = chrono::steady_clock::now();
+    SymbolTable symbols;
+    vector<int> ids(count);
+    for(long long i = 0; i < count; i++) {
+        ids[i] = symbols.intern(names[i]);
+        if(!symbols.isDefined(ids[i])) symbols.define(ids[i], i);
+    }
+    report("SymbolTable define", count, seconds_since(start));
+    start = chrono::steady_clock::now();
+    for(long long i = 0; i < count; i++) {
+        int id = symbols.find(names[order[i]]);
+        if(symbols.isDefined(id)) sum += symbols.getValue(id);
+    }
+    report("SymbolTable find by name", count, seconds_since(start));
+    // pass 2 only ever resolves ids
+    start = chrono::steady_clock::now();
+    for(long long i = 0; i < count; i++) {
+        int id = ids[order[i]];
+        if(symbols.isDefined(id)) sum += symbols.getValue(id);
+    }
+    report("SymbolTable value by id", count, seconds_since(start));
+    sink = sum;
+}
+
+// writes a SIC/XE program of roughly 'lines' lines built from procedures with
+// local loops, forward references to their own data, BASE regions over large
+// buffers and format 4 calls between procedures
+static void generate_program(ostream &out, long long lines, unsigned int seed) {
+    static const char *memory_ops[] = {"LDA", "LDX", "LDS", "LDT", "LDCH", "STA", "STX", "STS", "STT", "STCH", "ADD", "SUB", "MUL", "DIV", "COMP", "AND", "OR", "TIX"};
+    static const char *jump_ops[] = {"J", "JEQ", "JGT", "JLT"};
+    static const char *register_ops[] = {"ADDR", "SUBR", "MULR", "COMPR", "RMO"};
+    static const char *single_register_ops[] = {"CLEAR", "TIXR"};
+    static const char *format1_ops[] = {"FIX", "FLOAT", "NORM", "SIO", "HIO", "TIO"};
+    static const char *registers[] = {"A", "X", "L", "B", "S", "T", "F"};
+    static const char *modes[] = {"", "", "", "#", "@"};
+    mt19937 random(seed);
+    auto pick = [&random](int n) { return (int)(random() % n); };
+    long long written = 1;
+    int blocks = 0;
+
+    out << "BENCH\tSTART\t0\n";
+    while(written < lines) {
+        int b = blocks++;
+        int body = 20 + pick(80), data = 2 + pick(14), code_labels = (body + 7) / 8;
+        bool base_region = pick(10) < 3;
+        string p = "P" + to_string(b);
+
+        out << ". procedure " << b << "\n";
+        out << p << "\tCLEAR\tX\n";
+        written += 2;
+        if(base_region) {
+            out << "\tLDB\t#B" << b << "\n\tBASE\tB" << b << "\n";
+            written += 2;
+        }
+
+        for(int i = 0, label = 0; i < body; i++, written++) {
+            // code labels are spread evenly so jumps stay inside the procedure
+            bool labeled = label < code_labels && i % 8 == 0;
+            if(labeled) out << "L" << b << "_" << label++;
+            int kind = pick(labeled ? 90 : 100);
+            if(kind < 40) {
+                string target = "D" + to_string(b) + "_" + to_string(pick(data));
+                if(pick(6) == 0) out << "\t" << memory_ops[pick(18)] << "\t" << target << ",X\n";
+                else out << "\t" << memory_ops[pick(18)] << "\t" << modes[pick(5)] << target << "\n";
+            } else if(kind < 50) {
+                out << "\t" << jump_ops[pick(4)] << "\tL" << b << "_" << pick(code_labels) << "\n";
+            } else if(kind < 62) {
+                out << "\t" << register_ops[pick(5)] << "\t" << registers[pick(7)] << "," << registers[pick(7)] << "\n";
+            } else if(kind < 67) {
+                out << "\t" << single_register_ops[pick(2)] << "\t" << registers[pick(7)] << "\n";
+            } else if(kind < 70) {
+                out << "\t" << format1_ops[pick(6)] << "\n";
+            } else if(kind < 75) {
+                out << "\t+JSUB\tP" << pick(b + 1) << "\n";
+            } else if(kind < 80) {
+                out << "\t+LDA\t#" << pick(1 << 20) << "\n";
+            } else if(kind < 85 && base_region) {
+                out << "\tSTA\tE" << b << "\n";
+            } else if(kind < 90) {
+                out << "\tLDA\t#" << pick(4096) << "\n";
+            } else {
+                out << ". step " << i << " of procedure " << b << "\n";
+            }
+        }
+
+        if(base_region) {
+            out << "\tNOBASE\n";
+            written++;
+        }
+        out << "\tRSUB\n";
+        written++;
+
+        for(int i = 0; i < data; i++, written++) {
+            out << "D" << b << "_" << i;
+            int kind = pick(4);
+            if(kind == 0) {
+                out << "\tWORD\t" << (int)pick(1 << 23) - (1 << 22) << "\n";
+            } else if(kind == 1) {
+                out << "\tBYTE\tC'";
+                for(int c = 1 + pick(12); c > 0; c--) out << (char)('A' + pick(26));
+                out << "'\n";
+            } else if(kind == 2) {
+                out << "\tBYTE\tX'";
+                for(int c = 1 + pick(8); c > 0; c--) out << "0123456789ABCDEF"[pick(16)] << "0123456789ABCDEF"[pick(16)];
+                out << "'\n";
+            } else {
+                out << "\tRESW\t" << 1 + pick(10) << "\n";
+            }
+        }
+
+        // large buffer that is only reachable through BASE
+        if(base_region) {
+            out << "B" << b << "\tRESB\t3000\nE" << b << "\tWORD\t0\n";
+            written += 2;
+        }
+    }
+    out << "\tEND\tP0\n";
+}
+
+// parse_input_line as it was before tokenize_line, kept here for comparison; an operand
+// that is empty once its spaces are removed used to crash it and is skipped instead
+static bool legacy_parse_input_line(string line, string& label, string& opcode, string& operand) {
+    while(line.length() > 0 && line.back() == '\t') line.pop_back();
+
+    vector<string> tokens;
+    string token = "";
+    for(unsigned int i = 0; i < line.length(); i++) {
+        if(!isSpace(line[i])) {
+            token += line[i];
+        } else {
+            if(tokens.size() >= 2) {
+                token += line[i];
+            } else if(token != "") {
+                tokens.push_back(token);
+                token = "";
+            }
+        }
+    }
+
+    token = dealign_right(token, ' ');
+    if(token != "") token = dealign_left(token, ' ');
+    if(token != "") tokens.push_back(token);
+
+    if(tokens.size() == 0) return false;
+    if(tokens.size() == 1) {
+        label = "";
+        opcode = upper(tokens[0]);
+        operand = "";
+    } else if(tokens.size() == 2) {
+        if(SICXEAssembler::isOperation(tokens[0])) {
+            label = "";
+            opcode = upper(tokens[0]);
+            operand = tokens[1];
+        } else {
+            if(SICXEAssembler::isOperation(tokens[1])) {
+                label = tokens[0];
+                opcode = upper(tokens[1]);
+                operand = "";
+            } else return false;
+        }
+    } else {
+        label = tokens[0];
+        opcode = upper(tokens[1]);
+        operand = tokens[2];
+    }
+
+    return true;
+}
+
+static void bench_tokenize(long long lines) {
+    stringstream generated;
+    generate_program(generated, lines, 1);
+    string source = generated.str();
+    vector<string_view> views;
+    MemoryInputStream input(source);
+    while(!input.eof()) {
+        string_view line = input.readline_view();
+        if(!SICXEAssembler::input_is_comment(line)) views.push_back(line);
+    }
+    // every line is parsed many times so the timing is not dominated by cache misses on the source
+    const int rounds = 20;
+    long long total = (long long)views.size() * rounds;
+    long long sum = 0;
+    string label, opcode, operand, legacy_label, legacy_opcode, legacy_operand;
+
+    for(unsigned int i = 0; i < views.size(); i++) {
+        bool result = SICXEAssembler::parse_input_line(views[i], label, opcode, operand);
+        bool legacy = legacy_parse_input_line(string(views[i]), legacy_label, legacy_opcode, legacy_operand);
+        if(result != legacy || (result && (label != legacy_label || opcode != legacy_opcode || operand != legacy_operand))) {
+            cout << "mismatch for " << views[i] << endl;
+            return;
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    for(int n = 0; n < rounds; n++) {
+        for(unsigned int i = 0; i < views.size(); i++) sum += legacy_parse_input_line(string(views[i]), label, opcode, operand) + operand.length();
+    }
+    double seconds = seconds_since(start);
+    cout << "old parse_input_line: " << seconds * 1e9 / total << " ns/line" << endl;
+
+    start = chrono::steady_clock::now();
+    for(int n = 0; n < rounds; n++) {
+        for(unsigned int i = 0; i < views.size(); i++) sum += SICXEAssembler::parse_input_line(views[i], label, opcode, operand) + operand.length();
+    }
+    seconds = seconds_since(start);
+    cout << "parse_input_line: " << seconds * 1e9 / total << " ns/line" << endl;
+
+    source_tokens tokens;
+    start = chrono::steady_clock::now();
+    for(int n = 0; n < rounds; n++) {
+        for(unsigned int i = 0; i < views.size(); i++) sum += tokenize_line(views[i], tokens) + tokens.operand.length();
+    }
+    seconds = seconds_since(start);
+    cout << "tokenize_line: " << seconds * 1e9 / total << " ns/line" << endl;
+    sink = sum;
+}
+
+static long peak_rss_kb() {
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+static void report_phase(string phase, long long lines, long long bytes, double seconds) {
+    cout << "  " << align_right(phase, 8, ' ') << ": " << align_right(to_string((long long)(lines / seconds)), 12, ' ') << " lines/s "
+        << align_right(to_string((long long)(bytes / seconds / 1e6)), 8, ' ') << " MB/s " << seconds * 1e3 << " ms" << endl;
+}
+
+static bool bench_assemble(string source, unsigned int threads) {
+    long long lines = 0;
+
+    // read: map the file and split it into lines
+    auto start = chrono::steady_clock::now();
+    FileInputStream file(source);
+    while(!file.eof()) {
+        file.readline_view();
+        lines++;
+    }
+    double read_time = seconds_since(start);
+    long long source_bytes = file.getContents().length();
+    if(source_bytes == 0) {
+        cout << "Cannot read " << source << endl;
+        return false;
+    }
+
+    // both passes work in memory, output is timed on its own
+    MemoryInputStream input(file.getContents());
+    StringOutputStream object, listing;
+    SICXEAssembler assembler(&input, &object, nullptr, &listing);
+    ThreadPool pool(threads);
+    if(threads > 1) assembler.setThreadPool(&pool);
+
+    start = chrono::steady_clock::now();
+    bool result = assembler.pass1();
+    double pass1_time = seconds_since(start);
+
+    start = chrono::steady_clock::now();
+    result = result && assembler.pass2();
+    double pass2_time = seconds_since(start);
+    long long output_bytes = object.getString().length() + listing.getString().length();
+
+    start = chrono::steady_clock::now();
+    {
+        string name = BatchAssembler::getOutputName(source);
+        FileOutputStream object_file(name + ".obj"), listing_file(name + ".lst");
+        object_file.write(object.getString());
+        listing_file.write(listing.getString());
+    }
+    double output_time = seconds_since(start);
+
+    cout << source << ": " << lines << " lines, " << source_bytes << " bytes, " << (result ? "assembled" : "failed")
+        << ", error flag " << assembler.getErrorFlag() << ", " << threads << " thread(s)" << endl;
+    report_phase("read", lines, source_bytes, read_time);
+    report_phase("pass 1", lines, source_bytes, pass1_time);
+    report_phase("pass 2", lines, output_bytes, pass2_time);
+    report_phase("output", lines, output_bytes, output_time);
+    report_phase("total", lines, source_bytes, read_time + pass1_time + pass2_time + output_time);
+    cout << "  peak RSS: " << peak_rss_kb() << " KB" << endl;
+    return result;
+}
+
+static bool bench_pipeline(long long lines, long long rounds) {
+    // whole assemblies from a file to files, on one thread and pipelined
+    string source = "bench_" + to_string(lines) + ".asm";
+    {
+        ofstream out(source);
+        generate_program(out, lines, 1);
+    }
+    string name = BatchAssembler::getOutputName(source);
+    bool result = true;
+    for(int pipelined = 0; pipelined < 2; pipelined++) {
+        auto start = chrono::steady_clock::now();
+        for(long long i = 0; i < rounds; i++) {
+            FileInputStream input(source);
+            FileOutputStream object_file(name + ".obj"), listing_file(name + ".lst");
+            BufferedOutputStream object(&object_file), listing(&listing_file);
+            SICXEAssembler assembler(&input, &object, nullptr, &listing);
+            assembler.setPipeline(pipelined == 1);
+            result = assembler.assemble() && result;
+        }
+        cout << (pipelined ? "  pipelined: " : "     serial: ") << seconds_since(start) * 1e3 / rounds << " ms/assembly" << endl;
+    }
+    return result;
+}
+
+static bool bench_library(long long lines, long long calls) {
+    // small programs assembled over and over, a new assembler and streams for every one against
+    // one library handle that keeps its memory between calls
+    stringstream generated;
+    generate_program(generated, lines, 1);
+    string source = generated.str();
+    bool result = true;
+
+    auto start = chrono::steady_clock::now();
+    for(long long i = 0; i < calls; i++) {
+        MemoryInputStream input(source);
+        StringOutputStream object, listing;
+        SICXEAssembler assembler(&input, &object, nullptr, &listing);
+        result = assembler.assemble() && result;
+    }
+    double fresh_time = seconds_since(start) / calls;
+
+    sicxe_assembler *library = sicxe_create();
+    sicxe_result output;
+    memset(&output, 0, sizeof(output));
+    start = chrono::steady_clock::now();
+    for(long long i = 0; i < calls; i++) result = sicxe_assemble(library, source.data(), source.length(), SICXE_LISTING, &output) && result;
+    double library_time = seconds_since(start) / calls;
+    sicxe_destroy(library);
+
+    cout << lines << " lines, " << calls << " calls, " << (result ? "assembled" : "failed") << endl;
+    cout << "      fresh: " << fresh_time * 1e6 << " us/call" << endl;
+    cout << "    library: " << library_time * 1e6 << " us/call" << endl;
+    return result;
+}
+
+static bool bench_macro(long long invocations) {
+    // the same program with its macros invoked and written out by hand, both through pass 1;
+    // 'invocations' calls of two macros over 64 argument lists
+    stringstream source, expanded;
+    mt19937 random(1);
+    source << "BENCH\tSTART\t0\n"
+        << "SAVE\tMACRO\t&A,&B\n\t+LDA\t&A\n\t+STA\t&B\n\tMEND\n"
+        << "WAIT\tMACRO\t&DEV\n$LOOP\t+TD\t&DEV\n\tJEQ\t$LOOP\n\tMEND\n";
+    expanded << "BENCH\tSTART\t0\n";
+    for(long long i = 0; i < invocations; i++) {
+        string a = "V" + to_string(random() % 64), b = "V" + to_string(random() % 64);
+        if(i % 2 == 0) {
+            source << "\tSAVE\t" << a << "," << b << "\n";
+            expanded << "\t+LDA\t" << a << "\n\t+STA\t" << b << "\n";
+        } else {
+            source << "\tWAIT\t" << a << "\n";
+            expanded << "L" << i << "\t+TD\t" << a << "\n\tJEQ\tL" << i << "\n";
+        }
+    }
+    for(int i = 0; i < 64; i++) {
+        source << "V" << i << "\tWORD\t" << i << "\n";
+        expanded << "V" << i << "\tWORD\t" << i << "\n";
+    }
+    source << "\tEND\tBENCH\n";
+    expanded << "\tEND\tBENCH\n";
+
+    bool result = true;
+    string texts[2] = {expanded.str(), source.str()};
+    for(int i = 0; i < 2; i++) {
+        MemoryInputStream input(texts[i]);
+        StringOutputStream object;
+        SICXEAssembler assembler(&input, &object);
+        auto start = chrono::steady_clock::now();
+        bool passed = assembler.pass1();
+        double pass1_time = seconds_since(start);
+        start = chrono::steady_clock::now();
+        passed = passed && assembler.pass2();
+        double pass2_time = seconds_since(start);
+        cout << (i == 0 ? "  expanded: " : "    macros: ") << (passed ? "assembled" : "failed") << ", error flag " << assembler.getErrorFlag()
+            << ", pass 1 " << pass1_time * 1e3 << " ms, pass 2 " << pass2_time * 1e3 << " ms" << endl;
+        result = result && passed;
+    }
+    return result;
+}
+
+static bool bench_literal(long long uses) {
+    // constants written out at every use site against literals, pooled every 300 uses;
+    // the uses draw from 128 distinct values
+    stringstream source, constants, pooled;
+    mt19937 random(1);
+    const char *operations[3] = {"LDA", "COMP", "ADD"};
+    source << "BENCH\tSTART\t0\n";
+    pooled << "BENCH\tSTART\t0\n";
+    for(long long i = 0; i < uses; i++) {
+        unsigned int value = random() % 128;
+        string operation = operations[random() % 3], literal;
+        if(value % 3 == 0) {
+            literal = "C'" + string(1, 'A' + value % 26) + string(1, 'A' + value / 26) + "Z'";
+            constants << "K" << i << "\tBYTE\t" << literal << "\n";
+            literal = "=" + literal;
+        } else {
+            constants << "K" << i << "\tWORD\t" << value << "\n";
+            literal = "=" + to_string(value);
+        }
+        source << "\t" << operation << "\tK" << i << "\n";
+        pooled << "\t" << operation << "\t" << literal << "\n";
+        if(i % 300 == 299 || i == uses - 1) {
+            source << "\tRSUB\n" << constants.str();
+            pooled << "\tRSUB\n\tLTORG\n";
+            constants.str("");
+        }
+    }
+    source << "\tEND\tBENCH\n";
+    pooled << "\tEND\tBENCH\n";
+
+    bool result = true;
+    string texts[2] = {source.str(), pooled.str()};
+    for(int i = 0; i < 2; i++) {
+        MemoryInputStream input(texts[i]);
+        StringOutputStream object;
+        SICXEAssembler assembler(&input, &object);
+        auto start = chrono::steady_clock::now();
+        bool passed = assembler.pass1();
+        double pass1_time = seconds_since(start);
+        start = chrono::steady_clock::now();
+        passed = passed && assembler.pass2();
+        double pass2_time = seconds_since(start);
+        cout << (i == 0 ? " constants: " : "  literals: ") << (passed ? "assembled" : "failed") << ", error flag " << assembler.getErrorFlag()
+            << ", program " << assembler.getProgramLength() << " bytes, object " << object.getString().length() << " bytes, "
+            << assembler.getSymbolTable().size() << " symbols, pass 1 " << pass1_time * 1e3 << " ms, pass 2 " << pass2_time * 1e3 << " ms" << endl;
+        result = result && passed;
+    }
+    return result;
+}
+
+static bool bench_records(long long lines, long long rounds) {
+    // the same program written with text records of different sizes, pass 2 and loading timed
+    stringstream generated;
+    generate_program(generated, lines, 1);
+    string source = generated.str();
+    vector<unsigned char> memory(1 << 20);
+    ObjectLoader loader(memory.data(), memory.size());
+    bool result = true;
+
+    const unsigned int sizes[3] = {SICXEAssembler::default_text_record_size, 64, SICXEAssembler::max_text_record_size};
+    for(int i = 0; i < 3; i++) {
+        MemoryInputStream input(source);
+        StringOutputStream object;
+        SICXEAssembler assembler(&input, &object);
+        assembler.setTextRecordSize(sizes[i]);
+        bool passed = assembler.pass1();
+        auto start = chrono::steady_clock::now();
+        passed = passed && assembler.pass2();
+        double pass2_time = seconds_since(start);
+
+        const string &text = object.getString();
+        long long records = text[0] == 'T';
+        for(size_t j = text.find("\nT"); j != string::npos; j = text.find("\nT", j + 1)) records++;
+        start = chrono::steady_clock::now();
+        for(long long j = 0; j < rounds; j++) {
+            MemoryInputStream loaded(text);
+            passed = loader.load(&loaded) && passed;
+        }
+        double load_time = seconds_since(start) / rounds;
+        cout << align_right(to_string(sizes[i]), 4, ' ') << " bytes: " << (passed ? "loaded" : "failed") << ", "
+            << records << " T records, " << text.length() << " bytes of object, pass 2 "
+            << pass2_time * 1e3 << " ms, " << load_time * 1e3 << " ms/load" << endl;
+        result = result && passed;
+    }
+    return result;
+}
+
+static bool bench_relax(long long lines) {
+    // the generated program as written, with '+' by hand, against the same program without
+    // any '+', assembled as is and with relaxation picking the formats
+    stringstream generated;
+    generate_program(generated, lines, 1);
+    string hand = generated.str(), plain = hand;
+    plain.erase(remove(plain.begin(), plain.end(), '+'), plain.end());
+
+    bool result = true;
+    const char *names[3] = {"  hand '+': ", "   no '+': ", "   relaxed: "};
+    string texts[3] = {hand, plain, plain};
+    for(int i = 0; i < 3; i++) {
+        MemoryInputStream input(texts[i]);
+        StringOutputStream object;
+        SICXEAssembler assembler(&input, &object);
+        assembler.setRelaxation(i == 2);
+        auto start = chrono::steady_clock::now();
+        bool passed = assembler.pass1();
+        double pass1_time = seconds_since(start);
+        start = chrono::steady_clock::now();
+        passed = passed && assembler.pass2();
+        double pass2_time = seconds_since(start);
+        cout << names[i] << (passed ? "assembled" : "failed") << ", error flag " << assembler.getErrorFlag()
+            << ", program " << assembler.getProgramLength() << " bytes, " << assembler.getRelaxedCount() << " widened, pass 1 "
+            << pass1_time * 1e3 << " ms, pass 2 " << pass2_time * 1e3 << " ms" << endl;
+        // without '+' the far operands cannot be encoded, that is the point of the comparison
+        if(i != 1) result = result && passed;
+    }
+    return result;
+}
+
+static bool bench_sections(long long lines, long long count, unsigned int threads) {
+    // one program of 'count' control sections of generated code, assembled on one thread
+    // and on 'threads'; every section has its own symbols, so labels may repeat
+    stringstream source;
+    for(long long i = 0; i < count; i++) {
+        stringstream section;
+        generate_program(section, lines / count, i + 1);
+        string text = section.str();
+        if(i > 0) text.replace(0, text.find('\n'), "S" + to_string(i) + "\tCSECT");
+        if(i + 1 < count) text.resize(text.rfind("\tEND"));
+        source << text;
+    }
+
+    bool result = true;
+    string text = source.str();
+    for(unsigned int jobs : {1u, threads}) {
+        MemoryInputStream input(text);
+        StringOutputStream object, listing;
+        SICXEAssembler assembler(&input, &object, nullptr, &listing);
+        ThreadPool pool(jobs);
+        if(jobs > 1) assembler.setThreadPool(&pool);
+        auto start = chrono::steady_clock::now();
+        bool passed = assembler.pass1();
+        double pass1_time = seconds_since(start);
+        start = chrono::steady_clock::now();
+        passed = passed && assembler.pass2();
+        double pass2_time = seconds_since(start);
+        cout << "  " << align_right(to_string(jobs), 2, ' ') << " thread(s): " << (passed ? "assembled" : "failed") << ", error flag " << assembler.getErrorFlag()
+            << ", " << assembler.getSectionCount() << " sections, pass 1 " << pass1_time * 1e3 << " ms, pass 2 " << pass2_time * 1e3 << " ms" << endl;
+        result = result && passed;
+    }
+    return result;
+}
+
+static bool bench_link(long long modules, long long rounds, unsigned int threads) {
+    // 'modules' objects of a routine each, calling two other ones and reading a word of a third;
+    // they are assembled once and then linked on one thread and on 'threads'
+    vector<string> objects;
+    mt19937 random(1);
+    auto other = [&random, modules](long long i) { return to_string((i + 1 + random() % (modules - 1)) % modules); };
+    for(long long i = 0; i < modules; i++) {
+        string name = "M" + to_string(i), a = "R" + other(i), b = "R" + other(i), c = "V" + other(i);
+        stringstream source;
+        source << name << "\tSTART\t0\n\tEXTDEF\tR" << i << ",V" << i << "\n\tEXTREF\t" << a << "," << b << "," << c << "\n"
+            << "R" << i << "\tSTL\tRET\n\t+LDA\t" << c << "\n\tADD\tV" << i << "\n\tSTA\tV" << i << "\n"
+            << "\t+JSUB\t" << a << "\n\t+JSUB\t" << b << "\n\tLDL\tRET\n\tRSUB\n"
+            << "V" << i << "\tWORD\t" << i << "\nRET\tRESW\t1\nTABLE\tWORD\tTABLE\n\tEND\tR" << i << "\n";
+        string text = source.str();
+        MemoryInputStream input(text);
+        StringOutputStream object;
+        SICXEAssembler assembler(&input, &object);
+        if(!assembler.assemble()) {
+            cout << "Cannot assemble module " << i << ", error flag " << assembler.getErrorFlag() << endl;
+            return false;
+        }
+        objects.push_back(object.getString());
+    }
+
+    vector<unsigned char> memory(1 << 24);
+    bool result = true;
+    for(unsigned int jobs : {1u, threads}) {
+        LinkingLoader linker(memory.data(), memory.size());
+        ThreadPool pool(jobs);
+        if(jobs > 1) linker.setThreadPool(&pool);
+        for(unsigned int i = 0; i < objects.size(); i++) linker.addObject(objects[i]);
+        auto start = chrono::steady_clock::now();
+        for(long long i = 0; i < rounds; i++) result = linker.link() && result;
+        cout << "  " << align_right(to_string(jobs), 2, ' ') << " thread(s): " << (result ? "linked" : "failed") << ", error flag " << linker.getErrorFlag()
+            << ", " << linker.getSectionCount() << " sections, " << linker.getSymbolCount() << " symbols, " << linker.getProgramLength() << " bytes, "
+            << seconds_since(start) * 1e3 / rounds << " ms/link" << endl;
+    }
+    return result;
+}
+
+// mean, median and 99th percentile of 'samples' in microseconds
+static void report_latency(string name, vector<double> samples) {
+    double total = 0;
+    sort(samples.begin(), samples.end());
+    for(unsigned int i = 0; i < samples.size(); i++) total += samples[i];
+    cout << "  " << align_right(name, 12, ' ') << ": mean " << total / samples.size() * 1e6 << " us, p50 " << samples[samples.size() / 2] * 1e6
+        << " us, p99 " << samples[samples.size() * 99 / 100] * 1e6 << " us" << endl;
+}
+
+static bool bench_daemon(long long requests, string executable, unsigned int threads) {
+    // one small program assembled through a server on one connection, on a connection per
+    // request and by a process per request
+#ifndef _WIN32
+    string source = "bench_daemon.asm", socket_path = "/tmp/sic-xe-bench-" + to_string(getpid()) + ".sock";
+    {
+        ofstream out(source);
+        generate_program(out, 200, 1);
+    }
+    FileInputStream file(source);
+
+    AssemblerServer server(threads);
+    if(!server.listen(socket_path)) {
+        cout << "Cannot listen on " << socket_path << endl;
+        return false;
+    }
+    thread serving([&server] { server.run(); });
+    vector<double> warm, connecting, spawned;
+    server_response response;
+    string object, listing, binary;
+    bool result = true;
+
+    AssemblerClient client;
+    result = client.connect(socket_path);
+    for(long long i = 0; i < requests && result; i++) {
+        auto start = chrono::steady_clock::now();
+        result = client.request(REQUEST_LISTING, file.getContents(), "", response, object, listing, binary) && response.success;
+        warm.push_back(seconds_since(start));
+    }
+    for(long long i = 0; i < requests && result; i++) {
+        auto start = chrono::steady_clock::now();
+        AssemblerClient once;
+        result = once.connect(socket_path) && once.request(REQUEST_LISTING, file.getContents(), "", response, object, listing, binary) && response.success;
+        connecting.push_back(seconds_since(start));
+    }
+    result = result && client.request(REQUEST_STOP, "", "", response, object, listing, binary);
+    serving.join();
+    if(!result) {
+        cout << "A request failed" << endl;
+        return false;
+    }
+
+    // the executable writes bench_daemon.obj, .lst and .int like any run would
+    if(access(executable.c_str(), X_OK) == 0) {
+        string output = BatchAssembler::getOutputName(source);
+        char *arguments[] = {&executable[0], &source[0], &output[0], nullptr};
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+        for(long long i = 0; i < requests && result; i++) {
+            auto start = chrono::steady_clock::now();
+            pid_t child;
+            int status;
+            result = posix_spawn(&child, executable.c_str(), &actions, nullptr, arguments, environ) == 0 && waitpid(child, &status, 0) == child
+                && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            spawned.push_back(seconds_since(start));
+        }
+        posix_spawn_file_actions_destroy(&actions);
+    }
+
+    cout << requests << " requests of " << file.getContents().length() << " bytes, " << server.getRequestCount() << " served" << endl;
+    report_latency("connection", warm);
+    report_latency("reconnect", connecting);
+    if(!spawned.empty()) report_latency("process", spawned);
+    else cout << "  no " << executable << " to start a process per request" << endl;
+    return result;
+#else
+    cout << "No Unix domain sockets" << endl;
+    return false;
+#endif
+}
+
+static bool bench_incremental(long long lines, long long edits) {
+    stringstream generated;
+    generate_program(generated, lines, 1);
+    string source = generated.str();
+    mt19937 random(1);
+
+    MemoryInputStream input(source);
+    StringOutputStream object, listing;
+    SICXEAssembler assembler(&input, &object, nullptr, &listing);
+
+    auto start = chrono::steady_clock::now();
+    bool result = assembler.assembleIncremental();
+    double full_time = seconds_since(start);
+    cout << lines << " lines, " << (result ? "assembled" : "failed") << ", full assembly " << full_time * 1e3 << " ms" << endl;
+    if(!result) return false;
+
+    // rewrite a line in place: nothing moves, only that line is encoded again
+    double edit_time = 0;
+    vector<string> line(1);
+    for(long long i = 0; i < edits; i++) {
+        unsigned int index = 2 + random() % (lines - 2);
+        MemoryInputStream text(source);
+        for(unsigned int j = 0; j <= index; j++) line[0] = string(text.readline_view());
+        object.clear();
+        listing.clear();
+        start = chrono::steady_clock::now();
+        result = assembler.updateLines(index, 1, line) && result;
+        edit_time += seconds_since(start);
+    }
+    cout << "  in place: " << edit_time * 1e3 / edits << " ms/edit" << endl;
+
+    // insert and remove a reserved byte: every later address moves twice
+    edit_time = 0;
+    vector<string> reserve(1, "PAD\tRESB\t1"), none;
+    long long failed = 0;
+    for(long long i = 0; i < edits; i++) {
+        unsigned int index = 2 + random() % (lines - 2);
+        object.clear();
+        listing.clear();
+        start = chrono::steady_clock::now();
+        // moving a jump away from its target can push it out of range, that is reported like any error
+        if(!assembler.updateLines(index, 0, reserve)) failed++;
+        if(!assembler.updateLines(index, 1, none)) failed++;
+        edit_time += seconds_since(start);
+    }
+    cout << "  shifting: " << edit_time * 1e3 / (2 * edits) << " ms/edit, " << failed << " edit(s) failed to assemble" << endl;
+    return result;
+}
+
+static bool bench_simulate(long long rounds) {
+    // an inner loop of 8 instructions run 1000 times per round, with loads, stores and jumps
+    stringstream source;
+    source << "BENCH\tSTART\t0\n\tLDS\t#1\n\tLDA\t#0\n\tSTA\tOUTER\n"
+        << "OLOOP\tLDX\t#0\n"
+        << "ILOOP\tADD\tVALUE\n\tSUB\t#3\n\tAND\tMASK\n\tSTA\tRESULT\n\tCOMP\tRESULT\n\tADDR\tS,A\n\tTIX\tCOUNT\n\tJLT\tILOOP\n"
+        << "\tLDA\tOUTER\n\tADD\t#1\n\tSTA\tOUTER\n\tCOMP\tROUNDS\n\tJLT\tOLOOP\n\tRSUB\n"
+        << "VALUE\tWORD\t5\nMASK\tWORD\t4095\nCOUNT\tWORD\t1000\nROUNDS\tWORD\t" << rounds << "\n"
+        << "OUTER\tRESW\t1\nRESULT\tRESW\t1\n\tEND\tBENCH\n";
+    string text = source.str();
+    MemoryInputStream input(text);
+    StringOutputStream object;
+    SICXEAssembler assembler(&input, &object);
+    if(!assembler.assemble()) {
+        cout << "Cannot assemble the benchmark program, error flag " << assembler.getErrorFlag() << endl;
+        return false;
+    }
+
+    MemoryInputStream program(object.getString());
+    Simulator simulator;
+    ObjectLoader loader(simulator.getMemory(), 1 << 20);
+    if(!simulator.load(loader, &program)) {
+        cout << "Cannot load the benchmark program, error flag " << loader.getErrorFlag() << endl;
+        return false;
+    }
+    bool result = simulator.run();
+    cout << rounds << " rounds, " << (result ? "halted" : "stopped") << ", error flag " << simulator.getErrorFlag() << endl;
+    cout << simulator.report();
+    return result;
+}
+
+static bool bench_load(long long lines, long long rounds) {
+    stringstream generated;
+    generate_program(generated, lines, 1);
+    string source = generated.str();
+    MemoryInputStream input(source);
+    StringOutputStream object, binary;
+    SICXEAssembler assembler(&input, &object);
+    assembler.setOutputBinaryStream(&binary, false);
+    if(!assembler.assemble()) {
+        cout << "Cannot assemble the program, error flag " << assembler.getErrorFlag() << endl;
+        return false;
+    }
+
+    // the binary image is copied once so its tables are aligned like a mapped file
+    vector<unsigned int> aligned(binary.getString().length() / 4 + 1);
+    memcpy(aligned.data(), binary.getString().data(), binary.getString().length());
+    string_view image((const char*)aligned.data(), binary.getString().length());
+    vector<unsigned char> memory(1 << 20);
+    ObjectLoader loader(memory.data(), memory.size());
+    bool result = true;
+
+    auto start = chrono::steady_clock::now();
+    for(long long i = 0; i < rounds; i++) {
+        MemoryInputStream text(object.getString());
+        result = loader.load(&text) && result;
+    }
+    double text_time = seconds_since(start) / rounds;
+    start = chrono::steady_clock::now();
+    for(long long i = 0; i < rounds; i++) result = loader.loadBinary(image) && result;
+    double binary_time = seconds_since(start) / rounds;
+
+    cout << lines << " lines, " << loader.getProgramLength() << " bytes of code, " << (result ? "loaded" : "failed")
+        << ", error flag " << loader.getErrorFlag() << endl;
+    cout << "    text: " << align_right(to_string(object.getString().length()), 10, ' ') << " bytes " << text_time * 1e3 << " ms/load" << endl;
+    cout << "  binary: " << align_right(to_string(binary.getString().length()), 10, ' ') << " bytes " << binary_time * 1e3 << " ms/load" << endl;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    string benchmark = argc > 1 ? argv[1] : "";
+    unsigned int threads = 1;
+    vector<string> args;
+
+    for(int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if(arg.rfind("--jobs=", 0) == 0) threads = max(_stoi(arg.substr(7), 10), 1);
+        else args.push_back(arg);
+    }
+
+    if(benchmark == "mnemonic") {
+        bench_mnemonic(args.size() > 0 ? stoll(args[0]) : 1000000);
+    } else if(benchmark == "symbols") {
+        bench_symbols(args.size() > 0 ? stoll(args[0]) : 200000);
+    } else if(benchmark == "tokenize") {
+        bench_tokenize(args.size() > 0 ? stoll(args[0]) : 100000);
+    } else if(benchmark == "generate" && args.size() >= 2) {
+        ofstream out(args[1]);
+        generate_program(out, stoll(args[0]), args.size() > 2 ? stoul(args[2]) : 1);
+    } else if(benchmark == "assemble" && args.size() >= 1) {
+        // a plain number means a generated program of that many lines
+        for(unsigned int i = 0; i < args.size(); i++) {
+            string source = args[i];
+            if(isNumber(source)) {
+                source = "bench_" + args[i] + ".asm";
+                ofstream out(source);
+                generate_program(out, stoll(args[i]), 1);
+            }
+            if(!bench_assemble(source, threads)) return 2;
+        }
+    } else if(benchmark == "simulate") {
+        if(!bench_simulate(args.size() > 0 ? stoll(args[0]) : 20000)) return 2;
+    } else if(benchmark == "library") {
+        if(!bench_library(args.size() > 0 ? stoll(args[0]) : 200, args.size() > 1 ? stoll(args[1]) : 5000)) return 2;
+    } else if(benchmark == "macro") {
+        if(!bench_macro(args.size() > 0 ? stoll(args[0]) : 50000)) return 2;
+    } else if(benchmark == "literal") {
+        if(!bench_literal(args.size() > 0 ? stoll(args[0]) : 50000)) return 2;
+    } else if(benchmark == "relax") {
+        if(!bench_relax(args.size() > 0 ? stoll(args[0]) : 100000)) return 2;
+    } else if(benchmark == "sections") {
+        if(!bench_sections(args.size() > 0 ? stoll(args[0]) : 200000, args.size() > 1 ? max(stoll(args[1]), 1LL) : 16, max(threads, 4u))) return 2;
+    } else if(benchmark == "link") {
+        if(!bench_link(args.size() > 0 ? max(stoll(args[0]), 2LL) : 5000, args.size() > 1 ? max(stoll(args[1]), 1LL) : 10, max(threads, 4u))) return 2;
+    } else if(benchmark == "daemon") {
+        if(!bench_daemon(args.size() > 0 ? max(stoll(args[0]), 1LL) : 1000, args.size() > 1 ? args[1] : "./SIC-XE.exe", threads)) return 2;
+    } else if(benchmark == "pipeline") {
+        if(!bench_pipeline(args.size() > 0 ? stoll(args[0]) : 100000, args.size() > 1 ? stoll(args[1]) : 5)) return 2;
+    } else if(benchmark == "load") {
+        if(!bench_load(args.size() > 0 ? stoll(args[0]) : 50000, args.size() > 1 ? stoll(args[1]) : 20)) return 2;
+    } else if(benchmark == "records") {
+        if(!bench_records(args.size() > 0 ? stoll(args[0]) : 50000, args.size() > 1 ? stoll(args[1]) : 20)) return 2;
+    } else if(benchmark == "incremental" && args.size() >= 1) {
+        if(!bench_incremental(stoll(args[0]), args.size() > 1 ? stoll(args[1]) : 100)) return 2;
+    } else {
+        cout << "Usage: " << argv[0] << " mnemonic [iterations]" << endl;
+        cout << "       " << argv[0] << " symbols [count]" << endl;
+        cout << "       " << argv[0] << " tokenize [lines]" << endl;
+        cout << "       " << argv[0] << " generate lines output.asm [seed]" << endl;
+        cout << "       " << argv[0] << " assemble [--jobs=N] (input.asm | lines)..." << endl;
+        cout << "       " << argv[0] << " incremental lines [edits]" << endl;
+        cout << "       " << argv[0] << " simulate [rounds]" << endl;
+        cout << "       " << argv[0] << " load [lines] [rounds]" << endl;
+        cout << "       " << argv[0] << " records [lines] [rounds]" << endl;
+        cout << "       " << argv[0] << " pipeline [lines] [rounds]" << endl;
+        cout << "       " << argv[0] << " library [lines] [calls]" << endl;
+        cout << "       " << argv[0] << " macro [invocations]" << endl;
+        cout << "       " << argv[0] << " literal [uses]" << endl;
+        cout << "       " << argv[0] << " relax [lines]" << endl;
+        cout << "       " << argv[0] << " sections [--jobs=N] [lines] [sections]" << endl;
+        cout << "       " << argv[0] << " link [--jobs=N] [modules] [rounds]" << endl;
+        cout << "       " << argv[0] << " daemon [--jobs=N] [requests] [SIC-XE executable]" << endl;
+        return 1;
+    }
+
+    return 0;
+}
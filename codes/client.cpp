@@ -0,0 +1,101 @@
+#include "client.hpp"
+#include<cstring>
+#ifndef _WIN32
+#include<sys/socket.h>
+#include<unistd.h>
+#include<cerrno>
+#endif
+
+bool read_all(int connection, void *data, size_t length) {
+#ifndef _WIN32
+    char *bytes = (char*)data;
+    while(length > 0) {
+        ssize_t count = recv(connection, bytes, length, 0);
+        if(count < 0 && errno == EINTR) continue;
+        if(count <= 0) return false;
+        bytes += count;
+        length -= count;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool write_all(int connection, const void *data, size_t length) {
+#ifndef _WIN32
+    // a peer that went away must not kill the process with SIGPIPE
+    const char *bytes = (const char*)data;
+    while(length > 0) {
+        ssize_t count = send(connection, bytes, length, MSG_NOSIGNAL);
+        if(count < 0 && errno == EINTR) continue;
+        if(count <= 0) return false;
+        bytes += count;
+        length -= count;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+AssemblerClient::AssemblerClient() {
+    this->connection = -1;
+}
+
+bool AssemblerClient::connect(string socket_path) {
+#ifndef _WIN32
+    sockaddr_un address;
+    this->close();
+    if(!socket_address(socket_path, address)) return false;
+    this->connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(this->connection < 0) return false;
+    if(::connect(this->connection, (sockaddr*)&address, sizeof(address)) != 0) {
+        this->close();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool AssemblerClient::request(unsigned int flags, string_view source, string_view output, server_response &response, string &object, string &listing, string &binary) {
+    server_request request;
+    memcpy(request.magic, request_magic, 4);
+    request.flags = flags;
+    request.source_length = source.length();
+    request.output_length = output.length();
+    if(this->connection < 0 || !write_all(this->connection, &request, sizeof(request))
+        || !write_all(this->connection, source.data(), source.length()) || !write_all(this->connection, output.data(), output.length())) {
+        return false;
+    }
+
+    if(!read_all(this->connection, &response, sizeof(response)) || memcmp(response.magic, response_magic, 4) != 0) return false;
+    object.resize(response.object_length);
+    listing.resize(response.listing_length);
+    binary.resize(response.binary_length);
+    return read_all(this->connection, &object[0], object.length()) && read_all(this->connection, &listing[0], listing.length())
+        && read_all(this->connection, &binary[0], binary.length());
+}
+
+void AssemblerClient::close() {
+#ifndef _WIN32
+    if(this->connection >= 0) ::close(this->connection);
+#endif
+    this->connection = -1;
+}
+
+AssemblerClient::~AssemblerClient() {
+    this->close();
+}
+
+#ifndef _WIN32
+bool socket_address(string path, sockaddr_un &address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.length() >= sizeof(address.sun_path)) return false;
+    memcpy(address.sun_path, path.data(), path.length());
+    return true;
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#include<string>
+#include<string_view>
+#ifndef _WIN32
+#include<sys/un.h>
+#endif
+
+using namespace std;
+
+// frames on the socket are little endian 32 bit words like the binary object; a request is its
+// header, the source (text or a path) and the output name, a response is its header and the
+// object, listing and binary object bytes; a connection takes any number of requests
+static const char request_magic[4] = {'S', 'X', 'R', 'Q'};
+static const char response_magic[4] = {'S', 'X', 'R', 'S'};
+
+struct server_request {
+    char magic[4]; // "SXRQ"
+    unsigned int flags;
+    unsigned int source_length;
+    unsigned int output_length; // the output name, without extension, for REQUEST_WRITE_FILES
+};
+
+struct server_response {
+    char magic[4]; // "SXRS"
+    unsigned int success;
+    int error_flag; // -1 if the server failed on the request, out of memory most likely; response_write_failed is or'ed in
+    unsigned int object_length;
+    unsigned int listing_length;
+    unsigned int binary_length;
+};
+
+enum request_flags {
+    REQUEST_SOURCE_PATH = 1, // the source is a path the server reads, else the text itself
+    REQUEST_LISTING = 2,
+    REQUEST_BINARY = 4,
+    REQUEST_WRITE_FILES = 8, // the server writes output.obj, .lst and .bin, nothing is sent back
+    REQUEST_STOP = 16 // the server stops once the request is answered
+};
+
+// error flag bit of a REQUEST_WRITE_FILES response whose files could not all be written,
+// above the assembler's own flags
+static const int response_write_failed = 128;
+
+static const char *const default_server_socket = "/tmp/sic-xe.sock";
+
+// whole frames on a connection, false once it is closed
+bool read_all(int connection, void *data, size_t length);
+bool write_all(int connection, const void *data, size_t length);
+#ifndef _WIN32
+// false if 'path' is too long for a socket
+bool socket_address(string path, sockaddr_un &address);
+#endif
+
+// one connection to an AssemblerServer
+class AssemblerClient {
+    private:
+        int connection;
+
+    public:
+        AssemblerClient();
+        AssemblerClient(const AssemblerClient &other) = delete;
+        AssemblerClient& operator=(const AssemblerClient &other) = delete;
+        bool connect(string socket_path);
+        // sends one request and waits for its response; 'object', 'listing' and 'binary' get
+        // what the server sent back; false if the connection failed
+        bool request(unsigned int flags, string_view source, string_view output, server_response &response, string &object, string &listing, string &binary);
+        void close();
+        ~AssemblerClient();
+};
@@ -0,0 +1,124 @@
+#include "assembler.hpp"
+
+// expressions in pass 1: every EQU symbol is a node of a dependency graph whose edges go to
+// the symbols its expression uses; an EQU whose symbols are all defined is evaluated on its
+// line, the others wait and are resolved depth first, dependencies before the symbols that
+// use them, either when ORG or RESB first needs their value or at the end of pass 1; a symbol
+// is evaluated once and its value kept in the symbol table
+
+int SICXEAssembler::compile_expression(string_view text) {
+    // -1 if 'text' is no valid expression
+    Expression expression;
+    this->expression_lines = true;
+    if(!expression.compile(text, this->symbol_table)) return -1;
+    this->expressions.push_back(move(expression));
+    return this->expressions.size() - 1;
+}
+
+void SICXEAssembler::add_equate(int symbol, int expression, int location) {
+    this->equates[symbol] = equate{expression, location, (unsigned int)this->program.size(), 0};
+    vector<int> uses;
+    this->expressions[expression].getSymbols(uses);
+    for(unsigned int i = 0; i < uses.size(); i++) {
+        if(!this->symbol_table.isDefined(uses[i])) return;
+    }
+    this->resolve_equate(symbol);
+}
+
+bool SICXEAssembler::resolve_equate(int symbol) {
+    // depth first through the EQU symbols 'symbol' waits for; false if one of them uses a
+    // symbol nothing defines, an external one or a symbol that waits for itself
+    vector<int> stack(1, symbol), uses;
+    Expression::value result;
+    bool resolved = true;
+    int failed = -1;
+    while(!stack.empty()) {
+        equate &e = this->equates[stack.back()];
+        if(e.state == 2) {
+            stack.pop_back();
+            continue;
+        }
+        e.state = 1;
+
+        // the first symbol still waiting, if there is one
+        int waiting = -1;
+        uses.clear();
+        this->expressions[e.expression].getSymbols(uses);
+        for(unsigned int i = 0; i < uses.size() && waiting < 0 && resolved; i++) {
+            if(this->symbol_table.isDefined(uses[i])) continue;
+            unordered_map<int, equate>::const_iterator used = this->equates.find(uses[i]);
+            if(used == this->equates.end() || used->second.state == 1 || used->second.state == 3) resolved = false; // undefined, or a cycle
+            else waiting = uses[i];
+        }
+        if(!resolved) break;
+        if(waiting >= 0) {
+            stack.push_back(waiting);
+            continue;
+        }
+
+        if(!this->expressions[e.expression].evaluate(e.location, this->symbol_table, result) || !result.externals.empty()) {
+            // an operand error, overflow or relative terms that do not pair off; it is not tried again
+            this->error_flag |= 8;
+            failed = stack.back();
+            resolved = false;
+            break;
+        }
+        this->symbol_table.define(stack.back(), result.number, result.relative == 0);
+        this->equate_order.push_back(stack.back());
+        e.state = 2;
+        stack.pop_back();
+    }
+
+    // what did not resolve may once more symbols are defined
+    for(unsigned int i = 0; i < stack.size(); i++) this->equates[stack[i]].state = 0;
+    if(failed >= 0) this->equates[failed].state = 3;
+    return resolved;
+}
+
+bool SICXEAssembler::resolve_equates() {
+    // the EQU symbols still waiting at the end of pass 1, in the order of their lines
+    if(this->equates.size() == this->equate_order.size()) return true;
+    for(unsigned int i = 0; i < this->program.size(); i++) {
+        const instruction &line = this->program[i];
+        if(line.comment || line.opcode != "EQU" || line.label == "") continue;
+        int id = this->symbol_table.find(line.label);
+        if(this->equates.count(id) == 0 || this->equates[id].state >= 2) continue;
+        if(!this->resolve_equate(id)) return false;
+    }
+    return true;
+}
+
+bool SICXEAssembler::expression_value(string_view text, int location, Expression::value &result) {
+    // an operand that is needed in pass 1, EQU symbols it uses are resolved now
+    Expression expression;
+    vector<int> uses;
+    this->expression_lines = true;
+    result.number = 0;
+    if(!expression.compile(text, this->symbol_table)) return false;
+    expression.getSymbols(uses);
+    for(unsigned int i = 0; i < uses.size(); i++) {
+        if(!this->symbol_table.isDefined(uses[i]) && this->equates.count(uses[i]) > 0 && !this->resolve_equate(uses[i])) return false;
+    }
+    return expression.evaluate(location, this->symbol_table, result);
+}
+
+bool SICXEAssembler::absolute_value(string_view text, int location, Expression::value &result) {
+    if(!this->expression_value(text, location, result)) return false;
+    return result.relative == 0 && result.externals.empty();
+}
+
+bool SICXEAssembler::operand_value(int symbol, int expression, int location, Expression::value &result) const {
+    // the value of an operand in pass 2, one symbol or a compiled expression
+    if(expression >= 0) return this->expressions[expression].evaluate(location, this->symbol_table, result);
+    result.number = 0;
+    result.relative = 0;
+    result.externals.clear();
+    if(this->symbol_table.isExternal(symbol)) {
+        result.externals.push_back(Expression::term{symbol, false});
+        return true;
+    }
+    if(!this->symbol_table.isDefined(symbol)) return false;
+    result.number = this->symbol_table.getValue(symbol);
+    result.relative = this->symbol_table.isAbsolute(symbol) ? 0 : 1;
+    return true;
+}
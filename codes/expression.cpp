@@ -0,0 +1,107 @@
+#include "expression.hpp"
+
+// a term ends at an operator, a parenthesis or the end of the operand
+static bool is_operator(char c) {
+    return c == '+' || c == '-' || c == '*' || c == '/' || c == '(' || c == ')';
+}
+
+bool Expression::isExpression(string_view operand) {
+    if(operand == "*") return true;
+    for(size_t i = 0; i < operand.length(); i++) {
+        if(is_operator(operand[i]) && !(i == 0 && operand[i] == '-')) return true;
+    }
+    return false;
+}
+
+bool Expression::compile(string_view text, SymbolTable &symbols) {
+    size_t position = 0;
+    this->codes.clear();
+    return this->parse_sum(text, position, symbols) && position == text.length();
+}
+
+bool Expression::parse_sum(string_view text, size_t &position, SymbolTable &symbols) {
+    if(!this->parse_product(text, position, symbols)) return false;
+    while(position < text.length() && (text[position] == '+' || text[position] == '-')) {
+        operation op = text[position++] == '+' ? ADD : SUBTRACT;
+        if(!this->parse_product(text, position, symbols)) return false;
+        this->codes.push_back(code{op, 0});
+    }
+    return true;
+}
+
+bool Expression::parse_product(string_view text, size_t &position, SymbolTable &symbols) {
+    if(!this->parse_factor(text, position, symbols)) return false;
+    while(position < text.length() && (text[position] == '*' || text[position] == '/')) {
+        operation op = text[position++] == '*' ? MULTIPLY : DIVIDE;
+        if(!this->parse_factor(text, position, symbols)) return false;
+        this->codes.push_back(code{op, 0});
+    }
+    return true;
+}
+
+bool Expression::parse_factor(string_view text, size_t &position, SymbolTable &symbols) {
+    // a '*' where a term is expected is the location counter
+    if(position >= text.length()) return false;
+    char c = text[position];
+    if(c == '*') {
+        position++;
+        this->codes.push_back(code{LOCATION, 0});
+        return true;
+    }
+    if(c == '-' || c == '+') {
+        position++;
+        if(!this->parse_factor(text, position, symbols)) return false;
+        if(c == '-') this->codes.push_back(code{NEGATE, 0});
+        return true;
+    }
+    if(c == '(') {
+        position++;
+        if(!this->parse_sum(text, position, symbols) || position >= text.length() || text[position] != ')') return false;
+        position++;
+        return true;
+    }
+
+    size_t end = position;
+    while(end < text.length() && !is_operator(text[end])) end++;
+    string_view token = text.substr(position, end - position);
+    if(token.empty()) return false;
+    position = end;
+    if(token[0] >= '0' && token[0] <= '9') {
+        int number = 0;
+        for(size_t i = 0; i < token.length(); i++) {
+            if(token[i] < '0' || token[i] > '9') return false;
+            number = number * 10 + (token[i] - '0');
+            if(number > max_value) return false;
+        }
+        this->codes.push_back(code{NUMBER, number});
+    } else {
+        this->codes.push_back(code{SYMBOL, symbols.intern(token)});
+    }
+    return true;
+}
+
+bool Expression::evaluate(int location, const SymbolTable &symbols, value &result) const {
+    return this->evaluate(location, [&symbols](int symbol, value &v) {
+        if(symbols.isExternal(symbol)) {
+            v.externals.push_back(term{symbol, false});
+            return true;
+        }
+        if(!symbols.isDefined(symbol)) return false;
+        v.number = symbols.getValue(symbol);
+        v.relative = symbols.isAbsolute(symbol) ? 0 : 1;
+        return true;
+    }, result);
+}
+
+void Expression::getSymbols(vector<int> &symbols) const {
+    for(unsigned int i = 0; i < this->codes.size(); i++) {
+        if(this->codes[i].op == SYMBOL) symbols.push_back(this->codes[i].operand);
+    }
+}
+
+bool Expression::usesLocation() const {
+    for(unsigned int i = 0; i < this->codes.size(); i++) {
+        if(this->codes[i].op == LOCATION) return true;
+    }
+    return false;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include<symbol_table.hpp>
+#include<climits>
+#include<string_view>
+#include<vector>
+
+using namespace std;
+
+// an operand expression, compiled once into postfix code: decimal numbers, symbols and '*' for
+// the location counter, joined by + - * / and parentheses, written without spaces
+//
+// every value is absolute or relative: relative terms have to pair off, +A-B is absolute, and at
+// most one relative term with a plus sign may be left over; * and / only take absolute values.
+// symbols named by EXTREF are kept apart as terms the loader adds or subtracts. every value
+// on the way has to fit in 24 bits, signed or not, so nothing overflows an int
+class Expression {
+    public:
+        enum operation : unsigned char { NUMBER, SYMBOL, LOCATION, ADD, SUBTRACT, MULTIPLY, DIVIDE, NEGATE };
+
+        struct code {
+            operation op;
+            int operand; // number of NUMBER, symbol id of SYMBOL
+        };
+
+        struct term {
+            int symbol;
+            bool negative;
+        };
+
+        struct value {
+            int number;
+            int relative; // relative terms left over, 0 for an absolute value
+            vector<term> externals; // not in 'number', added at link time
+        };
+
+    private:
+        vector<code> codes;
+
+        bool parse_sum(string_view text, size_t &position, SymbolTable &symbols);
+        bool parse_product(string_view text, size_t &position, SymbolTable &symbols);
+        bool parse_factor(string_view text, size_t &position, SymbolTable &symbols);
+
+    public:
+        // "*", or an operand with an operator past its sign; a plain number or symbol is none
+        static bool isExpression(string_view operand);
+        // false if 'text' is not a valid expression; its symbols are interned into 'symbols'
+        bool compile(string_view text, SymbolTable &symbols);
+        static const int min_value = -(1 << 23);
+        static const int max_value = (1 << 24) - 1;
+
+        // 'lookup(symbol, value)' gives the value of a symbol, false if it has none yet; false
+        // if a symbol has none, a value does not fit in 24 bits or the value is neither
+        // absolute nor relative
+        template<typename Lookup> bool evaluate(int location, Lookup lookup, value &result) const;
+        // the value with the symbols of 'symbols' as they are now
+        bool evaluate(int location, const SymbolTable &symbols, value &result) const;
+        // symbol ids in the order they are used, with repeats
+        void getSymbols(vector<int> &symbols) const;
+        bool usesLocation() const;
+};
+
+template<typename Lookup> bool Expression::evaluate(int location, Lookup lookup, value &result) const {
+    // operands are usually a term or two, the stack rarely grows past its first allocation
+    vector<value> stack;
+    stack.reserve(4);
+    for(unsigned int i = 0; i < this->codes.size(); i++) {
+        const code &c = this->codes[i];
+        if(c.op == NUMBER || c.op == LOCATION) {
+            stack.push_back(value{c.op == NUMBER ? c.operand : location, c.op == LOCATION, vector<term>()});
+            continue;
+        }
+        if(c.op == SYMBOL) {
+            stack.push_back(value{0, 0, vector<term>()});
+            if(!lookup(c.operand, stack.back())) return false;
+            continue;
+        }
+        if(c.op == NEGATE) {
+            value &v = stack.back();
+            if(v.number > -min_value) return false;
+            v.number = -v.number;
+            v.relative = -v.relative;
+            for(unsigned int j = 0; j < v.externals.size(); j++) v.externals[j].negative = !v.externals[j].negative;
+            continue;
+        }
+
+        value right = stack.back();
+        stack.pop_back();
+        value &left = stack.back();
+        // in long long, a product of two 24 bit values cannot overflow it
+        long long number;
+        if(c.op == ADD || c.op == SUBTRACT) {
+            bool subtract = c.op == SUBTRACT;
+            number = (long long)left.number + (subtract ? -(long long)right.number : (long long)right.number);
+            left.relative += subtract ? -right.relative : right.relative;
+            for(unsigned int j = 0; j < right.externals.size(); j++) {
+                left.externals.push_back(term{right.externals[j].symbol, right.externals[j].negative != subtract});
+            }
+        } else {
+            // only absolute values are multiplied or divided
+            if(left.relative != 0 || right.relative != 0 || !left.externals.empty() || !right.externals.empty()) return false;
+            if(c.op == DIVIDE && (right.number == 0 || (left.number == INT_MIN && right.number == -1))) return false;
+            number = c.op == MULTIPLY ? (long long)left.number * right.number : (long long)left.number / right.number;
+        }
+        if(number < min_value || number > max_value) return false;
+        left.number = (int)number;
+    }
+    if(stack.size() != 1 || (stack[0].relative != 0 && stack[0].relative != 1)) return false;
+    result = stack[0];
+    return true;
+}
@@ -0,0 +1,119 @@
+#include "hex.hpp"
+#if defined(__SSE2__) || defined(__x86_64__)
+#include<immintrin.h>
+#define HEX_SSE2 true
+#endif
+#if defined(HEX_SSE2) && defined(__GNUC__)
+#define HEX_AVX2 true
+#endif
+
+// "000102...FF", two digits per byte value
+struct hex_table {
+    char digits[512];
+    constexpr hex_table(): digits() {
+        for(int i = 0; i < 256; i++) {
+            digits[2 * i] = "0123456789ABCDEF"[i >> 4];
+            digits[2 * i + 1] = "0123456789ABCDEF"[i & 15];
+        }
+    }
+};
+
+static constexpr hex_table table;
+
+static void hex_encode_scalar(const unsigned char *data, size_t length, char *out) {
+    for(size_t i = 0; i < length; i++) {
+        out[2 * i] = table.digits[2 * data[i]];
+        out[2 * i + 1] = table.digits[2 * data[i] + 1];
+    }
+}
+
+#ifdef HEX_SSE2
+// nibble + '0', plus 7 more for 'A'-'F'
+static inline __m128i nibble_to_ascii(__m128i nibble) {
+    __m128i letter = _mm_cmpgt_epi8(nibble, _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_add_epi8(nibble, _mm_set1_epi8('0')), _mm_and_si128(letter, _mm_set1_epi8(7)));
+}
+
+static size_t hex_encode_sse2(const unsigned char *data, size_t length, char *out) {
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    for(; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i high = nibble_to_ascii(_mm_and_si128(_mm_srli_epi16(bytes, 4), low_mask));
+        __m128i low = nibble_to_ascii(_mm_and_si128(bytes, low_mask));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
+}
+#endif
+
+#ifdef HEX_AVX2
+__attribute__((target("avx2"))) static inline __m256i nibble_to_ascii_avx2(__m256i nibble) {
+    __m256i letter = _mm256_cmpgt_epi8(nibble, _mm256_set1_epi8(9));
+    return _mm256_add_epi8(_mm256_add_epi8(nibble, _mm256_set1_epi8('0')), _mm256_and_si256(letter, _mm256_set1_epi8(7)));
+}
+
+__attribute__((target("avx2"))) static size_t hex_encode_avx2(const unsigned char *data, size_t length, char *out) {
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for(; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i high = nibble_to_ascii_avx2(_mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_mask));
+        __m256i low = nibble_to_ascii_avx2(_mm256_and_si256(bytes, low_mask));
+        // unpack works per 128 bit lane, put the lanes back in order
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256((__m256i*)(out + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+
+static const bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+void hex_encode(const unsigned char *data, size_t length, char *out) {
+    size_t done = 0;
+#ifdef HEX_AVX2
+    if(has_avx2 && length >= 32) done = hex_encode_avx2(data, length, out);
+#endif
+#ifdef HEX_SSE2
+    if(length - done >= 16) done += hex_encode_sse2(data + done, length - done, out + 2 * done);
+#endif
+    hex_encode_scalar(data + done, length - done, out + 2 * done);
+}
+
+string hex_encode(const string &bytes) {
+    string result(bytes.length() * 2, '0');
+    hex_encode((const unsigned char*)bytes.data(), bytes.length(), &result[0]);
+    return result;
+}
+
+string hex_field(unsigned int value, int width) {
+    unsigned char bytes[4] = {(unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value};
+    char digits[8];
+    int length = 8;
+
+    hex_encode(bytes, 4, digits);
+    while(length > width && digits[8 - length] == '0') length--;
+    return string(digits + 8 - length, length);
+}
+
+int hex_digit(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool hex_number(string_view digits, unsigned int &value) {
+    if(digits.empty() || digits.length() > 8) return false;
+    value = 0;
+    for(size_t i = 0; i < digits.length(); i++) {
+        int digit = hex_digit(digits[i]);
+        if(digit < 0) return false;
+        value = value << 4 | digit;
+    }
+    return true;
+}
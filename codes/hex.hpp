@@ -0,0 +1,15 @@
+#pragma once
+#include<string>
+#include<string_view>
+
+using namespace std;
+
+// writes 2 * length upper case hex digits of 'data' to 'out'
+void hex_encode(const unsigned char *data, size_t length, char *out);
+string hex_encode(const string &bytes);
+// 'value' in upper case hex, zero padded to at least 'width' digits
+string hex_field(unsigned int value, int width);
+// value of one hex digit of either case, -1 if 'c' is not one
+int hex_digit(char c);
+// 'digits' as an unsigned number, false if it is empty, too long or not all hex digits
+bool hex_number(string_view digits, unsigned int &value);
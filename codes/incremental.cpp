@@ -0,0 +1,580 @@
+#include "assembler.hpp"
+#include<algorithm>
+#include<cstring>
+
+// incremental reassembly keeps the pass 1 and pass 2 results of every line, and the object
+// program and listing as last written with where each line's part of them starts; an edit
+// re-parses the edited lines and moves the lines after it, whose listing lines and records
+// only get their addresses patched. The lines encoded again are the ones that use a symbol the
+// edit defined or removed, and the ones the move changes: those that refer across the edit,
+// use a BASE across it or hold a moved address. Text records are rebuilt from the changed lines
+// only until they match the previous run again
+
+static vector<string> read_lines(InputStream *input) {
+    vector<string> lines;
+    Stats::Timer timer(Stats::READ);
+    while(!input->eof()) lines.push_back(string(input->readline_view()));
+    return lines;
+}
+
+// replaces 'removed' elements at 'first' with 'values', overlapping elements are assigned in place
+template<typename T> static void splice(vector<T> &target, unsigned int first, unsigned int removed, const vector<T> &values) {
+    unsigned int common = min(removed, (unsigned int)values.size());
+    for(unsigned int i = 0; i < common; i++) target[first + i] = values[i];
+    target.erase(target.begin() + first + common, target.begin() + first + removed);
+    target.insert(target.begin() + first + common, values.begin() + common, values.end());
+}
+
+// writes 'value' in base 10 or 16 right aligned over the 'width' characters at 'field'
+static void put_number(char *field, int width, unsigned int value, unsigned int base, char fill) {
+    do {
+        field[--width] = "0123456789ABCDEF"[value % base];
+        value /= base;
+    } while(value != 0 && width > 0);
+    while(width > 0) field[--width] = fill;
+}
+
+// adds 'shift' to the six digit address at 'field'
+static void move_address(char *field, int shift) {
+    unsigned int address = 0;
+    hex_number(string_view(field, 6), address);
+    put_number(field, 6, address + shift, 16, '0');
+}
+
+SICXEAssembler::line_state SICXEAssembler::empty_line_state() {
+    // 'base' and 'after' never match a real line, so a new line cannot end a run of encoding or of text records
+    line_state state;
+    state.base = -2;
+    state.uses = INDEPENDENT;
+    state.after.start_address = 0;
+    state.after.length = -1;
+    return state;
+}
+
+size_t SICXEAssembler::piece_offset(const line_text &text, unsigned int line) {
+    size_t offset = 0;
+    for(; line > 0; line -= line & -line) offset += text.offsets[line];
+    return offset;
+}
+
+void SICXEAssembler::index_pieces(line_text &text) {
+    // in one pass, every element adds itself to the next one that covers it
+    vector<size_t> &tree = text.offsets;
+    tree.assign(text.lengths.size() + 1, 0);
+    for(size_t i = 1; i < tree.size(); i++) {
+        tree[i] += text.lengths[i - 1];
+        if(i + (i & -i) < tree.size()) tree[i + (i & -i)] += tree[i];
+    }
+}
+
+void SICXEAssembler::splice_pieces(line_text &text, unsigned int first, unsigned int removed, unsigned int inserted) {
+    // a replaced line keeps its piece until it is encoded again, removed lines take theirs
+    // along and inserted ones start empty
+    unsigned int common = min(removed, inserted);
+    if(removed == inserted) return;
+    size_t begin = piece_offset(text, first + common), end = piece_offset(text, first + removed);
+    text.text.erase(begin, end - begin);
+    text.lengths.erase(text.lengths.begin() + first + common, text.lengths.begin() + first + removed);
+    text.lengths.insert(text.lengths.begin() + first + common, inserted - common, 0);
+    index_pieces(text);
+}
+
+void SICXEAssembler::replace_pieces(line_text &text, const vector<unsigned int> &lines, const vector<string> &pieces) {
+    // 'lines' in increasing order; pieces of the old lengths are written over the old ones,
+    // otherwise the text is merged with them once
+    size_t i, offset, copied = 0;
+    bool same = true;
+    for(i = 0; i < lines.size() && same; i++) same = pieces[i].length() == text.lengths[lines[i]];
+    if(same) {
+        for(i = 0; i < lines.size(); i++) memcpy(&text.text[piece_offset(text, lines[i])], pieces[i].data(), pieces[i].length());
+        return;
+    }
+
+    text.spare.clear();
+    for(i = 0; i < lines.size(); i++) {
+        offset = piece_offset(text, lines[i]);
+        text.spare.append(text.text, copied, offset - copied);
+        text.spare += pieces[i];
+        copied = offset + text.lengths[lines[i]];
+    }
+    text.spare.append(text.text, copied, string::npos);
+    text.text.swap(text.spare);
+
+    // the tree is rebuilt in linear time or updated in logarithmic time per piece
+    if(lines.size() > text.lengths.size() / 64) {
+        for(i = 0; i < lines.size(); i++) text.lengths[lines[i]] = pieces[i].length();
+        index_pieces(text);
+        return;
+    }
+    for(i = 0; i < lines.size(); i++) {
+        // a shorter piece wraps the change around, and the sums with it
+        size_t change = pieces[i].length() - text.lengths[lines[i]];
+        text.lengths[lines[i]] = pieces[i].length();
+        for(size_t k = lines[i] + 1; k < text.offsets.size(); k += k & -k) text.offsets[k] += change;
+    }
+}
+
+bool SICXEAssembler::assembleIncremental() {
+    this->source_lines = read_lines(this->input);
+    return this->rebuild_incremental();
+}
+
+bool SICXEAssembler::reassemble(InputStream *input) {
+    vector<string> lines = read_lines(input);
+    if(!this->incremental_ready) {
+        this->source_lines = lines;
+        return this->rebuild_incremental();
+    }
+
+    // only the lines between the common prefix and the common suffix changed
+    const vector<string> &old_lines = this->source_lines;
+    unsigned int prefix = 0, suffix = 0;
+    unsigned int shortest = min(old_lines.size(), lines.size());
+    while(prefix < shortest && old_lines[prefix] == lines[prefix]) prefix++;
+    while(suffix < shortest - prefix && old_lines[old_lines.size() - 1 - suffix] == lines[lines.size() - 1 - suffix]) suffix++;
+
+    vector<string> changed_lines(lines.begin() + prefix, lines.end() - suffix);
+    return this->updateLines(prefix, old_lines.size() - prefix - suffix, changed_lines);
+}
+
+bool SICXEAssembler::updateLines(unsigned int first, unsigned int removed, const vector<string> &lines) {
+    unsigned int program_first, begin, end, moved, i, k;
+    int locctr, edit_address, delta, shift;
+    string label, opcode, operand;
+    vector<instruction> inserted;
+    vector<int> changed_symbols;
+    vector<unsigned int> affected, changed;
+    Stats::Timer timer(Stats::PASS1);
+
+    first = min(first, (unsigned int)this->source_lines.size());
+    removed = min(removed, (unsigned int)this->source_lines.size() - first);
+    splice(this->source_lines, first, removed, lines);
+    Stats::count(Stats::LINES, lines.size());
+
+    // edits to the header, END or what follows it take a full rebuild
+    if(!this->incremental_ready || !this->program_bounds(program_first, begin, end) || first < begin || first + removed > end) {
+        return this->rebuild_incremental();
+    }
+
+    // so do lines that pass 1 would stop at
+    for(i = 0; i < lines.size(); i++) {
+        if(this->input_is_comment(lines[i])) {
+            inserted.push_back(this->make_comment(lines[i]));
+        } else if(!parse_input_line(lines[i], label, opcode, operand) || opcode == "START" || opcode == "END" || opcode == "MACRO" || opcode == "LTORG" || isLiteral(operand)
+            || opcode == "EQU" || opcode == "ORG"
+            || opcode == "CSECT" || opcode == "EXTDEF" || opcode == "EXTREF") {
+            return this->rebuild_incremental();
+        } else {
+            instruction parsed;
+            parsed.comment = false;
+            parsed.label = label;
+            parsed.opcode = opcode;
+            parsed.operand = operand;
+            inserted.push_back(parsed);
+        }
+    }
+
+    // forget the removed lines, then run pass 1 over the new ones
+    for(i = first; i < first + removed; i++) {
+        this->remove_reference(i);
+        if(!this->program[i].comment && this->program[i].label != "") {
+            int id = this->symbol_table.find(this->program[i].label);
+            this->symbol_table.undefine(id);
+            changed_symbols.push_back(id);
+        }
+    }
+
+    locctr = this->start_address;
+    for(i = first; i > 0; i--) {
+        if(!this->program[i - 1].comment) {
+            locctr = this->program[i - 1].address + this->program[i - 1].length;
+            break;
+        }
+    }
+
+    edit_address = locctr;
+    this->error_flag = 0;
+    for(i = 0; i < inserted.size(); i++) {
+        if(inserted[i].comment) continue;
+        inserted[i] = this->process_instruction(locctr, inserted[i].label, inserted[i].opcode, inserted[i].operand);
+        if(inserted[i].label != "") changed_symbols.push_back(this->symbol_table.find(inserted[i].label));
+    }
+    if(this->error_flag || this->expression_lines) return this->rebuild_incremental();
+
+    // the lines after the edit move by the same amount, END is never a comment; a program
+    // that outgrows the address fields is left to a full assembly
+    for(k = first + removed; this->program[k].comment; k++);
+    shift = locctr - this->program[k].address;
+    if(this->program.back().address + shift > 0xFFFFFF) return this->rebuild_incremental();
+
+    splice(this->program, first, removed, inserted);
+    splice(this->line_cache, first, removed, vector<line_state>(inserted.size(), empty_line_state()));
+    splice_pieces(this->listing_text, first, removed, inserted.size());
+    splice_pieces(this->record_text, first, removed, inserted.size());
+    splice_pieces(this->modification_text, first, removed, inserted.size());
+
+    delta = (int)inserted.size() - (int)removed;
+    end += delta;
+    moved = first + inserted.size();
+    vector<unsigned int>::iterator position = lower_bound(this->positional_lines.begin(), this->positional_lines.end(), first);
+    position = this->positional_lines.erase(position, lower_bound(position, this->positional_lines.end(), first + removed));
+    for(; position != this->positional_lines.end(); position++) *position += delta;
+    if(delta != 0) {
+        for(vector<vector<unsigned int> >::iterator users = this->references.begin(); users != this->references.end(); users++) {
+            for(k = 0; k < users->size(); k++) {
+                if((*users)[k] >= first + removed) (*users)[k] += delta;
+            }
+        }
+    }
+    for(i = first; i < moved; i++) {
+        this->program[i].line_number = i + 1;
+        this->add_reference(i);
+        affected.push_back(i);
+    }
+    // the text records are rebuilt from the edit even when only lines were removed
+    if(first < end) affected.push_back(first);
+
+    if(shift != 0) {
+        // labels move with their lines; the inserted ones and the ones of empty lines right
+        // before the edit may be where the moved ones were, they are put back and their users
+        // encoded again, which also settles whether a symbol at the edit moved
+        this->symbol_table.shift(locctr - shift, shift);
+        for(i = first; i < moved; i++) {
+            if(!this->program[i].comment && this->program[i].label != "") {
+                this->symbol_table.define(this->symbol_table.find(this->program[i].label), this->program[i].address);
+            }
+        }
+        for(i = first; i > 0; i--) {
+            const instruction &line = this->program[i - 1];
+            if(line.comment) continue;
+            if(line.address != edit_address || line.length != 0) break;
+            if(line.label != "") {
+                int id = this->symbol_table.find(line.label);
+                this->symbol_table.define(id, line.address);
+                changed_symbols.push_back(id);
+            }
+        }
+    }
+    if(shift != 0 || delta != 0) this->move_lines(moved, shift, delta != 0);
+    if(shift != 0) {
+        this->program_length = this->program.back().address - this->start_address;
+        this->crossing_lines(moved, edit_address, shift, affected);
+    }
+
+    for(i = 0; i < changed_symbols.size(); i++) {
+        if(changed_symbols[i] >= (int)this->references.size()) continue;
+        const vector<unsigned int> &users = this->references[changed_symbols[i]];
+        affected.insert(affected.end(), users.begin(), users.end());
+    }
+
+    // an error is reported exactly like a full assembly would report it
+    if(!this->reencode_lines(affected, changed)) return this->rebuild_incremental();
+    this->rebuild_text_records(changed);
+    this->write_incremental();
+    return true;
+}
+
+bool SICXEAssembler::rebuild_incremental() {
+    unsigned int first, begin, end, i;
+    string source;
+    vector<unsigned int> affected, changed, outside;
+    vector<string> listings;
+
+    for(i = 0; i < this->source_lines.size(); i++) {
+        if(i > 0) source += '\n';
+        source += this->source_lines[i];
+    }
+
+    MemoryInputStream memory(source);
+    InputStream *input = this->input;
+    vector<size_t> macro_ends;
+    vector<string_view> slices = find_sections(source, macro_ends);
+    this->input = &memory;
+    this->sections.clear();
+    bool result = slices.size() > 1 ? this->read_sections(slices, macro_ends, source) : this->read_program();
+    this->input = input;
+    if(!result) return false;
+
+    // macro bodies, expansions, literal pools and control sections break the line for line
+    // match of source and program, such programs are assembled whole every time; so do
+    // relaxation, where an edit may change the format of lines far from it, and EQU, ORG and
+    // expressions, whose lines depend on more than one symbol
+    if(this->generated_lines || this->control_sections || this->relaxing || this->expression_lines || !this->program_bounds(first, begin, end)) {
+        result = this->pass2();
+        this->output_object->flush();
+        if(this->output_listing != nullptr) this->output_listing->flush();
+        return result;
+    }
+
+    // lines outside the encoded range only have a listing
+    this->line_cache.assign(this->program.size(), empty_line_state());
+    this->references.clear();
+    this->positional_lines.clear();
+    line_text *texts[] = {&this->listing_text, &this->record_text, &this->modification_text};
+    for(line_text *text : texts) {
+        text->text.clear();
+        text->lengths.assign(this->program.size(), 0);
+        index_pieces(*text);
+    }
+    for(i = 0; i < this->program.size(); i++) {
+        const instruction &line = this->program[i];
+        if(i >= begin && i < end) {
+            this->add_reference(i);
+            affected.push_back(i);
+        } else if(line.comment) {
+            outside.push_back(i);
+            listings.push_back(this->format_line(line) + '\n');
+        } else {
+            outside.push_back(i);
+            listings.push_back(this->format_line(line) + '\t' + align_right("", 10, ' ') + '\n');
+        }
+    }
+    replace_pieces(this->listing_text, outside, listings);
+
+    if(!this->reencode_lines(affected, changed)) {
+        result = this->pass2();
+        this->output_object->flush();
+        if(this->output_listing != nullptr) this->output_listing->flush();
+        return result;
+    }
+    this->rebuild_text_records(changed);
+    this->incremental_ready = true;
+    this->write_incremental();
+    return true;
+}
+
+bool SICXEAssembler::program_bounds(unsigned int &first, unsigned int &begin, unsigned int &end) const {
+    // 'first' is the first line that is not a comment, lines in [begin, end) are encoded
+    for(first = 0; first < this->program.size() && this->program[first].comment; first++);
+    if(first >= this->program.size() || this->program[first].opcode == "END" || this->program.back().opcode != "END") return false;
+    begin = this->program[first].opcode == "START" ? first + 1 : first;
+    end = this->program.size() - 1;
+    return true;
+}
+
+void SICXEAssembler::add_reference(unsigned int index) {
+    int symbol = this->program[index].symbol;
+    if(symbol < 0) return;
+    if(symbol >= (int)this->references.size()) this->references.resize(this->symbol_table.size());
+    this->references[symbol].push_back(index);
+}
+
+void SICXEAssembler::remove_reference(unsigned int index) {
+    int symbol = this->program[index].symbol;
+    if(symbol < 0 || symbol >= (int)this->references.size()) return;
+    vector<unsigned int> &users = this->references[symbol];
+    vector<unsigned int>::iterator user = find(users.begin(), users.end(), index);
+    if(user != users.end()) users.erase(user);
+}
+
+void SICXEAssembler::move_lines(unsigned int from, int shift, bool renumber) {
+    // the lines from 'from' on moved by 'shift' bytes and, if 'renumber', to other line numbers;
+    // both only show in fields of fixed width, which are written over
+    static const size_t separator = sep().length();
+    size_t listing = piece_offset(this->listing_text, from), records = piece_offset(this->record_text, from);
+    size_t modification = piece_offset(this->modification_text, from), k, length;
+
+    for(unsigned int i = from; i < this->program.size(); i++) {
+        instruction &line = this->program[i];
+        char *text = &this->listing_text.text[listing];
+        listing += this->listing_text.lengths[i];
+        if(renumber) {
+            line.line_number = i + 1;
+            put_number(text, 10, line.line_number * 5, 10, ' ');
+        }
+        if(shift == 0) continue;
+
+        // the lines format_fields() leaves without an address
+        if(!line.comment) {
+            line.address += shift;
+            if(line.opcode != "END" && line.opcode != "BASE" && line.opcode != "NOBASE" && line.opcode != "LTORG") {
+                put_number(text + 11, 10, line.address, 16, ' ');
+            }
+        }
+        this->line_cache[i].after.start_address += shift;
+
+        // T, address, length and the object code, then M, address and length
+        text = &this->record_text.text[records];
+        for(k = 0; k < this->record_text.lengths[i]; k += 3 * separator + 10 + 2 * length) {
+            move_address(text + k + 1 + separator, shift);
+            length = 16 * hex_digit(text[k + 2 * separator + 7]) + hex_digit(text[k + 2 * separator + 8]);
+        }
+        records += this->record_text.lengths[i];
+        text = &this->modification_text.text[modification];
+        for(k = 0; k < this->modification_text.lengths[i]; k += 2 * separator + 10) move_address(text + k + 1 + separator, shift);
+        modification += this->modification_text.lengths[i];
+    }
+}
+
+void SICXEAssembler::crossing_lines(unsigned int moved, int edit_address, int shift, vector<unsigned int> &affected) const {
+    // the lines from 'moved' on and their labels moved by 'shift', the edited lines start at
+    // 'edit_address'; adds the lines whose object code the move changes
+    unsigned int first, begin, end, i;
+    int boundary;
+    this->program_bounds(first, begin, end);
+    for(i = moved; this->program[i].comment; i++);
+    boundary = this->program[i].address;
+    auto moves = [this, boundary](int symbol) { return this->symbol_table.getValue(symbol) >= boundary; };
+
+    // format 4 holds where its symbol is, base relative code how far it is from BASE and
+    // whether it is out of reach of the line
+    for(i = 0; i < this->positional_lines.size(); i++) {
+        unsigned int index = this->positional_lines[i];
+        const line_state &state = this->line_cache[index];
+        bool target = moves(this->program[index].symbol);
+        if(state.uses == ABSOLUTE ? target : target != (index >= moved) || target != (state.base >= 0 && moves(state.base))) {
+            affected.push_back(index);
+        }
+    }
+
+    // PC relative code changes when the line and its symbol are on different sides of the
+    // edit, displacements reach 2048 bytes so only lines that close to the edit can be
+    for(i = moved; i > begin; i--) {
+        const instruction &line = this->program[i - 1];
+        if(line.comment) continue;
+        if(line.address + 2050 < boundary - shift) break;
+        if(this->line_cache[i - 1].uses == PC_RELATIVE && moves(line.symbol)) affected.push_back(i - 1);
+    }
+    for(i = moved; i < end; i++) {
+        const instruction &line = this->program[i];
+        if(line.comment) continue;
+        if(line.address > edit_address + 2045 + shift) break;
+        if(this->line_cache[i].uses == PC_RELATIVE && !moves(line.symbol)) affected.push_back(i);
+    }
+}
+
+int SICXEAssembler::base_after(unsigned int index) const {
+    // the BASE symbol, not its value, which may still move
+    const instruction &line = this->program[index];
+    if(!line.comment && line.opcode == "NOBASE") return -1;
+    if(!line.comment && line.opcode == "BASE") return line.symbol;
+    return this->line_cache[index].base;
+}
+
+void SICXEAssembler::set_dependency(unsigned int index, dependency uses) {
+    // 'positional_lines' holds the lines a move can change wherever they are
+    line_state &state = this->line_cache[index];
+    bool was = state.uses == BASE_RELATIVE || state.uses == ABSOLUTE, is = uses == BASE_RELATIVE || uses == ABSOLUTE;
+    state.uses = uses;
+    if(was == is) return;
+    vector<unsigned int>::iterator position = lower_bound(this->positional_lines.begin(), this->positional_lines.end(), index);
+    if(is) this->positional_lines.insert(position, index);
+    else this->positional_lines.erase(position);
+}
+
+bool SICXEAssembler::reencode_lines(vector<unsigned int> &affected, vector<unsigned int> &changed) {
+    // encodes the affected lines in order; a line that is not affected is encoded too while the
+    // BASE in effect differs from the last run, or is the one of an affected BASE line, whose
+    // symbol may have moved
+    unsigned int first, begin, end, i;
+    int base, forced;
+    size_t next = 0;
+    bool listed;
+    pass2_chunk scratch;
+    object_code code;
+    vector<string> listings, modifications;
+    Stats::Timer timer(Stats::PASS2);
+
+    this->program_bounds(first, begin, end);
+    sort(affected.begin(), affected.end());
+    affected.erase(unique(affected.begin(), affected.end()), affected.end());
+
+    while(next < affected.size() && affected[next] < end) {
+        i = affected[next];
+        base = i == begin ? -1 : this->base_after(i - 1);
+        forced = -2;
+        for(; i < end; i++) {
+            listed = next < affected.size() && affected[next] == i;
+            if(listed) next++;
+            else if(this->line_cache[i].base == base && base != forced) break;
+
+            const instruction &line = this->program[i];
+            line_state &state = this->line_cache[i];
+            state.base = base;
+            scratch.base = this->symbol_table.isDefined(base) ? this->symbol_table.getValue(base) : -1;
+            scratch.error_flag = 0;
+            scratch.bytes.clear();
+            scratch.listing.clear();
+            scratch.m_records.clear();
+            this->encode_line(line, scratch, code);
+            if(scratch.error_flag) {
+                this->error_flag = scratch.error_flag;
+                return false;
+            }
+            state.bytes.swap(scratch.bytes);
+            listings.push_back(this->format_number(line) + scratch.listing);
+            modifications.push_back("");
+            for(const modification_record &m : scratch.m_records) {
+                modifications.back() += "M" + sep() + hex_field(m.address, 6) + sep() + hex_field(m.length, 2) + '\n';
+                Stats::count(Stats::M_RECORDS);
+            }
+
+            // format 3 keeps its b and p flags in the high bits of its second byte
+            if(line.comment || line.symbol < 0 || line.opcode == "BASE") this->set_dependency(i, INDEPENDENT);
+            else if(state.bytes.length() == 3 && (state.bytes[1] & 0x20)) this->set_dependency(i, PC_RELATIVE);
+            else if(state.bytes.length() == 3 && (state.bytes[1] & 0x40)) this->set_dependency(i, BASE_RELATIVE);
+            else this->set_dependency(i, ABSOLUTE);
+
+            if(listed && !line.comment && line.opcode == "BASE") forced = line.symbol;
+            base = this->base_after(i);
+            changed.push_back(i);
+        }
+    }
+    replace_pieces(this->listing_text, changed, listings);
+    replace_pieces(this->modification_text, changed, modifications);
+    return true;
+}
+
+void SICXEAssembler::rebuild_text_records(const vector<unsigned int> &changed) {
+    // stops at the first unchanged line that starts from the same record state as last time
+    unsigned int first, begin, end, i;
+    size_t next = 0;
+    bool same = false;
+    text_record t_record;
+    StringOutputStream records;
+    vector<unsigned int> lines;
+    vector<string> pieces;
+    Stats::Timer timer(Stats::TEXT_RECORDS);
+
+    this->program_bounds(first, begin, end);
+    while(next < changed.size()) {
+        i = changed[next];
+        if(i == begin) this->start_text_record(t_record, this->start_address);
+        else t_record = this->line_cache[i - 1].after;
+        for(; i < end; i++) {
+            if(next < changed.size() && changed[next] == i) next++;
+            else if(same) break;
+
+            const instruction &current = this->program[i];
+            line_state &state = this->line_cache[i];
+            records.clear();
+            if(!current.comment && current.opcode != "BASE" && current.opcode != "NOBASE") {
+                this->process_text_record(t_record, current.address, state.bytes, &records);
+            }
+            lines.push_back(i);
+            pieces.push_back(records.getString());
+            same = t_record.start_address == state.after.start_address && t_record.length == state.after.length
+                && t_record.object_codes == state.after.object_codes;
+            state.after = t_record;
+        }
+    }
+    replace_pieces(this->record_text, lines, pieces);
+}
+
+void SICXEAssembler::write_incremental() const {
+    unsigned int first, begin, end;
+    string header, e_record;
+    StringOutputStream last;
+    Stats::Timer timer(Stats::OUTPUT);
+
+    this->program_bounds(first, begin, end);
+    header = this->header_record(this->program[first]);
+    if(end > begin && this->line_cache[end - 1].after.length > 0) this->write_text_record(this->line_cache[end - 1].after, &last);
+    e_record = "E" + sep() + hex_field(this->start_address, 6) + '\n';
+    this->output_object->write_batch({header, this->record_text.text, last.getString(), this->modification_text.text, e_record});
+    this->output_object->flush();
+
+    if(this->output_listing == nullptr) return;
+    this->output_listing->write_batch({this->listing_text.text});
+    this->output_listing->flush();
+}
@@ -0,0 +1,94 @@
+#include "sicxe.h"
+#include<assembler.hpp>
+#include<cstring>
+
+// like a server instance, the streams and the assembler are made once; clearing a stream keeps
+// its memory and pass 1 clears the assembler's tables without giving theirs back, so calls after
+// the first allocate little more than what a bigger program needs
+struct sicxe_assembler {
+    MemoryInputStream input;
+    StringOutputStream object;
+    StringOutputStream listing;
+    string symbols;
+    SICXEAssembler assembler;
+    sicxe_assembler(): assembler(&this->input, &this->object) { }
+};
+
+// copies 'text' to the caller's buffer if it has one big enough
+static void set_output(sicxe_output &output, const string &text) {
+    output.length = text.length();
+    output.data = text.data();
+    if(output.buffer != nullptr && text.length() <= output.capacity) {
+        memcpy(output.buffer, text.data(), text.length());
+        output.data = output.buffer;
+    }
+}
+
+static void no_output(sicxe_output &output) {
+    output.length = 0;
+    output.data = output.buffer != nullptr ? output.buffer : "";
+}
+
+static void list_symbols(const SymbolTable &table, string &symbols) {
+    // undefined and external symbols have no value here, literal pool entries are no symbols
+    for(int id = 0; id < table.size(); id++) {
+        if(!table.isDefined(id) || SICXEAssembler::isLiteral(string(table.getName(id)))) continue;
+        symbols.append(table.getName(id));
+        symbols += '\t';
+        symbols += hex_field(table.getValue(id) & 0xFFFFFF, 6);
+        symbols += table.isAbsolute(id) ? "\tA\n" : "\tR\n";
+    }
+}
+
+extern "C" {
+
+int sicxe_version(void) {
+    return SICXE_API_VERSION;
+}
+
+sicxe_assembler* sicxe_create(void) {
+    // nothing thrown may pass a C function
+    try {
+        return new sicxe_assembler();
+    } catch(...) {
+        return nullptr;
+    }
+}
+
+void sicxe_destroy(sicxe_assembler *assembler) {
+    delete assembler;
+}
+
+void sicxe_set_record_size(sicxe_assembler *assembler, unsigned int size) {
+    assembler->assembler.setTextRecordSize(size);
+}
+
+int sicxe_assemble(sicxe_assembler *assembler, const char *source, size_t length, unsigned int flags, sicxe_result *result) {
+    // the source is read where it is, nothing copies it
+    try {
+        assembler->input = MemoryInputStream(string_view(source, length));
+        assembler->object.clear();
+        assembler->listing.clear();
+        assembler->symbols.clear();
+        assembler->assembler.setInputStream(&assembler->input);
+        assembler->assembler.setOutputListingStream(flags & SICXE_LISTING ? &assembler->listing : nullptr);
+        assembler->assembler.setRelaxation(flags & SICXE_RELAX);
+
+        result->success = assembler->assembler.assemble();
+        result->error_flag = assembler->assembler.getErrorFlag();
+        if(flags & SICXE_SYMBOLS) list_symbols(assembler->assembler.getSymbolTable(), assembler->symbols);
+        set_output(result->object, assembler->object.getString());
+        set_output(result->listing, assembler->listing.getString());
+        set_output(result->symbols, assembler->symbols);
+    } catch(...) {
+        // out of memory most likely; nothing thrown may pass a C function, the outputs are empty
+        result->success = 0;
+        result->error_flag = -1;
+        no_output(result->object);
+        no_output(result->listing);
+        no_output(result->symbols);
+    }
+    return result->success;
+}
+
+}
@@ -0,0 +1,412 @@
+#include "linker.hpp"
+#include<algorithm>
+
+// names of records without tabs are padded with spaces to 6 columns
+static string_view trim(string_view name) {
+    while(!name.empty() && name.back() == ' ') name.remove_suffix(1);
+    return name;
+}
+
+LinkingLoader::ExternalSymbolTable::shard& LinkingLoader::ExternalSymbolTable::shard_of(string_view name) {
+    return this->shards[hash<string_view>()(name) % shard_count];
+}
+
+void LinkingLoader::ExternalSymbolTable::define(string_view name, const section *owner, unsigned int offset, unsigned int module) {
+    shard &s = this->shard_of(name);
+    lock_guard<mutex> guard(s.lock);
+    pair<unordered_map<string, entry>::iterator, bool> inserted = s.symbols.emplace(string(name), entry{owner, offset, module});
+    if(inserted.second) return;
+
+    entry &e = inserted.first->second;
+    s.duplicates.push_back(max(e.module, module));
+    if(module < e.module) e = entry{owner, offset, module};
+}
+
+bool LinkingLoader::ExternalSymbolTable::find(string_view name, unsigned int &address) {
+    // no lock, nothing is defined while symbols are looked up
+    shard &s = this->shard_of(name);
+    unordered_map<string, entry>::iterator found = s.symbols.find(string(name));
+    if(found == s.symbols.end()) return false;
+    address = found->second.owner->load_address + found->second.offset;
+    return true;
+}
+
+unsigned int LinkingLoader::ExternalSymbolTable::size() {
+    unsigned int count = 0;
+    for(unsigned int i = 0; i < shard_count; i++) count += this->shards[i].symbols.size();
+    return count;
+}
+
+vector<unsigned int> LinkingLoader::ExternalSymbolTable::getDuplicates() {
+    vector<unsigned int> modules;
+    for(unsigned int i = 0; i < shard_count; i++) modules.insert(modules.end(), this->shards[i].duplicates.begin(), this->shards[i].duplicates.end());
+    return modules;
+}
+
+void LinkingLoader::ExternalSymbolTable::clear() {
+    for(unsigned int i = 0; i < shard_count; i++) {
+        this->shards[i].symbols.clear();
+        this->shards[i].duplicates.clear();
+    }
+}
+
+LinkingLoader::LinkingLoader(unsigned char *memory, unsigned int memory_size) {
+    this->memory = memory;
+    this->memory_size = memory_size;
+    this->pool = nullptr;
+    this->clear();
+}
+
+void LinkingLoader::addObject(string_view contents) {
+    module m;
+    m.contents = contents;
+    m.binary = BinaryObjectView::isBinary(contents);
+    m.error_flag = 0;
+    this->modules.push_back(m);
+}
+
+void LinkingLoader::clear() {
+    this->modules.clear();
+    this->symbols.clear();
+    this->start_address = 0;
+    this->program_length = 0;
+    this->entry_address = 0;
+    this->error_flag = 0;
+    this->error_module = -1;
+}
+
+void LinkingLoader::setThreadPool(ThreadPool *pool) {
+    this->pool = pool;
+}
+
+void LinkingLoader::run(const function<void(unsigned int)> &step) {
+    // objects are small, a task takes a run of them, a few runs for every thread
+    unsigned int count = this->modules.size();
+    if(this->pool == nullptr) {
+        for(unsigned int i = 0; i < count; i++) step(i);
+        return;
+    }
+    TaskGroup group;
+    unsigned int run = max(1u, count / (8 * this->pool->size()));
+    for(unsigned int begin = 0; begin < count; begin += run) {
+        unsigned int end = min(begin + run, count);
+        this->pool->submit(group, [begin, end, &step] {
+            for(unsigned int i = begin; i < end; i++) step(i);
+        });
+    }
+    this->pool->wait(group);
+}
+
+bool LinkingLoader::link(unsigned int load_address) {
+    unsigned int i, j;
+
+    this->symbols.clear();
+    this->start_address = load_address;
+    this->program_length = 0;
+    this->entry_address = -1;
+    this->error_flag = 0;
+    this->error_module = -1;
+    for(i = 0; i < this->modules.size(); i++) {
+        module &m = this->modules[i];
+        m.sections.clear();
+        m.relocations.clear();
+        m.reversed.clear();
+        m.ranges.clear();
+        m.error_flag = 0;
+    }
+
+    this->run([this](unsigned int index) { this->read_module(index); });
+    vector<unsigned int> duplicates = this->symbols.getDuplicates();
+    for(i = 0; i < duplicates.size(); i++) this->modules[duplicates[i]].error_flag |= 32;
+
+    // sections follow each other in the order of the objects
+    unsigned int address = load_address;
+    for(i = 0; i < this->modules.size() && this->error_module < 0; i++) {
+        module &m = this->modules[i];
+        if(m.error_flag != 0) {
+            this->error_flag = m.error_flag;
+            this->error_module = i;
+            break;
+        }
+        for(j = 0; j < m.sections.size(); j++) {
+            section &s = m.sections[j];
+            s.load_address = address;
+            if((unsigned long long)address + s.length > this->memory_size) {
+                this->error_flag = 4;
+                this->error_module = i;
+                break;
+            }
+            if(this->entry_address < 0 && s.entry >= 0) this->entry_address = s.load_address + s.entry - s.address;
+            address += s.length;
+        }
+    }
+    if(this->error_module >= 0) return false;
+    this->program_length = address - load_address;
+    if(this->entry_address < 0) this->entry_address = load_address;
+
+    this->run([this](unsigned int index) { this->load_module(index); });
+
+    for(i = 0; i < this->modules.size(); i++) {
+        if(this->modules[i].error_flag != 0) {
+            this->error_flag = this->modules[i].error_flag;
+            this->error_module = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+void LinkingLoader::read_module(unsigned int index) {
+    module &m = this->modules[index];
+    if(!(m.binary ? this->read_binary(m) : this->read_text(m, m.contents))) return;
+
+    // the sections are in place now, symbols can point into them
+    for(unsigned int i = 0; i < m.sections.size(); i++) {
+        const section &s = m.sections[i];
+        this->symbols.define(s.name, &s, 0, index);
+        if(m.binary) continue;
+
+        for(unsigned int j = 0; j < s.records.size(); j++) {
+            string_view record = s.records[j];
+            if(record[0] != 'D') continue;
+            // NAME<tab>ADDRESS... or NAME padded to 6 columns and ADDRESS...
+            bool tabs = record.find('\t') != string_view::npos;
+            size_t position = 1;
+            while(position < record.length()) {
+                size_t end = tabs ? record.find('\t', position) : position + 6;
+                unsigned int value;
+                if(end == string_view::npos || !record_field(record, end + tabs, 6, value) || value < s.address) {
+                    m.error_flag |= 2;
+                    return;
+                }
+                this->symbols.define(trim(record.substr(position, end - position)), &s, value - s.address, index);
+                position = end + tabs + 6;
+            }
+        }
+    }
+}
+
+bool LinkingLoader::read_text(module &m, string_view contents) {
+    // an object holds one section after another, each from its H record to its E record
+    section *s = nullptr;
+    size_t position = 0;
+    string_view name;
+    unsigned int address, length;
+
+    while(position < contents.length()) {
+        size_t end = contents.find('\n', position);
+        if(end == string_view::npos) end = contents.length();
+        string_view record = contents.substr(position, end - position);
+        position = end + 1;
+        if(!record.empty() && record.back() == '\r') record.remove_suffix(1);
+        if(record.empty()) continue;
+
+        if(s == nullptr) {
+            if(!read_header_record(record, name, address, length)) {
+                m.error_flag |= 1;
+                return false;
+            }
+            m.sections.push_back(section{string(name), address, length, -1, 0, {}});
+            s = &m.sections.back();
+            continue;
+        }
+
+        switch(record[0]) {
+            case 'T':
+                // the one-pass mode writes a zero length into its H record
+                if(!read_text_record(record, address, length) || address < s->address) {
+                    m.error_flag |= 2;
+                    return false;
+                }
+                s->length = max(s->length, address + length - s->address);
+                s->records.push_back(record);
+                break;
+            case 'M':
+            case 'D':
+                s->records.push_back(record);
+                break;
+            case 'R':
+                // references are looked up by the M records that use them
+                break;
+            case 'E':
+                if(record_field(record, 1, 6, address)) s->entry = address;
+                s = nullptr;
+                break;
+            default:
+                m.error_flag |= 2;
+                return false;
+        }
+    }
+
+    if(s != nullptr || m.sections.empty()) {
+        m.error_flag |= m.sections.empty() ? 1 : 8;
+        return false;
+    }
+    return true;
+}
+
+bool LinkingLoader::read_binary(module &m) {
+    BinaryObjectView view(m.contents);
+    if(!view.isValid()) {
+        m.error_flag |= 16;
+        return false;
+    }
+    const binary_header &h = view.getHeader();
+    m.sections.push_back(section{view.getName(), h.start, h.length, (int)h.entry, 0, {}});
+    return true;
+}
+
+void LinkingLoader::load_module(unsigned int index) {
+    module &m = this->modules[index];
+    for(unsigned int i = 0; i < m.sections.size(); i++) {
+        if(!this->load_section(m, m.sections[i])) return;
+    }
+}
+
+bool LinkingLoader::load_section(module &m, const section &s) {
+    int delta = (int)s.load_address - (int)s.address;
+    unsigned int address, length;
+
+    if(m.binary) {
+        BinaryObjectView view(m.contents);
+        const binary_header &h = view.getHeader();
+        m.error_flag |= load_segments(view, delta, this->memory, this->memory_size, m.ranges);
+        if(m.error_flag != 0) return false;
+        for(unsigned int i = 0; i < h.relocation_count; i++) {
+            if(!unpack_relocation(view.getRelocations()[i], address, length)) {
+                m.error_flag |= 2;
+                return false;
+            }
+            if(!this->relocate(m, address + delta, length, delta)) return false;
+            m.relocations.push_back(ObjectProgram::relocation{address + delta, length});
+        }
+        return true;
+    }
+
+    // the text first, M records may rewrite fields of any T record of the section
+    for(unsigned int i = 0; i < s.records.size(); i++) {
+        string_view record = s.records[i];
+        if(record[0] != 'T') continue;
+        m.error_flag |= load_text_record(record, delta, this->memory, this->memory_size, address, length);
+        if(m.error_flag != 0) return false;
+        m.ranges.push_back(make_pair(address, length));
+    }
+
+    for(unsigned int i = 0; i < s.records.size(); i++) {
+        string_view record = s.records[i];
+        if(record[0] != 'M') continue;
+        if(!read_modification_record(record, address, length) || address < s.address) {
+            m.error_flag |= 2;
+            return false;
+        }
+        address += delta;
+
+        // M<address><length>[+-NAME]
+        string_view name = trim(record.substr(9));
+        int value = delta, sign = 1;
+        if(!name.empty()) {
+            if(name[0] != '+' && name[0] != '-') {
+                m.error_flag |= 2;
+                return false;
+            }
+            sign = name[0] == '+' ? 1 : -1;
+            name.remove_prefix(1);
+            unsigned int symbol;
+            if(name == s.name) {
+                value = sign * delta;
+            } else if(this->symbols.find(name, symbol)) {
+                value = sign * (int)symbol;
+            } else { // undefined external symbol
+                m.error_flag |= 64;
+                return false;
+            }
+        }
+        if(!this->relocate(m, address, length, value)) return false;
+        (sign > 0 ? m.relocations : m.reversed).push_back(ObjectProgram::relocation{address, length});
+    }
+    return true;
+}
+
+bool LinkingLoader::relocate(module &m, unsigned int address, unsigned int length, int value) {
+    m.error_flag |= relocate_field(this->memory, this->memory_size, address, length, value);
+    return m.error_flag == 0;
+}
+
+bool LinkingLoader::writeObject(OutputStream *out, bool binary, unsigned int record_size) const {
+    auto before = [](const ObjectProgram::relocation &a, const ObjectProgram::relocation &b) {
+        return a.address != b.address ? a.address < b.address : a.length < b.length;
+    };
+    vector<pair<unsigned int, unsigned int>> ranges;
+    vector<ObjectProgram::relocation> relocations, reversed;
+    for(unsigned int j = 0; j < this->modules.size(); j++) {
+        const module &m = this->modules[j];
+        ranges.insert(ranges.end(), m.ranges.begin(), m.ranges.end());
+        relocations.insert(relocations.end(), m.relocations.begin(), m.relocations.end());
+        reversed.insert(reversed.end(), m.reversed.begin(), m.reversed.end());
+    }
+
+    // a field that adds one address and subtracts another stays where it is
+    sort(relocations.begin(), relocations.end(), before);
+    sort(reversed.begin(), reversed.end(), before);
+    vector<ObjectProgram::relocation> moved;
+    unsigned int i = 0, k = 0;
+    while(i < relocations.size()) {
+        if(k < reversed.size() && before(reversed[k], relocations[i])) return false;
+        if(k < reversed.size() && !before(relocations[i], reversed[k])) k++;
+        else moved.push_back(relocations[i]);
+        i++;
+    }
+    if(k < reversed.size()) return false;
+
+    // bytes written more than once, by patch records, go out once
+    sort(ranges.begin(), ranges.end());
+    ObjectProgram program;
+    program.setHeader(this->modules.empty() || this->modules[0].sections.empty() ? "" : this->modules[0].sections[0].name, this->start_address, this->program_length);
+    unsigned int written = 0;
+    for(i = 0; i < ranges.size(); i++) {
+        unsigned int begin = max(ranges[i].first, written), end = ranges[i].first + ranges[i].second;
+        if(begin >= end) continue;
+        program.addCode(begin, string_view((const char*)this->memory + begin, end - begin));
+        written = end;
+    }
+    for(i = 0; i < moved.size(); i++) program.addRelocation(moved[i].address, moved[i].length);
+    program.setEntry(this->entry_address);
+
+    if(binary) program.writeBinary(out);
+    else program.writeText(out, record_size);
+    return true;
+}
+
+int LinkingLoader::getEntryAddress() {
+    return this->entry_address;
+}
+
+unsigned int LinkingLoader::getStartAddress() {
+    return this->start_address;
+}
+
+unsigned int LinkingLoader::getProgramLength() {
+    return this->program_length;
+}
+
+unsigned int LinkingLoader::getSectionCount() {
+    unsigned int count = 0;
+    for(unsigned int i = 0; i < this->modules.size(); i++) count += this->modules[i].sections.size();
+    return count;
+}
+
+unsigned int LinkingLoader::getSymbolCount() {
+    return this->symbols.size();
+}
+
+bool LinkingLoader::findSymbol(string_view name, unsigned int &address) {
+    return this->symbols.find(name, address);
+}
+
+int LinkingLoader::getErrorFlag() {
+    return this->error_flag;
+}
+
+int LinkingLoader::getErrorModule() {
+    return this->error_module;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include<stream_interface.hpp>
+#include<hex.hpp>
+#include<object_file.hpp>
+#include<thread_pool.hpp>
+#include<mutex>
+#include<string>
+#include<string_view>
+#include<unordered_map>
+#include<vector>
+
+using namespace std;
+
+// links object programs, each of one or more control sections with H, D, R, T, M and E records,
+// into one memory image:
+//
+//  1. every object is split into its sections and their D symbols go into the external symbol
+//     table, one task per object; a symbol is kept as its section and offset
+//  2. the sections are laid out one after another, a prefix sum over their lengths
+//  3. every object copies its T records and applies its M records, one task per object
+//
+// M records name the symbol whose address they add (+NAME) or subtract (-NAME); an M record
+// without a name, or naming its own section, moves with the section; binary objects have no
+// external symbols and are placed like a section
+class LinkingLoader {
+    struct section {
+        string name;
+        unsigned int address; // of the H record
+        unsigned int length;
+        int entry; // -1 if the E record has no address
+        unsigned int load_address;
+        vector<string_view> records; // D, T and M records in file order
+    };
+
+    struct module {
+        string_view contents;
+        bool binary;
+        vector<section> sections;
+        vector<ObjectProgram::relocation> relocations; // fields that move with the program
+        vector<ObjectProgram::relocation> reversed; // fields subtracting an address
+        vector<pair<unsigned int, unsigned int>> ranges; // loaded bytes, address and length
+        int error_flag;
+    };
+
+    // the symbol table is split into shards of their own lock, so objects define their
+    // symbols at the same time; once linking starts it is only read
+    class ExternalSymbolTable {
+        struct entry {
+            const section *owner;
+            unsigned int offset; // from the load address of 'owner'
+            unsigned int module;
+        };
+
+        struct shard {
+            mutex lock;
+            unordered_map<string, entry> symbols;
+            vector<unsigned int> duplicates; // objects defining a symbol again
+        };
+
+        private:
+            static const unsigned int shard_count = 64;
+            shard shards[shard_count];
+
+            shard& shard_of(string_view name);
+
+        public:
+            // a symbol defined twice stays with the earlier object and the later one is kept as a
+            // duplicate, so which object is blamed does not depend on timing
+            void define(string_view name, const section *owner, unsigned int offset, unsigned int module);
+            bool find(string_view name, unsigned int &address);
+            vector<unsigned int> getDuplicates();
+            unsigned int size();
+            void clear();
+    };
+
+    private:
+        unsigned char *memory;
+        unsigned int memory_size;
+        ThreadPool *pool;
+        vector<module> modules;
+        ExternalSymbolTable symbols;
+        unsigned int start_address;
+        unsigned int program_length;
+        int entry_address;
+        int error_flag;
+        int error_module;
+
+        void run(const function<void(unsigned int)> &step);
+        void read_module(unsigned int index);
+        bool read_text(module &m, string_view contents);
+        bool read_binary(module &m);
+        void load_module(unsigned int index);
+        bool load_section(module &m, const section &s);
+        bool relocate(module &m, unsigned int address, unsigned int length, int value);
+
+    public:
+        LinkingLoader(unsigned char *memory, unsigned int memory_size);
+        LinkingLoader(const LinkingLoader &other) = delete;
+        LinkingLoader& operator=(const LinkingLoader &other) = delete;
+
+        // objects are linked in the order they were added; text or binary, the contents are
+        // used in place and have to live until linking is over
+        void addObject(string_view contents);
+        void clear();
+        // objects run on the pool if there is one
+        void setThreadPool(ThreadPool *pool);
+        // error flags: 1 no H record, 2 invalid record, 4 outside of memory, 8 no E record,
+        // 16 invalid binary image, 32 duplicate external symbol, 64 undefined external symbol
+        bool link(unsigned int load_address = 0);
+        // the linked program as one object of its loaded bytes; M records keep the fields that
+        // move with it, false if a field subtracts an address and cannot be moved; text records
+        // hold up to 'record_size' bytes
+        bool writeObject(OutputStream *out, bool binary, unsigned int record_size = 30) const;
+
+        // the entry of the first object whose E record has one, else the load address
+        int getEntryAddress();
+        unsigned int getStartAddress();
+        unsigned int getProgramLength();
+        unsigned int getSectionCount();
+        unsigned int getSymbolCount();
+        // address of an external symbol or a section once linked
+        bool findSymbol(string_view name, unsigned int &address);
+        int getErrorFlag();
+        // index of the object the error flag comes from, -1 if none
+        int getErrorModule();
+};
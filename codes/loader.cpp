@@ -0,0 +1,137 @@
+#include "loader.hpp"
+
+ObjectLoader::ObjectLoader(unsigned char *memory, unsigned int memory_size) {
+    this->memory = memory;
+    this->memory_size = memory_size;
+    this->start_address = 0;
+    this->program_length = 0;
+    this->entry_address = 0;
+    this->error_flag = 0;
+}
+
+bool ObjectLoader::load(InputStream *input, int load_address) {
+    string_view record, name;
+    vector<modification> modifications;
+    unsigned int address, length;
+    int delta = 0;
+    bool header = false;
+
+    this->error_flag = 0;
+    this->name = "";
+    while(!input->eof()) {
+        record = input->readline_view();
+        if(!record.empty() && record.back() == '\r') record.remove_suffix(1);
+        if(record.empty()) continue;
+
+        if(!header) {
+            if(!read_header_record(record, name, address, length)) {
+                this->error_flag |= 1;
+                return false;
+            }
+            this->name = string(name);
+            this->start_address = load_address >= 0 ? load_address : address;
+            this->program_length = length;
+            delta = this->start_address - (int)address;
+            if((unsigned int)this->start_address + length > this->memory_size) {
+                this->error_flag |= 4;
+                return false;
+            }
+            header = true;
+            continue;
+        }
+
+        if(record[0] == 'T') {
+            if(!this->load_text(record, delta)) return false;
+        } else if(record[0] == 'M') {
+            if(!read_modification_record(record, address, length)) {
+                this->error_flag |= 2;
+                return false;
+            }
+            // patch records of the one-pass mode may still rewrite the field, so M records wait for the E record
+            modifications.push_back(modification{address + delta, length});
+        } else if(record[0] == 'E') {
+            this->entry_address = record_field(record, 1, 6, address) ? address + delta : this->start_address;
+            for(unsigned int i = 0; i < modifications.size(); i++) {
+                if(!this->relocate(modifications[i], delta)) return false;
+            }
+            return true;
+        } else {
+            this->error_flag |= 2;
+            return false;
+        }
+    }
+
+    this->error_flag |= header ? 8 : 1;
+    return false;
+}
+
+bool ObjectLoader::loadBinary(string_view image, int load_address) {
+    BinaryObjectView view(image);
+    this->error_flag = 0;
+    this->name = "";
+    if(!view.isValid()) {
+        this->error_flag |= 16;
+        return false;
+    }
+
+    const binary_header &h = view.getHeader();
+    this->name = view.getName();
+    this->start_address = load_address >= 0 ? load_address : h.start;
+    this->program_length = h.length;
+    int delta = this->start_address - (int)h.start;
+    if((unsigned int)this->start_address + h.length > this->memory_size) {
+        this->error_flag |= 4;
+        return false;
+    }
+
+    vector<pair<unsigned int, unsigned int>> loaded;
+    this->error_flag |= load_segments(view, delta, this->memory, this->memory_size, loaded);
+    if(this->error_flag != 0) return false;
+    for(unsigned int i = 0; i < loaded.size(); i++) {
+        this->program_length = max(this->program_length, (int)(loaded[i].first + loaded[i].second) - this->start_address);
+    }
+    this->entry_address = h.entry + delta;
+    for(unsigned int i = 0; i < h.relocation_count; i++) {
+        unsigned int address, length;
+        if(!unpack_relocation(view.getRelocations()[i], address, length)) {
+            this->error_flag |= 2;
+            return false;
+        }
+        if(!this->relocate(modification{address + delta, length}, delta)) return false;
+    }
+    return true;
+}
+
+bool ObjectLoader::load_text(string_view record, int delta) {
+    unsigned int address, length;
+    this->error_flag |= load_text_record(record, delta, this->memory, this->memory_size, address, length);
+    if(this->error_flag != 0) return false;
+    // the one-pass mode writes a zero length into its H record
+    this->program_length = max(this->program_length, (int)(address + length) - this->start_address);
+    return true;
+}
+
+bool ObjectLoader::relocate(const modification &m, int delta) {
+    this->error_flag |= relocate_field(this->memory, this->memory_size, m.address, m.length, delta);
+    return this->error_flag == 0;
+}
+
+string ObjectLoader::getName() {
+    return this->name;
+}
+
+int ObjectLoader::getStartAddress() {
+    return this->start_address;
+}
+
+int ObjectLoader::getProgramLength() {
+    return this->program_length;
+}
+
+int ObjectLoader::getEntryAddress() {
+    return this->entry_address;
+}
+
+int ObjectLoader::getErrorFlag() {
+    return this->error_flag;
+}
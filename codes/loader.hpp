@@ -0,0 +1,44 @@
+#pragma once
+#include<stream_interface.hpp>
+#include<hex.hpp>
+#include<object_file.hpp>
+#include<string>
+#include<vector>
+
+using namespace std;
+
+// loads an object program (H, T, M and E records) into a flat memory image; the program
+// may be moved to another load address, M records then add the distance it moved; objects
+// with D and R records are linked by the LinkingLoader
+class ObjectLoader {
+    struct modification {
+        unsigned int address;
+        unsigned int length; // in half bytes
+    };
+
+    private:
+        unsigned char *memory;
+        unsigned int memory_size;
+        string name;
+        int start_address; // where the program was loaded
+        int program_length;
+        int entry_address;
+        int error_flag;
+
+        bool load_text(string_view record, int delta);
+        bool relocate(const modification &m, int delta);
+
+    public:
+        ObjectLoader(unsigned char *memory, unsigned int memory_size);
+        // 'load_address' -1 loads the program at the address of its H record;
+        // error flags: 1 no H record, 2 invalid record, 4 outside of memory, 8 no E record
+        bool load(InputStream *input, int load_address = -1);
+        // loads a binary object straight from its image; error flag 16 if the image is invalid
+        bool loadBinary(string_view image, int load_address = -1);
+
+        string getName();
+        int getStartAddress();
+        int getProgramLength();
+        int getEntryAddress();
+        int getErrorFlag();
+};
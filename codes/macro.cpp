@@ -0,0 +1,347 @@
+#include "macro.hpp"
+
+static char fold(char c) {
+    return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+}
+
+static void fold(string &s) {
+    for(unsigned int i = 0; i < s.length(); i++) s[i] = fold(s[i]);
+}
+
+static bool same_name(string_view a, string_view b) {
+    if(a.length() != b.length()) return false;
+    for(size_t i = 0; i < a.length(); i++) {
+        if(fold(a[i]) != fold(b[i])) return false;
+    }
+    return true;
+}
+
+static bool name_char(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// puts 'unique' after every '$' of 's' that starts a symbol; a '$' inside a name, like C$X,
+// and text in quotes, like C'$X', are left as they are
+static void rename(string &s, const string &unique) {
+    bool quoted = false;
+    for(size_t i = 0; i < s.length(); i++) {
+        if(s[i] == '\'') {
+            quoted = !quoted;
+        } else if(s[i] == '$' && !quoted && (i == 0 || !name_char(s[i - 1]))) {
+            s.insert(i + 1, unique);
+            i += unique.length();
+        }
+    }
+}
+
+MacroProcessor::MacroProcessor() {
+    this->clear();
+}
+
+void MacroProcessor::clear() {
+    this->macros.clear();
+    this->defining = nullptr;
+    this->nesting = 0;
+    this->expansions.clear();
+    this->invocations = 0;
+    this->cache_hits = 0;
+}
+
+bool MacroProcessor::next(source_line &line) {
+    while(!this->expansions.empty()) {
+        active &current = this->expansions.back();
+        if(current.label != "") {
+            // the label of the invocation is defined where the expansion starts
+            line.comment = false;
+            line.valid = true;
+            line.label = current.label;
+            line.opcode = "RESB";
+            line.operand = "0";
+            current.label = "";
+            return true;
+        }
+        if(current.next == current.lines->lines.size()) {
+            this->expansions.pop_back();
+            continue;
+        }
+
+        unsigned int index = current.next++;
+        line = current.lines->lines[index];
+        unsigned char unique = current.lines->unique[index];
+        if(unique & 1) rename(line.label, current.unique);
+        if(unique & 2) rename(line.opcode, current.unique);
+        if(unique & 4) rename(line.operand, current.unique);
+        return true;
+    }
+    return false;
+}
+
+void MacroProcessor::take(source_line &line) {
+    // lines the tokenizer could not split may still define or invoke a macro
+    if(!line.comment && !line.valid) line.valid = this->split(line);
+    if(line.comment) return;
+    if(this->macros.empty() && (!line.valid || (line.opcode != "MACRO" && line.opcode != "MEND"))) return;
+
+    // a macro name followed by an operation was split as a label
+    if(line.valid && line.label != "" && line.operand == "" && line.opcode != "MACRO") {
+        string name = line.label;
+        fold(name);
+        if(this->macros.find(name) != this->macros.end()) {
+            line.operand = line.opcode;
+            line.opcode = name;
+            line.label = "";
+        }
+    }
+
+    if(this->defining != nullptr) {
+        bool mend = line.valid && line.opcode == "MEND";
+        if(line.valid && line.opcode == "MACRO") this->nesting++;
+        if(mend && this->nesting == 0) {
+            this->defining = nullptr;
+        } else {
+            if(mend) this->nesting--;
+            template_line body;
+            body.valid = line.valid;
+            body.label = this->make_field(line.label, this->defining->parameters);
+            body.opcode = this->make_field(line.opcode, this->defining->parameters);
+            body.operand = this->make_field(line.operand, this->defining->parameters);
+            this->defining->body.push_back(body);
+        }
+        comment_out(line);
+        return;
+    }
+
+    if(!line.valid) return;
+    if(line.opcode == "MACRO") {
+        line.valid = this->define(line);
+        if(line.valid) comment_out(line);
+    } else if(line.opcode == "MEND") { // no definition to end
+        line.valid = false;
+    } else {
+        unordered_map<string, definition>::iterator found = this->macros.find(line.opcode);
+        if(found == this->macros.end()) return;
+        line.valid = this->invoke(found->second, line);
+        if(line.valid) comment_out(line);
+    }
+}
+
+bool MacroProcessor::split(source_line &line) const {
+    // 'line.operand' holds the text; two tokens where neither is an operation are fine if
+    // one of them is MACRO or the name of a macro
+    string_view text = line.operand, first, second, rest;
+    size_t begin = skip_space(text, 0), end = find_space(text, begin);
+    first = text.substr(begin, end - begin);
+    begin = skip_space(text, end);
+    end = find_space(text, begin);
+    second = text.substr(begin, end - begin);
+    rest = text.substr(min(end + 1, text.length()));
+    while(rest.length() > 0 && (rest.front() == ' ' || rest.front() == '\t')) rest.remove_prefix(1);
+    while(rest.length() > 0 && (rest.back() == ' ' || rest.back() == '\t')) rest.remove_suffix(1);
+    if(first.empty()) return false;
+
+    string name(first);
+    fold(name);
+    if(this->macros.find(name) != this->macros.end()) {
+        // invocation without a label, the rest of the line is its arguments
+        string_view operand = text.substr(first.data() - text.data() + first.length());
+        while(operand.length() > 0 && (operand.front() == ' ' || operand.front() == '\t')) operand.remove_prefix(1);
+        while(operand.length() > 0 && (operand.back() == ' ' || operand.back() == '\t')) operand.remove_suffix(1);
+        line.label = "";
+        line.opcode = name;
+        line.operand = string(operand);
+        return true;
+    }
+
+    name = string(second);
+    fold(name);
+    if(name == "MACRO" || name == "MEND" || this->macros.find(name) != this->macros.end()) {
+        line.label = string(first);
+        line.opcode = name;
+        line.operand = string(rest);
+        return true;
+    }
+    return false;
+}
+
+bool MacroProcessor::define(source_line &line) {
+    // NAME MACRO &A,&B,...
+    if(line.label == "") return false;
+    string name = line.label;
+    fold(name);
+    if(!this->redefinable(name)) return false;
+
+    definition macro;
+    vector<string_view> parameters = split_arguments(line.operand);
+    for(unsigned int i = 0; i < parameters.size(); i++) {
+        if(parameters[i].length() < 2 || parameters[i][0] != '&') return false;
+        for(unsigned int j = 1; j < parameters[i].length(); j++) {
+            if(!name_char(parameters[i][j])) return false;
+        }
+        macro.parameters.push_back(string(parameters[i]));
+    }
+    this->defining = &(this->macros[name] = macro);
+    this->nesting = 0;
+    return true;
+}
+
+bool MacroProcessor::invoke(definition &macro, source_line &line) {
+    if(this->expansions.size() >= max_depth) return false;
+
+    // the same arguments always give the same lines, only their '$' names differ
+    unordered_map<string, expansion>::iterator found = macro.cache.find(line.operand);
+    if(found != macro.cache.end()) {
+        this->cache_hits++;
+    } else {
+        vector<string_view> arguments = split_arguments(line.operand);
+        if(arguments.size() > macro.parameters.size()) return false;
+        expansion lines;
+        string text;
+        for(unsigned int i = 0; i < macro.body.size(); i++) {
+            const template_line &body = macro.body[i];
+            source_line expanded;
+            expanded.comment = false;
+            if(body.valid) {
+                expanded.valid = true;
+                this->expand(body.label, arguments, expanded.label);
+                this->expand(body.opcode, arguments, expanded.opcode);
+                this->expand(body.operand, arguments, expanded.operand);
+                fold(expanded.opcode);
+            } else {
+                this->expand(body.operand, arguments, text);
+                split_text(text, expanded);
+            }
+            lines.unique.push_back((expanded.label.find('$') != string::npos) | (expanded.opcode.find('$') != string::npos) << 1
+                | (expanded.operand.find('$') != string::npos) << 2);
+            lines.lines.push_back(expanded);
+        }
+        found = macro.cache.emplace(line.operand, lines).first;
+    }
+
+    active call;
+    call.macro = &macro;
+    call.lines = &found->second;
+    call.next = 0;
+    call.label = line.label;
+    call.unique = unique_name(this->invocations++);
+    this->expansions.push_back(call);
+    return true;
+}
+
+bool MacroProcessor::redefinable(const string &name) const {
+    // a definition inside a macro body is made again on every expansion of that macro, the new
+    // one replaces the old; the source itself may define a name once, and a macro cannot be
+    // replaced while one of its expansions is still handed out
+    unordered_map<string, definition>::const_iterator found = this->macros.find(name);
+    if(found == this->macros.end()) return true;
+    if(this->expansions.empty()) return false;
+    for(unsigned int i = 0; i < this->expansions.size(); i++) {
+        if(this->expansions[i].macro == &found->second) return false;
+    }
+    return true;
+}
+
+MacroProcessor::field MacroProcessor::make_field(string_view text, const vector<string> &parameters) const {
+    // '&' and a name is a parameter if the macro has one of that name, case does not matter
+    field f;
+    size_t i = 0;
+    while(i < text.length()) {
+        size_t end = i + 1;
+        int parameter = -1;
+        if(text[i] == '&') {
+            while(end < text.length() && name_char(text[end])) end++;
+            for(unsigned int j = 0; j < parameters.size() && parameter < 0; j++) {
+                if(same_name(text.substr(i, end - i), parameters[j])) parameter = j;
+            }
+        }
+        if(parameter >= 0) {
+            f.pieces.push_back(piece{parameter, ""});
+        } else {
+            end = text.find('&', i + 1);
+            if(end == string_view::npos) end = text.length();
+            if(f.pieces.empty() || f.pieces.back().parameter >= 0) f.pieces.push_back(piece{-1, ""});
+            f.pieces.back().text.append(text.substr(i, end - i));
+        }
+        i = end;
+    }
+    return f;
+}
+
+void MacroProcessor::expand(const field &f, const vector<string_view> &arguments, string &out) const {
+    // a parameter without an argument expands to nothing
+    out.clear();
+    for(unsigned int i = 0; i < f.pieces.size(); i++) {
+        if(f.pieces[i].parameter < 0) out += f.pieces[i].text;
+        else if((unsigned int)f.pieces[i].parameter < arguments.size()) out.append(arguments[f.pieces[i].parameter]);
+    }
+}
+
+void MacroProcessor::split_text(string_view text, source_line &line) {
+    // like the reader splits a line, a line that still cannot be split keeps its text
+    source_tokens tokens;
+    line.valid = tokenize_line(text, tokens);
+    if(!line.valid) {
+        line.label = "";
+        line.opcode = "";
+        line.operand = string(text);
+        return;
+    }
+    line.label = string(tokens.label);
+    line.opcode = string(tokens.opcode);
+    line.operand = string(tokens.operand);
+    fold(line.opcode);
+}
+
+void MacroProcessor::comment_out(source_line &line) {
+    // definitions and invocations stay in the listing as comments
+    string text = line.valid ? line.label + '\t' + line.opcode + (line.operand != "" ? '\t' + line.operand : "") : line.operand;
+    line.comment = true;
+    line.operand = "." + text;
+}
+
+vector<string_view> MacroProcessor::split_arguments(string_view operand) {
+    // commas inside quotes belong to the argument, like in C'A,B'
+    vector<string_view> arguments;
+    bool quoted = false;
+    size_t begin = 0;
+    if(operand.empty()) return arguments;
+    for(size_t i = 0; i <= operand.length(); i++) {
+        if(i < operand.length() && operand[i] == '\'') quoted = !quoted;
+        if(i == operand.length() || (operand[i] == ',' && !quoted)) {
+            string_view argument = operand.substr(begin, i - begin);
+            while(argument.length() > 0 && (argument.front() == ' ' || argument.front() == '\t')) argument.remove_prefix(1);
+            while(argument.length() > 0 && (argument.back() == ' ' || argument.back() == '\t')) argument.remove_suffix(1);
+            arguments.push_back(argument);
+            begin = i + 1;
+        }
+    }
+    return arguments;
+}
+
+string MacroProcessor::unique_name(unsigned int invocation) {
+    // AA, AB, ..., ZZ, then AAA and so on
+    unsigned int width = 2, span = 26 * 26;
+    while(invocation >= span) {
+        invocation -= span;
+        width++;
+        span *= 26;
+    }
+    string name(width, 'A');
+    for(unsigned int i = width; i > 0; i--, invocation /= 26) name[i - 1] = 'A' + invocation % 26;
+    return name;
+}
+
+bool MacroProcessor::isDefining() const {
+    return this->defining != nullptr;
+}
+
+unsigned int MacroProcessor::getMacroCount() const {
+    return this->macros.size();
+}
+
+unsigned int MacroProcessor::getInvocationCount() const {
+    return this->invocations;
+}
+
+unsigned long long MacroProcessor::getCacheHits() const {
+    return this->cache_hits;
+}
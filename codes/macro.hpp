@@ -0,0 +1,101 @@
+#pragma once
+#include<tokenizer.hpp>
+#include<string>
+#include<string_view>
+#include<unordered_map>
+#include<vector>
+
+using namespace std;
+
+// expands MACRO/MEND definitions in front of pass 1:
+//
+//  NAME    MACRO   &A,&B
+//  $LOOP   LDA     &A
+//          MEND
+//          NAME    X,Y
+//
+// a body is split once into a template of literal text and parameter references, and the
+// expanded lines of every distinct argument list are kept, so a repeated invocation only
+// copies lines; a '$' that starts a symbol in a body becomes '$' and a name unique to the
+// invocation, like $AALOOP. a MACRO inside a body defines its macro anew on every expansion
+class MacroProcessor {
+    // a run of literal text or a parameter reference, 'parameter' is -1 for text
+    struct piece {
+        int parameter;
+        string text;
+    };
+
+    struct field {
+        vector<piece> pieces;
+    };
+
+    // a body line that could not be split is kept whole in 'operand' and split once expanded,
+    // its parameters may stand for an opcode
+    struct template_line {
+        bool valid;
+        field label;
+        field opcode;
+        field operand;
+    };
+
+    // lines of one argument list, with the fields that still need the invocation's name
+    struct expansion {
+        vector<source_line> lines;
+        vector<unsigned char> unique; // per line, bit 0 label, 1 opcode, 2 operand has a '$'
+    };
+
+    struct definition {
+        vector<string> parameters;
+        vector<template_line> body;
+        unordered_map<string, expansion> cache; // argument text -> expansion
+    };
+
+    // an expansion being handed out
+    struct active {
+        const definition *macro;
+        const expansion *lines;
+        unsigned int next;
+        string label; // label of the invocation, defined by a RESB 0 line before the expansion
+        string unique; // what every '$' is followed by
+    };
+
+    private:
+        unordered_map<string, definition> macros;
+        definition *defining; // macro whose body is being read, nullptr if none
+        unsigned int nesting; // MACRO lines inside the body being read
+        vector<active> expansions; // innermost last
+        unsigned int invocations;
+        unsigned long long cache_hits;
+
+        bool split(source_line &line) const;
+        bool define(source_line &line);
+        bool redefinable(const string &name) const;
+        bool invoke(definition &macro, source_line &line);
+        field make_field(string_view text, const vector<string> &parameters) const;
+        void expand(const field &f, const vector<string_view> &arguments, string &out) const;
+        static void split_text(string_view text, source_line &line);
+        static void comment_out(source_line &line);
+        static vector<string_view> split_arguments(string_view operand);
+        static string unique_name(unsigned int invocation);
+
+        static const unsigned int max_depth = 64;
+
+    public:
+        MacroProcessor();
+        MacroProcessor(const MacroProcessor &other) = delete;
+        MacroProcessor& operator=(const MacroProcessor &other) = delete;
+
+        // the next line of the innermost expansion, false if no expansion is left
+        bool next(source_line &line);
+        // looks at a line on its way to pass 1, from the source or from next(); definitions and
+        // invocations pass on as comments, an invocation queues its expansion for next();
+        // misused MACRO/MEND, unknown arguments and runaway nesting make the line invalid
+        void take(source_line &line);
+        void clear();
+
+        // a definition is open, whatever follows belongs to its body
+        bool isDefining() const;
+        unsigned int getMacroCount() const;
+        unsigned int getInvocationCount() const;
+        unsigned long long getCacheHits() const;
+};
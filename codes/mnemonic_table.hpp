@@ -0,0 +1,127 @@
+#pragma once
+#include<string_view>
+
+using namespace std;
+
+// one entry per mnemonic, instructions and assembler directives share the table
+struct mnemonic {
+    enum kind : unsigned char {
+        INSTRUCTION, START, END, BASE, NOBASE, WORD, BYTE, RESW, RESB, LTORG, CSECT, EXTDEF, EXTREF, EQU, ORG
+    };
+
+    // bit n - 1 is set when format n is allowed
+    enum format : unsigned char {
+        FORMAT_1 = 1, FORMAT_2 = 2, FORMAT_3 = 4, FORMAT_4 = 8
+    };
+
+    string_view name;
+    unsigned char opcode;
+    unsigned char formats;
+    kind directive;
+
+    // shortest format the instruction can be written in, 0 for directives
+    constexpr int length() const {
+        return (formats & FORMAT_1) ? 1 : (formats & FORMAT_2) ? 2 : (formats & FORMAT_3) ? 3 : 0;
+    }
+};
+
+// the table and its hash, the lookup lives in MnemonicTable below
+class MnemonicHash {
+    public:
+        static constexpr unsigned char F34 = mnemonic::FORMAT_3 | mnemonic::FORMAT_4;
+        static constexpr mnemonic entries[] = {
+            {"ADD", 0x18, F34, mnemonic::INSTRUCTION}, {"ADDF", 0x58, F34, mnemonic::INSTRUCTION}, {"ADDR", 0x90, mnemonic::FORMAT_2, mnemonic::INSTRUCTION},
+            {"AND", 0x40, F34, mnemonic::INSTRUCTION}, {"CLEAR", 0xB4, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"COMP", 0x28, F34, mnemonic::INSTRUCTION},
+            {"COMPF", 0x88, F34, mnemonic::INSTRUCTION}, {"COMPR", 0xA0, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"DIV", 0x24, F34, mnemonic::INSTRUCTION},
+            {"DIVF", 0x64, F34, mnemonic::INSTRUCTION}, {"DIVR", 0x9C, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"FIX", 0xC4, mnemonic::FORMAT_1, mnemonic::INSTRUCTION},
+            {"FLOAT", 0xC0, mnemonic::FORMAT_1, mnemonic::INSTRUCTION}, {"HIO", 0xF4, mnemonic::FORMAT_1, mnemonic::INSTRUCTION}, {"J", 0x3C, F34, mnemonic::INSTRUCTION},
+            {"JEQ", 0x30, F34, mnemonic::INSTRUCTION}, {"JGT", 0x34, F34, mnemonic::INSTRUCTION}, {"JLT", 0x38, F34, mnemonic::INSTRUCTION},
+            {"JSUB", 0x48, F34, mnemonic::INSTRUCTION}, {"LDA", 0x00, F34, mnemonic::INSTRUCTION}, {"LDB", 0x68, F34, mnemonic::INSTRUCTION},
+            {"LDCH", 0x50, F34, mnemonic::INSTRUCTION}, {"LDF", 0x70, F34, mnemonic::INSTRUCTION}, {"LDL", 0x08, F34, mnemonic::INSTRUCTION},
+            {"LDS", 0x6C, F34, mnemonic::INSTRUCTION}, {"LDT", 0x74, F34, mnemonic::INSTRUCTION}, {"LDX", 0x04, F34, mnemonic::INSTRUCTION},
+            {"LPS", 0xD0, F34, mnemonic::INSTRUCTION}, {"MUL", 0x20, F34, mnemonic::INSTRUCTION}, {"MULF", 0x60, F34, mnemonic::INSTRUCTION},
+            {"MULR", 0x98, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"NORM", 0xC8, mnemonic::FORMAT_1, mnemonic::INSTRUCTION}, {"OR", 0x44, F34, mnemonic::INSTRUCTION},
+            {"RD", 0xD8, F34, mnemonic::INSTRUCTION}, {"RMO", 0xAC, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"RSUB", 0x4C, F34, mnemonic::INSTRUCTION},
+            {"SHIFTL", 0xA4, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"SHIFTR", 0xA8, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"SIO", 0xF0, mnemonic::FORMAT_1, mnemonic::INSTRUCTION},
+            {"SSK", 0xEC, F34, mnemonic::INSTRUCTION}, {"STA", 0x0C, F34, mnemonic::INSTRUCTION}, {"STB", 0x78, F34, mnemonic::INSTRUCTION},
+            {"STCH", 0x54, F34, mnemonic::INSTRUCTION}, {"STF", 0x80, F34, mnemonic::INSTRUCTION}, {"STI", 0xD4, F34, mnemonic::INSTRUCTION},
+            {"STL", 0x14, F34, mnemonic::INSTRUCTION}, {"STS", 0x7C, F34, mnemonic::INSTRUCTION}, {"STSW", 0xE8, F34, mnemonic::INSTRUCTION},
+            {"STT", 0x84, F34, mnemonic::INSTRUCTION}, {"STX", 0x10, F34, mnemonic::INSTRUCTION}, {"SUB", 0x1C, F34, mnemonic::INSTRUCTION},
+            {"SUBF", 0x5C, F34, mnemonic::INSTRUCTION}, {"SUBR", 0x94, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"SVC", 0xB0, mnemonic::FORMAT_2, mnemonic::INSTRUCTION},
+            {"TD", 0xE0, F34, mnemonic::INSTRUCTION}, {"TIO", 0xF8, mnemonic::FORMAT_1, mnemonic::INSTRUCTION}, {"TIX", 0x2C, F34, mnemonic::INSTRUCTION},
+            {"TIXR", 0xB8, mnemonic::FORMAT_2, mnemonic::INSTRUCTION}, {"WD", 0xDC, F34, mnemonic::INSTRUCTION},
+            // assembler directives
+            {"START", 0, 0, mnemonic::START}, {"END", 0, 0, mnemonic::END}, {"BASE", 0, 0, mnemonic::BASE}, {"NOBASE", 0, 0, mnemonic::NOBASE},
+            {"WORD", 0, 0, mnemonic::WORD}, {"BYTE", 0, 0, mnemonic::BYTE}, {"RESW", 0, 0, mnemonic::RESW}, {"RESB", 0, 0, mnemonic::RESB},
+            {"LTORG", 0, 0, mnemonic::LTORG}, {"CSECT", 0, 0, mnemonic::CSECT}, {"EXTDEF", 0, 0, mnemonic::EXTDEF}, {"EXTREF", 0, 0, mnemonic::EXTREF},
+            {"EQU", 0, 0, mnemonic::EQU}, {"ORG", 0, 0, mnemonic::ORG}
+        };
+        static constexpr int entry_count = sizeof(entries) / sizeof(entries[0]);
+        static constexpr int slot_bits = 9;
+        static constexpr int slot_count = 1 << slot_bits;
+        static constexpr unsigned char empty_slot = 0xFF;
+
+        static constexpr char fold(char c) {
+            return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+        }
+
+        static constexpr unsigned int hash(string_view s, unsigned int seed) {
+            unsigned int h = seed;
+            for(size_t i = 0; i < s.length(); i++) h = (h ^ (unsigned char)fold(s[i])) * 0x01000193u;
+            return (h ^ (h >> 15)) & (slot_count - 1);
+        }
+
+        struct slot_table {
+            unsigned int seed;
+            unsigned char slots[slot_count];
+        };
+
+        // search for a seed that maps every mnemonic to its own slot
+        static constexpr slot_table build() {
+            slot_table table = {};
+            for(unsigned int seed = 0x811C9DC5u;; seed++) {
+                bool collision = false;
+                for(int i = 0; i < slot_count; i++) table.slots[i] = empty_slot;
+                for(int i = 0; i < entry_count && !collision; i++) {
+                    unsigned int h = hash(entries[i].name, seed);
+                    if(table.slots[h] != empty_slot) collision = true;
+                    else table.slots[h] = i;
+                }
+                if(!collision) {
+                    table.seed = seed;
+                    return table;
+                }
+            }
+        }
+
+};
+
+class MnemonicTable {
+    private:
+        static constexpr MnemonicHash::slot_table table = MnemonicHash::build();
+
+    public:
+        // single probe, case insensitive; a leading '+' is skipped and reported through 'extended'
+        static constexpr const mnemonic* find(string_view name, bool &extended) {
+            extended = name.length() > 0 && name[0] == '+';
+            if(extended) name.remove_prefix(1);
+            if(name.length() == 0) return nullptr;
+
+            unsigned char index = table.slots[MnemonicHash::hash(name, table.seed)];
+            if(index == MnemonicHash::empty_slot) return nullptr;
+
+            const mnemonic &entry = MnemonicHash::entries[index];
+            if(entry.name.length() != name.length()) return nullptr;
+            for(size_t i = 0; i < name.length(); i++) {
+                if(MnemonicHash::fold(name[i]) != entry.name[i]) return nullptr;
+            }
+            // directives have no extended form
+            if(extended && entry.directive != mnemonic::INSTRUCTION) return nullptr;
+            return &entry;
+        }
+
+        static constexpr const mnemonic* find(string_view name) {
+            bool extended = false;
+            return find(name, extended);
+        }
+};
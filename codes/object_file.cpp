@@ -0,0 +1,353 @@
+#include "object_file.hpp"
+#include<utility.hpp>
+#include<cstring>
+
+static_assert(sizeof(binary_header) == 76 && sizeof(binary_segment) == 12 && sizeof(binary_symbol) == 12, "binary tables are read in place");
+
+static const char binary_magic[4] = {'S', 'X', 'O', 'B'};
+static const unsigned int binary_version = 1;
+
+static bool little_endian() {
+    unsigned int one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+static void put_word(string &out, unsigned int value) {
+    char bytes[4] = {(char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24)};
+    out.append(bytes, 4);
+}
+
+static void align(string &out) {
+    out.append((4 - out.length() % 4) % 4, '\0');
+}
+
+BinaryObjectView::BinaryObjectView(string_view image) {
+    this->data = image.data();
+    this->size = image.length();
+    this->valid = false;
+    if(!isBinary(image) || !little_endian() || (size_t)this->data % 4 != 0) return;
+
+    // every table has to lie inside the image
+    const binary_header &h = this->getHeader();
+    auto inside = [this](unsigned long long offset, unsigned long long count, unsigned long long width) {
+        return offset % 4 == 0 && offset + count * width <= this->size;
+    };
+    this->valid = h.version == binary_version && inside(h.segments, h.segment_count, sizeof(binary_segment)) && inside(h.code, h.code_size, 1)
+        && inside(h.relocations, h.relocation_count, 4) && inside(h.symbols, h.symbol_count, sizeof(binary_symbol)) && inside(h.strings, h.strings_size, 1);
+}
+
+bool BinaryObjectView::isValid() const {
+    return this->valid;
+}
+
+const binary_header& BinaryObjectView::getHeader() const {
+    return *(const binary_header*)this->data;
+}
+
+string BinaryObjectView::getName() const {
+    const binary_header &h = this->getHeader();
+    return string(h.name, strnlen(h.name, sizeof(h.name)));
+}
+
+const binary_segment* BinaryObjectView::getSegments() const {
+    return (const binary_segment*)(this->data + this->getHeader().segments);
+}
+
+const unsigned char* BinaryObjectView::getCode() const {
+    return (const unsigned char*)(this->data + this->getHeader().code);
+}
+
+const unsigned int* BinaryObjectView::getRelocations() const {
+    return (const unsigned int*)(this->data + this->getHeader().relocations);
+}
+
+const binary_symbol* BinaryObjectView::getSymbols() const {
+    return (const binary_symbol*)(this->data + this->getHeader().symbols);
+}
+
+string_view BinaryObjectView::getSymbolName(const binary_symbol &symbol) const {
+    const binary_header &h = this->getHeader();
+    if((unsigned long long)symbol.name + symbol.name_length > h.strings_size) return string_view();
+    return string_view(this->data + h.strings + symbol.name, symbol.name_length);
+}
+
+bool BinaryObjectView::getSegmentBytes(const binary_segment &segment, string_view &bytes) const {
+    const binary_header &h = this->getHeader();
+    if((unsigned long long)segment.offset + segment.length > h.code_size) return false;
+    bytes = string_view((const char*)this->getCode() + segment.offset, segment.length);
+    return true;
+}
+
+bool BinaryObjectView::isBinary(string_view image) {
+    return image.length() >= sizeof(binary_header) && memcmp(image.data(), binary_magic, 4) == 0;
+}
+
+bool record_field(string_view record, size_t begin, size_t length, unsigned int &value) {
+    return record.length() >= begin + length && hex_number(record.substr(begin, length), value);
+}
+
+bool read_header_record(string_view record, string_view &name, unsigned int &address, unsigned int &length) {
+    size_t tab = record.find('\t');
+    size_t fields = tab != string_view::npos ? tab + 1 : 7;
+    if(record.empty() || record[0] != 'H' || !record_field(record, fields, 6, address) || !record_field(record, fields + 6, 6, length)) return false;
+    name = record.substr(1, min(tab, (size_t)7) - 1);
+    while(!name.empty() && name.back() == ' ') name.remove_suffix(1);
+    return true;
+}
+
+bool read_text_record(string_view record, unsigned int &address, unsigned int &length) {
+    return record_field(record, 1, 6, address) && record_field(record, 7, 2, length) && record.length() == 9 + 2 * length;
+}
+
+bool decode_text_record(string_view record, unsigned char *bytes) {
+    for(size_t i = 0; 10 + 2 * i < record.length(); i++) {
+        int high = hex_digit(record[9 + 2 * i]), low = hex_digit(record[10 + 2 * i]);
+        if(high < 0 || low < 0) return false;
+        bytes[i] = high << 4 | low;
+    }
+    return true;
+}
+
+bool read_modification_record(string_view record, unsigned int &address, unsigned int &length) {
+    return record_field(record, 1, 6, address) && record_field(record, 7, 2, length) && length > 0 && length <= 6;
+}
+
+int load_text_record(string_view record, int delta, unsigned char *memory, unsigned int memory_size, unsigned int &address, unsigned int &length) {
+    if(!read_text_record(record, address, length)) return 2;
+    address += delta;
+    if((unsigned long long)address + length > memory_size) return 4;
+    return decode_text_record(record, memory + address) ? 0 : 2;
+}
+
+int load_segments(const BinaryObjectView &view, int delta, unsigned char *memory, unsigned int memory_size, vector<pair<unsigned int, unsigned int>> &loaded) {
+    const binary_header &h = view.getHeader();
+    string_view bytes;
+    for(unsigned int i = 0; i < h.segment_count; i++) {
+        const binary_segment &s = view.getSegments()[i];
+        unsigned int address = s.address + delta;
+        if(!view.getSegmentBytes(s, bytes)) return 16;
+        if((unsigned long long)address + bytes.length() > memory_size) return 4;
+        memcpy(memory + address, bytes.data(), bytes.length());
+        loaded.push_back(make_pair(address, (unsigned int)bytes.length()));
+    }
+    return 0;
+}
+
+int relocate_field(unsigned char *memory, unsigned int memory_size, unsigned int address, unsigned int length, int value) {
+    unsigned int bytes = (length + 1) / 2, field = 0, mask = (1u << (4 * length)) - 1;
+    if((unsigned long long)address + bytes > memory_size) return 4;
+    for(unsigned int i = 0; i < bytes; i++) field = field << 8 | memory[address + i];
+    field = (field & ~mask) | ((field + value) & mask);
+    for(unsigned int i = bytes; i > 0; i--, field >>= 8) memory[address + i - 1] = field;
+    return 0;
+}
+
+ObjectProgram::ObjectProgram() {
+    this->clear();
+}
+
+void ObjectProgram::clear() {
+    this->name = "";
+    this->start = 0;
+    this->length = 0;
+    this->entry = 0;
+    this->segments.clear();
+    this->relocations.clear();
+    this->symbols.clear();
+    this->error_flag = 0;
+}
+
+void ObjectProgram::setHeader(string name, unsigned int start, unsigned int length) {
+    this->name = name;
+    this->start = start;
+    this->length = length;
+}
+
+void ObjectProgram::setEntry(unsigned int entry) {
+    this->entry = entry;
+}
+
+void ObjectProgram::addCode(unsigned int address, string_view bytes) {
+    if(bytes.empty()) return;
+    if(this->segments.empty() || this->segments.back().address + this->segments.back().bytes.length() != address) {
+        this->segments.push_back(segment{address, ""});
+    }
+    this->segments.back().bytes.append(bytes);
+}
+
+void ObjectProgram::addRelocation(unsigned int address, unsigned int length) {
+    this->relocations.push_back(relocation{address, length});
+}
+
+void ObjectProgram::addSymbol(string_view name, int value) {
+    this->symbols.push_back(symbol{string(name), value});
+}
+
+bool ObjectProgram::readText(InputStream *input) {
+    string_view record, name;
+    string bytes;
+    unsigned int address, length;
+    bool header = false;
+
+    this->clear();
+    while(!input->eof()) {
+        record = input->readline_view();
+        if(!record.empty() && record.back() == '\r') record.remove_suffix(1);
+        if(record.empty()) continue;
+
+        if(!header) {
+            if(!read_header_record(record, name, address, length)) {
+                this->error_flag |= 1;
+                return false;
+            }
+            this->setHeader(string(name), address, length);
+            header = true;
+        } else if(record[0] == 'T') {
+            if(!read_text_record(record, address, length)) {
+                this->error_flag |= 2;
+                return false;
+            }
+            bytes.resize(length);
+            if(!decode_text_record(record, (unsigned char*)&bytes[0])) {
+                this->error_flag |= 2;
+                return false;
+            }
+            this->addCode(address, bytes);
+        } else if(record[0] == 'M') {
+            if(!read_modification_record(record, address, length)) {
+                this->error_flag |= 2;
+                return false;
+            }
+            this->addRelocation(address, length);
+        } else if(record[0] == 'E') {
+            this->entry = record_field(record, 1, 6, address) ? address : this->start;
+            return true;
+        } else {
+            this->error_flag |= 2;
+            return false;
+        }
+    }
+
+    this->error_flag |= header ? 8 : 1;
+    return false;
+}
+
+bool ObjectProgram::readBinary(string_view image) {
+    BinaryObjectView view(image);
+    this->clear();
+    if(!view.isValid()) {
+        this->error_flag |= 16;
+        return false;
+    }
+
+    const binary_header &h = view.getHeader();
+    this->setHeader(view.getName(), h.start, h.length);
+    this->entry = h.entry;
+    string_view bytes;
+    for(unsigned int i = 0; i < h.segment_count; i++) {
+        const binary_segment &s = view.getSegments()[i];
+        if(!view.getSegmentBytes(s, bytes)) {
+            this->error_flag |= 16;
+            return false;
+        }
+        // segments stay apart even when they touch, later ones may overwrite earlier ones
+        this->segments.push_back(segment{s.address, string(bytes)});
+    }
+    for(unsigned int i = 0; i < h.relocation_count; i++) {
+        this->addRelocation(view.getRelocations()[i] >> 8, view.getRelocations()[i] & 0xFF);
+    }
+    for(unsigned int i = 0; i < h.symbol_count; i++) {
+        this->addSymbol(view.getSymbolName(view.getSymbols()[i]), view.getSymbols()[i].value);
+    }
+    return true;
+}
+
+void ObjectProgram::writeText(OutputStream *out, unsigned int record_size) const {
+    string records;
+    record_size = min(max(record_size, 1u), 255u);
+    records = "H" + sep() + this->name + '\t' + sep() + align_right(hex_field(this->start, 6), 6, '0') + sep() + align_right(hex_field(this->length, 6), 6, '0') + '\n';
+    for(unsigned int i = 0; i < this->segments.size(); i++) {
+        const segment &s = this->segments[i];
+        for(size_t done = 0; done < s.bytes.length(); done += record_size) {
+            size_t bytes = min(s.bytes.length() - done, (size_t)record_size);
+            records += "T" + sep() + hex_field(s.address + done, 6) + sep() + hex_field(bytes, 2) + sep() + hex_encode(s.bytes.substr(done, bytes)) + '\n';
+        }
+    }
+    for(unsigned int i = 0; i < this->relocations.size(); i++) {
+        records += "M" + sep() + hex_field(this->relocations[i].address, 6) + sep() + hex_field(this->relocations[i].length, 2) + '\n';
+    }
+    records += "E" + sep() + hex_field(this->entry, 6) + '\n';
+    out->write(records);
+}
+
+void ObjectProgram::writeBinary(OutputStream *out) const {
+    string image, code, strings;
+    unsigned int i;
+
+    // the header goes in last, once every offset is known
+    image.assign(sizeof(binary_header), '\0');
+    unsigned int segments = image.length();
+    for(i = 0; i < this->segments.size(); i++) {
+        put_word(image, this->segments[i].address);
+        put_word(image, this->segments[i].bytes.length());
+        put_word(image, code.length());
+        code += this->segments[i].bytes;
+    }
+    unsigned int code_offset = image.length();
+    image += code;
+    align(image);
+    unsigned int relocations = image.length();
+    for(i = 0; i < this->relocations.size(); i++) put_word(image, pack_relocation(this->relocations[i].address, this->relocations[i].length));
+    unsigned int symbols = image.length();
+    for(i = 0; i < this->symbols.size(); i++) {
+        put_word(image, strings.length());
+        put_word(image, this->symbols[i].name.length());
+        put_word(image, this->symbols[i].value);
+        strings += this->symbols[i].name;
+    }
+    unsigned int strings_offset = image.length();
+    image += strings;
+    align(image);
+
+    string header(binary_magic, 4);
+    put_word(header, binary_version);
+    header += this->name.substr(0, 16);
+    header.append(24 - header.length(), '\0');
+    unsigned int fields[] = {this->start, this->length, this->entry, (unsigned int)this->segments.size(), segments, (unsigned int)code.length(), code_offset,
+        (unsigned int)this->relocations.size(), relocations, (unsigned int)this->symbols.size(), symbols, (unsigned int)strings.length(), strings_offset};
+    for(i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) put_word(header, fields[i]);
+    image.replace(0, header.length(), header);
+    out->write(image);
+}
+
+string ObjectProgram::getName() const {
+    return this->name;
+}
+
+unsigned int ObjectProgram::getStart() const {
+    return this->start;
+}
+
+unsigned int ObjectProgram::getLength() const {
+    return this->length;
+}
+
+unsigned int ObjectProgram::getEntry() const {
+    return this->entry;
+}
+
+const vector<ObjectProgram::segment>& ObjectProgram::getSegments() const {
+    return this->segments;
+}
+
+const vector<ObjectProgram::relocation>& ObjectProgram::getRelocations() const {
+    return this->relocations;
+}
+
+const vector<ObjectProgram::symbol>& ObjectProgram::getSymbols() const {
+    return this->symbols;
+}
+
+int ObjectProgram::getErrorFlag() {
+    return this->error_flag;
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include<stream_interface.hpp>
+#include<hex.hpp>
+#include<string>
+#include<string_view>
+#include<utility>
+#include<vector>
+
+using namespace std;
+
+// binary object layout: every field is a little endian 32 bit word and every table starts at
+// a multiple of 4 from the start of the file, so a mapped file is read in place
+struct binary_header {
+    char magic[4]; // "SXOB"
+    unsigned int version;
+    char name[16]; // zero padded, longer names are cut
+    unsigned int start;
+    unsigned int length;
+    unsigned int entry;
+    unsigned int segment_count;
+    unsigned int segments; // offset of binary_segment[segment_count]
+    unsigned int code_size;
+    unsigned int code; // offset of the bytes of every segment, back to back
+    unsigned int relocation_count;
+    unsigned int relocations; // offset of the packed relocations
+    unsigned int symbol_count; // 0 if the symbol section was left out
+    unsigned int symbols; // offset of binary_symbol[symbol_count]
+    unsigned int strings_size;
+    unsigned int strings; // offset of the symbol names
+};
+
+struct binary_segment {
+    unsigned int address;
+    unsigned int length;
+    unsigned int offset; // into the code bytes
+};
+
+struct binary_symbol {
+    unsigned int name; // offset into the strings
+    unsigned int name_length;
+    int value;
+};
+
+// a relocation packs its address into the upper 24 bits and its length in half bytes into the lowest 8
+inline unsigned int pack_relocation(unsigned int address, unsigned int length) {
+    return address << 8 | (length & 0xFF);
+}
+
+// false if the length is not one of a field, 1 to 6 half bytes
+inline bool unpack_relocation(unsigned int packed, unsigned int &address, unsigned int &length) {
+    address = packed >> 8;
+    length = packed & 0xFF;
+    return length > 0 && length <= 6;
+}
+
+// a binary object used in place; the image has to stay mapped while the view is used
+class BinaryObjectView {
+    private:
+        const char *data;
+        size_t size;
+        bool valid;
+
+    public:
+        BinaryObjectView(string_view image);
+        // the header and every table lie inside the image; segment and symbol bounds are checked where they are used
+        bool isValid() const;
+        const binary_header& getHeader() const;
+        string getName() const;
+        const binary_segment* getSegments() const;
+        const unsigned char* getCode() const;
+        const unsigned int* getRelocations() const;
+        const binary_symbol* getSymbols() const;
+        // "" if the name lies outside the strings
+        string_view getSymbolName(const binary_symbol &symbol) const;
+        // false if the bytes lie outside the code
+        bool getSegmentBytes(const binary_segment &segment, string_view &bytes) const;
+
+        static bool isBinary(string_view image);
+};
+
+// text records read in place, and objects copied into a memory image; ObjectProgram, the
+// ObjectLoader and the LinkingLoader all go through these. the int functions give 0 or the
+// error flag of the loaders: 2 invalid record, 4 outside of memory, 16 invalid binary image
+
+// a hex field at fixed columns of a record
+bool record_field(string_view record, size_t begin, size_t length, unsigned int &value);
+// an H record, its name followed by a tab or padded to 6 columns; the name comes without padding
+bool read_header_record(string_view record, string_view &name, unsigned int &address, unsigned int &length);
+// a T record with all of its 'length' bytes
+bool read_text_record(string_view record, unsigned int &address, unsigned int &length);
+// the bytes of a record read_text_record() took, false if one of them is not hex
+bool decode_text_record(string_view record, unsigned char *bytes);
+// an M record, 'length' in half bytes; a symbol after it is left to the caller
+bool read_modification_record(string_view record, unsigned int &address, unsigned int &length);
+
+// a T record 'delta' bytes from its address; 'address' and 'length' tell where it went
+int load_text_record(string_view record, int delta, unsigned char *memory, unsigned int memory_size, unsigned int &address, unsigned int &length);
+// the segments of a valid binary object 'delta' bytes from their addresses, in file order so
+// later patches win like later T records; 'loaded' gets the address and length of each
+int load_segments(const BinaryObjectView &view, int delta, unsigned char *memory, unsigned int memory_size, vector<pair<unsigned int, unsigned int>> &loaded);
+// adds 'value' to a field of 'length' half bytes; a field of odd length starts in the low half of its first byte
+int relocate_field(unsigned char *memory, unsigned int memory_size, unsigned int address, unsigned int length, int value);
+
+// an object program in memory, read from and written to either format
+class ObjectProgram {
+    public:
+        struct segment {
+            unsigned int address;
+            string bytes;
+        };
+
+        struct relocation {
+            unsigned int address;
+            unsigned int length; // in half bytes
+        };
+
+        struct symbol {
+            string name;
+            int value;
+        };
+
+    private:
+        string name;
+        unsigned int start;
+        unsigned int length;
+        unsigned int entry;
+        vector<segment> segments;
+        vector<relocation> relocations;
+        vector<symbol> symbols;
+        int error_flag;
+
+    public:
+        ObjectProgram();
+        void clear();
+        void setHeader(string name, unsigned int start, unsigned int length);
+        void setEntry(unsigned int entry);
+        // bytes continuing the last segment are appended to it, anything else starts a segment
+        void addCode(unsigned int address, string_view bytes);
+        void addRelocation(unsigned int address, unsigned int length);
+        void addSymbol(string_view name, int value);
+
+        // error flags: 1 no H record, 2 invalid record, 8 no E record, 16 invalid binary image
+        bool readText(InputStream *input);
+        bool readBinary(string_view image);
+        // text records hold up to 'record_size' bytes, at most 255, and never span two segments
+        void writeText(OutputStream *out, unsigned int record_size = 30) const;
+        void writeBinary(OutputStream *out) const;
+
+        string getName() const;
+        unsigned int getStart() const;
+        unsigned int getLength() const;
+        unsigned int getEntry() const;
+        const vector<segment>& getSegments() const;
+        const vector<relocation>& getRelocations() const;
+        const vector<symbol>& getSymbols() const;
+        int getErrorFlag();
+};
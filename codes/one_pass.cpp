@@ -0,0 +1,302 @@
+#include "assembler.hpp"
+
+// one-pass mode: lines are encoded as they are read and nothing of the source is kept;
+// a reference to a symbol that is not defined yet is written with an empty address
+// field and patched when the symbol shows up, so memory grows with the number of
+// unresolved references instead of the size of the program; control sections are not
+// supported, their D records would have to come before code that defines their symbols;
+// EQU values and expression operands are computed on their line, from the symbols above it
+//
+// an M record goes out once its symbol is known to be relative and the text record with its
+// field is written, so only the M records of the open text record are kept; the length in
+// the H record is written at END if the object can be gone back over, else it stays 000000
+
+static bool pc_relative(int target, int pc) {
+    return target - pc >= -2048 && target - pc <= 2047;
+}
+
+bool SICXEAssembler::assembleOnePass() {
+    string_view line;
+    string label, opcode, operand;
+    instruction current;
+    text_record t_record;
+    int locctr = 0, base = -1, base_symbol = -1;
+    bool started = false;
+    Stats::Timer timer(Stats::PASS1);
+
+    this->error_flag = 0;
+    this->program_length = 0;
+    this->start_address = 0;
+    this->incremental_ready = false;
+    this->symbol_table.clear();
+    this->sections.clear();
+    this->control_sections = false;
+    this->literals.clear();
+    this->literal_pools = 0;
+    this->relaxed_lines = 0;
+    this->expressions.clear();
+    this->equates.clear();
+    this->equate_order.clear();
+    this->org_return = -1;
+    this->fixups.clear();
+    this->m_records.clear();
+    this->length_field = string::npos;
+
+    while(!this->input->eof()) {
+        line = this->input->readline_view();
+        Stats::count(Stats::LINES);
+        if(this->input_is_comment(line)) {
+            Stats::count(Stats::COMMENTS);
+            continue;
+        }
+        if(!parse_input_line(line, label, opcode, operand)) { // invalid line
+            this->error_flag |= 2;
+            return this->finish_one_pass(false);
+        }
+        if(opcode == "CSECT" || opcode == "EXTDEF" || opcode == "EXTREF") {
+            this->error_flag |= 16;
+            return this->finish_one_pass(false);
+        }
+
+        // the header goes out with the first line
+        if(!started) {
+            started = true;
+            if(opcode == "END") { // empty program
+                this->error_flag |= 1;
+                return this->finish_one_pass(false);
+            }
+            if(opcode == "START") {
+                current = this->process_instruction(locctr, label, opcode, operand);
+                if(this->error_flag) return this->finish_one_pass(false);
+                this->write_one_pass_header(current);
+                this->start_text_record(t_record, this->start_address);
+                continue;
+            }
+            current.opcode = opcode;
+            this->write_one_pass_header(current);
+            this->start_text_record(t_record, this->start_address);
+        }
+
+        // the last literal pool goes in front of END
+        if(opcode == "END" && !this->encode_literals(locctr, t_record)) return this->finish_one_pass(false);
+        current = this->process_instruction(locctr, label, opcode, operand);
+        // nothing is kept to resolve an EQU later, its symbols have to be defined above it
+        if(opcode == "EQU" && !this->symbol_table.isDefined(this->symbol_table.find(label))) this->error_flag |= 4;
+        if(this->error_flag) return this->finish_one_pass(false);
+        if(label != "") {
+            int id = this->symbol_table.find(label);
+            if(!this->define_symbol(id, t_record)) return this->finish_one_pass(false);
+            if(id == base_symbol) {
+                base = this->symbol_table.getValue(id);
+                base_symbol = -1;
+            }
+        }
+
+        if(opcode == "END") {
+            if(t_record.length > 0) this->write_text_record(t_record, this->output_object);
+            this->write_m_records(t_record, true);
+            return this->finish_one_pass(true);
+        } else if(opcode == "BASE") {
+            if(this->symbol_table.isDefined(current.symbol)) {
+                base = this->symbol_table.getValue(current.symbol);
+                base_symbol = -1;
+            } else {
+                // an empty list marks a BASE symbol that still has to be defined
+                base = -1;
+                base_symbol = current.symbol;
+                this->fixups[base_symbol];
+            }
+        } else if(opcode == "NOBASE") {
+            base = -1;
+            base_symbol = -1;
+        } else if(opcode == "LTORG") {
+            if(!this->encode_literals(locctr, t_record)) return this->finish_one_pass(false);
+        } else if(!this->encode_one_pass(current, base, base_symbol, t_record)) {
+            return this->finish_one_pass(false);
+        }
+    }
+
+    // no END statement, or nothing at all
+    this->error_flag |= started ? 32 : 1;
+    return this->finish_one_pass(false);
+}
+
+bool SICXEAssembler::encode_one_pass(const instruction &line, int base, int base_symbol, text_record &t_record) {
+    pass2_chunk chunk;
+    int wait_for = -1;
+    bool extended;
+    const mnemonic *entry = MnemonicTable::find(line.opcode, extended);
+
+    chunk.base = base;
+    chunk.error_flag = 0;
+    if(line.expression >= 0) {
+        // a fixup patches in one symbol, the symbols of an expression have to be defined above it
+        vector<int> uses;
+        this->expressions[line.expression].getSymbols(uses);
+        for(unsigned int i = 0; i < uses.size(); i++) {
+            if(this->symbol_table.isDefined(uses[i])) continue;
+            this->error_flag |= 64 | 4;
+            return false;
+        }
+    } else if(line.symbol >= 0) {
+        if(!this->symbol_table.isDefined(line.symbol)) wait_for = line.symbol;
+        else if(!extended && base_symbol >= 0 && !pc_relative(this->symbol_table.getValue(line.symbol), line.address + 3)) wait_for = base_symbol;
+    }
+
+    if(wait_for < 0) {
+        this->toObjCode(line.address, line.opcode, line.operand, line.symbol, line.expression, chunk);
+    } else {
+        // encode with address 0, the fixup fills in the address field and the b/p flags
+        string operand = line.operand;
+        bool indexed = operand.length() >= 2 && isIndexed(operand);
+        operand = (isImmediate(operand) || isIndirect(operand) ? operand.substr(0, 1) : "") + "0" + (indexed ? ",X" : "");
+        this->toObjCode(line.address, line.opcode, operand, -1, -1, chunk);
+
+        fixup reference;
+        reference.address = line.address;
+        reference.word = 0;
+        for(unsigned int i = 0; i < chunk.bytes.length(); i++) reference.word = reference.word << 8 | (unsigned char)chunk.bytes[i];
+        reference.extended = entry != nullptr && extended;
+        reference.symbol = line.symbol;
+        reference.base = base;
+        reference.base_symbol = base_symbol;
+        this->fixups[wait_for].push_back(reference);
+    }
+    if(chunk.error_flag) {
+        this->error_flag = chunk.error_flag;
+        return false;
+    }
+
+    // the M records of a line wait for the text record with their field
+    this->m_records.insert(this->m_records.end(), chunk.m_records.begin(), chunk.m_records.end());
+    this->process_text_record(t_record, line.address, chunk.bytes, this->output_object);
+    this->write_m_records(t_record, false);
+    return true;
+}
+
+bool SICXEAssembler::define_symbol(int symbol, text_record &t_record) {
+    unordered_map<int, vector<fixup> >::iterator waiting = this->fixups.find(symbol);
+    if(waiting == this->fixups.end()) return true;
+
+    vector<fixup> references;
+    references.swap(waiting->second);
+    this->fixups.erase(waiting);
+
+    pass2_chunk chunk;
+    string bytes;
+    for(unsigned int i = 0; i < references.size(); i++) {
+        fixup &reference = references[i];
+        // the BASE symbol may have been defined while the reference waited for its target
+        if(this->symbol_table.isDefined(reference.base_symbol)) {
+            reference.base = this->symbol_table.getValue(reference.base_symbol);
+            reference.base_symbol = -1;
+        }
+
+        unsigned int word;
+        int target = this->symbol_table.getValue(reference.symbol);
+        if(reference.extended) {
+            word = reference.word | (target & 0xFFFFF);
+            bytes.assign({(char)(word >> 16), (char)(word >> 8), (char)word});
+            // now that the symbol is known, only a relative one needs an M record
+            if(!this->symbol_table.isAbsolute(reference.symbol)) {
+                this->m_records.push_back(modification_record{reference.address + 1, 5, -1, false});
+            }
+        } else if(!pc_relative(target, reference.address + 3) && reference.base_symbol >= 0) {
+            // the target is known but needs a BASE that is not
+            this->fixups[reference.base_symbol].push_back(reference);
+            continue;
+        } else {
+            unsigned int flags = 0;
+            chunk.base = reference.base;
+            chunk.error_flag = 0;
+            int disp = this->getDisplacement(reference.address + 3, flags, string(this->symbol_table.getName(reference.symbol)), reference.symbol, -1, chunk);
+            if(chunk.error_flag) {
+                this->error_flag = chunk.error_flag;
+                return false;
+            }
+            word = reference.word | flags << 12 | (disp & 0xFFF);
+            bytes.assign({(char)(word >> 8), (char)word});
+        }
+        this->patch_object_code(reference.address + 1, bytes, t_record);
+    }
+    this->write_m_records(t_record, false);
+    return true;
+}
+
+bool SICXEAssembler::encode_literals(int &locctr, text_record &t_record) {
+    // placing the pool defines its entries, which patches the references waiting for them
+    vector<instruction> pool = this->literal_pool(locctr);
+    string bytes;
+    for(unsigned int i = 0; i < pool.size(); i++) {
+        if(!this->define_symbol(pool[i].symbol, t_record)) return false;
+        parse_literal(pool[i].opcode, bytes);
+        this->process_text_record(t_record, pool[i].address, bytes, this->output_object);
+    }
+    return true;
+}
+
+void SICXEAssembler::patch_object_code(int address, string_view bytes, text_record &t_record) const {
+    // bytes still in the open text record are rewritten there, the ones already written go
+    // out as a text record of their own that overwrites them when loaded; after ORG moved
+    // back the open record can start below the bytes without holding them
+    text_record patch;
+    patch.length = 0;
+    for(unsigned int i = 0; i <= bytes.length(); i++) {
+        int offset = address + i - t_record.start_address;
+        bool open = i < bytes.length() && offset >= 0 && offset < t_record.length;
+        if(i < bytes.length() && !open) {
+            if(patch.length == 0) this->start_text_record(patch, address + i);
+            patch.object_codes += bytes[i];
+            patch.length++;
+            continue;
+        }
+        if(patch.length > 0) this->write_text_record(patch, this->output_object);
+        patch.length = 0;
+        if(open) t_record.object_codes[offset] = bytes[i];
+    }
+}
+
+void SICXEAssembler::write_one_pass_header(const instruction &line) {
+    // the length is not known before END, the field is filled in then if the stream allows
+    string header = this->header_record(line);
+    size_t position;
+    if(this->output_object->tell(position)) this->length_field = position + header.length() - 7;
+    this->output_object->write(header);
+}
+
+void SICXEAssembler::write_m_records(const text_record &t_record, bool all) {
+    // an M record goes out once the text record with its field is written, so a loader that
+    // applies M records as it reads them finds the field there; 'all' once the last one is
+    string records;
+    unsigned int kept = 0;
+    for(unsigned int i = 0; i < this->m_records.size(); i++) {
+        const modification_record &m = this->m_records[i];
+        if(all || m.address + (m.length + 1) / 2 <= t_record.start_address) {
+            records += "M" + sep() + hex_field(m.address, 6) + sep() + hex_field(m.length, 2) + '\n';
+        } else {
+            this->m_records[kept++] = m;
+        }
+    }
+    if(records.empty()) return;
+    Stats::count(Stats::M_RECORDS, this->m_records.size() - kept);
+    this->m_records.resize(kept);
+    this->output_object->write(records);
+}
+
+bool SICXEAssembler::finish_one_pass(bool result) {
+    // references that never found their symbol
+    for(unordered_map<int, vector<fixup> >::const_iterator it = this->fixups.begin(); result && it != this->fixups.end(); it++) {
+        if(it->second.empty() || it->second[0].extended || it->second[0].base_symbol == it->first) this->error_flag |= 64 | 4;
+        else this->error_flag |= 64 | 8;
+        result = false;
+    }
+
+    if(result) {
+        this->output_object->write("E" + sep() + hex_field(this->start_address, 6) + '\n');
+        if(this->length_field != string::npos) this->output_object->rewrite(this->length_field, hex_field(this->program_length, 6));
+    }
+    this->fixups.clear();
+    this->m_records.clear();
+    this->output_object->flush();
+    return result;
+}
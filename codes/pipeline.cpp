@@ -0,0 +1,69 @@
+#include "assembler.hpp"
+
+// pipelined mode: a reader thread splits the source, which pass 1 has in memory, into tokenized
+// lines ahead of pass 1, and during pass 2 a writer thread turns the encoded lines into text
+// records and listing lines, so the assembling thread only runs process_instruction and
+// toObjCode; the two passes still run one after the other, each overlapped with the stage next to it
+
+bool SICXEAssembler::read_pipelined() {
+    SpscRing<source_line> lines(this->pipeline_depth);
+    thread reader([this, &lines] {
+        source_line line;
+        while(this->read_source_line(line) && lines.push(line));
+        lines.close();
+    });
+
+    bool result = this->read_program(&lines);
+    // pass 1 stops at END, anything the reader still has is dropped
+    lines.cancel();
+    reader.join();
+    return result;
+}
+
+bool SICXEAssembler::encode_pipelined(unsigned int begin, unsigned int end, text_record &t_record, ObjectProgram &binary) {
+    SpscRing<encoded_line> lines(this->pipeline_depth);
+    pass2_chunk chunk;
+    object_code code;
+    encoded_line encoded;
+    thread writer([this, &lines, &t_record, &binary] { this->write_pipelined(lines, t_record, binary); });
+
+    chunk.base = -1;
+    chunk.error_flag = 0;
+    for(unsigned int i = begin; i < end; i++) {
+        chunk.bytes.clear();
+        this->encode_object(this->program[i], chunk, code);
+        // the failing line is still written, like the merge of encode_program does
+        encoded.index = i;
+        swap(encoded.bytes, chunk.bytes);
+        lines.push(encoded);
+        if(chunk.error_flag) break;
+    }
+    lines.close();
+    writer.join();
+
+    this->m_records.insert(this->m_records.end(), chunk.m_records.begin(), chunk.m_records.end());
+    if(chunk.error_flag) {
+        this->error_flag = chunk.error_flag;
+        return false;
+    }
+    return true;
+}
+
+void SICXEAssembler::write_pipelined(SpscRing<encoded_line> &lines, text_record &t_record, ObjectProgram &binary) const {
+    // the only user of the object, listing and binary output until pass 2 joins it
+    encoded_line encoded;
+    string hex;
+    Stats::Timer timer(Stats::TEXT_RECORDS);
+    while(lines.pop(encoded)) {
+        const instruction &line = this->program[encoded.index];
+        if(this->output_listing != nullptr) {
+            hex.resize(encoded.bytes.length() * 2);
+            hex_encode((const unsigned char*)encoded.bytes.data(), encoded.bytes.length(), &hex[0]);
+            this->write_listing_line(line, hex);
+        }
+        if(!line.comment && line.opcode != "BASE" && line.opcode != "NOBASE") {
+            this->process_text_record(t_record, line.address, encoded.bytes, this->output_object);
+            if(this->binary_output()) binary.addCode(line.address, encoded.bytes);
+        }
+    }
+}
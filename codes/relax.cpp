@@ -0,0 +1,212 @@
+#include "assembler.hpp"
+#include<algorithm>
+#include<climits>
+
+// relaxation: instructions that have both formats start as format 3, and the ones whose
+// operand is out of reach of a displacement are widened to format 4, round after round until
+// the rest fit; a widened line moves the lines after it by a byte, which only makes the
+// displacements across it longer, so a line never has to be narrowed again
+//
+// a round only looks again at the lines whose span, from the line to its target and to its
+// BASE symbol and to the lines of the labels their EQU values use, holds a line the round
+// before widened
+
+// a Fenwick tree of the widened lines, one element more than the program has lines
+static void add_widened(vector<int> &tree, unsigned int index) {
+    for(index++; index < tree.size(); index += index & -index) tree[index]++;
+}
+
+// lines widened before 'index', the bytes it moved by
+static int widened_before(const vector<int> &tree, unsigned int index) {
+    int count = 0;
+    for(; index > 0; index -= index & -index) count += tree[index];
+    return count;
+}
+
+int SICXEAssembler::relax_value(int symbol, const relax_state &state) const {
+    int line = state.defined_at[symbol];
+    if(line >= 0) return this->symbol_table.getValue(symbol) + widened_before(state.widened, line);
+    if(state.equate[symbol]) return state.equated[symbol];
+    return this->symbol_table.getValue(symbol);
+}
+
+void SICXEAssembler::relax_equates(relax_state &state) const {
+    // in the order they were defined, so the EQU symbols a value uses are evaluated before it
+    Expression::value result;
+    auto lookup = [this, &state](int symbol, Expression::value &v) {
+        v.number = this->relax_value(symbol, state);
+        v.relative = this->symbol_table.isAbsolute(symbol) ? 0 : 1;
+        return true;
+    };
+    for(unsigned int i = 0; i < this->equate_order.size(); i++) {
+        const equate &e = this->equates.at(this->equate_order[i]);
+        int location = e.location + widened_before(state.widened, e.line);
+        if(this->expressions[e.expression].evaluate(location, lookup, result)) state.equated[this->equate_order[i]] = result.number;
+    }
+}
+
+bool SICXEAssembler::relax_fits(const relax_candidate &c, const relax_state &state) const {
+    // the same choice as getDisplacement(), with the addresses the widened lines moved to
+    Expression::value target;
+    int address = this->program[c.line].address + widened_before(state.widened, c.line);
+    if(c.expression >= 0) {
+        auto lookup = [this, &state](int symbol, Expression::value &v) {
+            v.number = this->relax_value(symbol, state);
+            v.relative = this->symbol_table.isAbsolute(symbol) ? 0 : 1;
+            return true;
+        };
+        if(!this->expressions[c.expression].evaluate(address, lookup, target)) return false;
+    } else {
+        target.number = this->relax_value(c.symbol, state);
+        target.relative = this->symbol_table.isAbsolute(c.symbol) ? 0 : 1;
+    }
+
+    if(target.relative == 0) return target.number >= 0 && target.number <= 4095;
+    int pc = address + 3;
+    if(target.number - pc >= -2048 && target.number - pc <= 2047) return true;
+    if(c.base < 0) return false;
+    int base = this->relax_value(c.base, state);
+    return target.number - base >= 0 && target.number - base <= 4095;
+}
+
+void SICXEAssembler::relax_program() {
+    // called at the end of pass 1 without errors, every symbol but the external ones is defined
+    unsigned int i, k;
+    int base = -1;
+    bool extended;
+    relax_state state;
+    vector<relax_candidate> candidates;
+    vector<char> wide(this->program.size(), false);
+    vector<unsigned int> work, fresh;
+    vector<int> uses;
+    Stats::Timer timer(Stats::RELAX);
+
+    state.widened.assign(this->program.size() + 1, 0);
+    state.defined_at.assign(this->symbol_table.size(), -1);
+    state.equate.assign(this->symbol_table.size(), false);
+    state.equated.assign(this->symbol_table.size(), 0);
+    for(i = 0; i < this->program.size(); i++) {
+        const instruction &line = this->program[i];
+        if(!line.comment && line.opcode == "ORG") return;
+        if(line.comment || line.label == "" || line.opcode == "EQU") continue;
+        // a pool line is labeled '*', its symbol is the literal
+        int id = line.label == "*" ? line.symbol : this->symbol_table.find(line.label);
+        if(id >= 0 && this->symbol_table.isDefined(id) && this->symbol_table.getValue(id) == line.address) state.defined_at[id] = i;
+    }
+
+    // the lines every symbol's value depends on, EQU symbols take them from the symbols they use
+    vector<int> low(this->symbol_table.size(), INT_MAX), high(this->symbol_table.size(), -1);
+    for(i = 0; i < state.defined_at.size(); i++) {
+        if(state.defined_at[i] >= 0) low[i] = high[i] = state.defined_at[i];
+    }
+    for(i = 0; i < this->equate_order.size(); i++) {
+        int id = this->equate_order[i];
+        const equate &e = this->equates.at(id);
+        state.equate[id] = true;
+        state.equated[id] = this->symbol_table.getValue(id);
+        if(this->expressions[e.expression].usesLocation()) low[id] = high[id] = e.line;
+        uses.clear();
+        this->expressions[e.expression].getSymbols(uses);
+        for(k = 0; k < uses.size(); k++) {
+            low[id] = min(low[id], low[uses[k]]);
+            high[id] = max(high[id], high[uses[k]]);
+        }
+    }
+
+    for(i = 0; i < this->program.size(); i++) {
+        const instruction &line = this->program[i];
+        if(line.comment) continue;
+        if(line.opcode == "BASE") {
+            base = this->symbol_table.isDefined(line.symbol) ? line.symbol : -1;
+            continue;
+        }
+        if(line.opcode == "NOBASE") base = -1;
+        if(line.operand == "") continue;
+        const mnemonic *entry = MnemonicTable::find(line.opcode, extended);
+        if(entry == nullptr || entry->directive != mnemonic::INSTRUCTION || extended || !(entry->formats & mnemonic::FORMAT_4)) continue;
+
+        Expression::value target;
+        if(line.symbol < 0 && line.expression < 0) { // a number, format 3 has 12 bits of it
+            string operand = line.operand;
+            if(operand.length() >= 2 && isIndexed(operand)) operand = operand.substr(0, operand.length() - 2);
+            else if(isImmediate(operand) || isIndirect(operand)) operand = operand.substr(1);
+            int value = _stoi(operand);
+            if(value < 0 || value > 4095) wide[i] = true;
+        } else if(!this->operand_value(line.symbol, line.expression, line.address, target)) {
+            // undefined symbols are left to pass 2
+        } else if(!target.externals.empty()) { // only format 4 has an M record for them
+            wide[i] = true;
+        } else {
+            relax_candidate c;
+            c.line = i;
+            c.symbol = line.symbol;
+            c.expression = line.expression;
+            c.base = base;
+            c.low = c.high = i;
+            uses.clear();
+            if(line.expression >= 0) this->expressions[line.expression].getSymbols(uses);
+            else uses.push_back(line.symbol);
+            if(base >= 0) uses.push_back(base);
+            for(k = 0; k < uses.size(); k++) {
+                c.low = min(c.low, (unsigned int)min(low[uses[k]], (int)i));
+                c.high = max(c.high, (unsigned int)max(high[uses[k]], (int)i));
+            }
+            c.widened = false;
+            candidates.push_back(c);
+        }
+        if(wide[i]) add_widened(state.widened, i);
+    }
+
+    // the first round looks at every candidate
+    if(!this->equate_order.empty()) this->relax_equates(state);
+    for(k = 0; k < candidates.size(); k++) work.push_back(k);
+    while(!work.empty()) {
+        fresh.clear();
+        for(k = 0; k < work.size(); k++) {
+            relax_candidate &c = candidates[work[k]];
+            if(this->relax_fits(c, state)) continue;
+            c.widened = true;
+            fresh.push_back(c.line);
+        }
+        // lines are widened once the round is over, a line that failed fails after it too
+        for(k = 0; k < fresh.size(); k++) {
+            wide[fresh[k]] = true;
+            add_widened(state.widened, fresh[k]);
+        }
+        work.clear();
+        if(fresh.empty()) break;
+        if(!this->equate_order.empty()) this->relax_equates(state);
+        for(k = 0; k < candidates.size(); k++) {
+            const relax_candidate &c = candidates[k];
+            if(c.widened) continue;
+            vector<unsigned int>::iterator crossing = lower_bound(fresh.begin(), fresh.end(), c.low);
+            if(crossing != fresh.end() && *crossing < c.high) work.push_back(k);
+        }
+    }
+
+    // move the lines and their labels by the lines widened before them, then the EQU symbols
+    int shift = 0;
+    for(i = 0; i < this->program.size(); i++) {
+        instruction &line = this->program[i];
+        if(line.comment) continue;
+        line.address += shift;
+        if(!wide[i]) continue;
+        line.opcode = "+" + line.opcode;
+        line.length = 4;
+        shift++;
+    }
+    for(i = 0; i < state.defined_at.size(); i++) {
+        if(state.defined_at[i] >= 0) this->symbol_table.define(i, this->program[state.defined_at[i]].address);
+    }
+    Expression::value result;
+    for(i = 0; i < this->equate_order.size(); i++) {
+        equate &e = this->equates.at(this->equate_order[i]);
+        e.location = this->program[e.line].address;
+        if(this->expressions[e.expression].evaluate(e.location, this->symbol_table, result)) {
+            this->symbol_table.define(this->equate_order[i], result.number, result.relative == 0);
+        }
+    }
+    this->program_length += shift;
+    this->relaxed_lines = shift;
+    Stats::count(Stats::RELAXED, shift);
+}
@@ -0,0 +1,167 @@
+#include "assembler.hpp"
+
+// control sections: one scan of the source finds the CSECT lines, and every section is then
+// assembled by an assembler of its own, with its own symbol table and records, on the thread
+// pool if there is one; the objects and listings of the sections are joined in source order
+
+// 'text' holds 'word' in any case, 'word' is upper case
+static bool contains(string_view text, string_view word) {
+    for(size_t i = 0; i + word.length() <= text.length(); i++) {
+        size_t j = 0;
+        while(j < word.length() && MnemonicHash::fold(text[i + j]) == word[j]) j++;
+        if(j == word.length()) return true;
+    }
+    return false;
+}
+
+vector<string_view> SICXEAssembler::find_sections(string_view source, vector<size_t> &macro_ends) {
+    // a section starts at a CSECT line that follows a line of code; 'macro_ends' gets, for every
+    // section, the end of the last MEND line before it; only lines naming CSECT are split
+    vector<string_view> slices;
+    size_t begin = 0, position = 0, mend = 0;
+    bool code = false;
+    source_tokens tokens;
+
+    macro_ends.assign(1, 0);
+    if(!contains(source, "CSECT")) return slices;
+    bool macros = contains(source, "MEND");
+    while(position < source.length()) {
+        size_t end = source.find('\n', position);
+        if(end == string_view::npos) end = source.length();
+        string_view line = source.substr(position, end - position);
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if(!input_is_comment(line)) {
+            if(code && contains(line, "CSECT") && tokenize_line(line, tokens) && tokens.entry != nullptr && tokens.entry->directive == mnemonic::CSECT) {
+                // without its last newline, which would read as one more empty line
+                slices.push_back(source.substr(begin, position - 1 - begin));
+                macro_ends.push_back(mend);
+                begin = position;
+            } else if(macros && contains(line, "MEND")) {
+                mend = min(end + 1, source.length());
+            }
+            code = true;
+        }
+        position = end + 1;
+    }
+    slices.push_back(source.substr(begin));
+    return slices;
+}
+
+void SICXEAssembler::run_sections(const function<bool(SICXEAssembler&)> &step) {
+    TaskGroup group;
+    for(unsigned int i = 0; i < this->sections.size(); i++) {
+        control_section *section = this->sections[i].get();
+        if(this->pool == nullptr) section->result = step(*section->assembler);
+        else this->pool->submit(group, [section, &step] { section->result = step(*section->assembler); });
+    }
+    if(this->pool != nullptr) this->pool->wait(group);
+}
+
+bool SICXEAssembler::read_sections(const vector<string_view> &slices, const vector<size_t> &macro_ends, string_view source) {
+    // sections share nothing in pass 1 but the macros defined before them
+    unsigned int i, j, line_count = 0;
+
+    this->program.clear();
+    this->symbol_table.clear();
+    this->start_address = 0;
+    this->program_length = 0;
+    this->error_flag = 0;
+    this->incremental_ready = false;
+    this->generated_lines = false;
+    this->control_sections = true;
+    for(i = 0; i < slices.size(); i++) {
+        unique_ptr<control_section> section(new control_section());
+        section->input = MemoryInputStream(slices[i]);
+        section->assembler.reset(new SICXEAssembler(&section->input, &section->object, this->intermediate, this->output_listing != nullptr ? &section->listing : nullptr));
+        section->assembler->section_continues = i + 1 < slices.size();
+        section->assembler->macro_source = source.substr(0, macro_ends[i]);
+        section->assembler->relaxing = this->relaxing;
+        section->assembler->text_record_size = this->text_record_size;
+        this->sections.push_back(move(section));
+    }
+    this->run_sections([](SICXEAssembler &section) { return section.read_program(); });
+
+    for(i = 0; i < this->sections.size(); i++) {
+        SICXEAssembler &section = *this->sections[i]->assembler;
+        if(!this->sections[i]->result) {
+            this->error_flag = section.error_flag;
+            return false;
+        }
+        // every section is one of several, its records say so; listing line numbers run on
+        section.control_sections = true;
+        for(j = 0; j < section.program.size(); j++) section.program[j].line_number += line_count;
+        line_count += section.program.size();
+        if(i == 0) this->start_address = section.start_address;
+        this->program_length += section.program_length;
+        // sections after END are not part of the program
+        if(section.program.back().opcode == "END") {
+            this->sections.resize(i + 1);
+            break;
+        }
+    }
+    return true;
+}
+
+bool SICXEAssembler::encode_sections() {
+    for(unsigned int i = 0; i < this->sections.size(); i++) {
+        this->sections[i]->object.clear();
+        this->sections[i]->listing.clear();
+    }
+    this->run_sections([](SICXEAssembler &section) { return section.pass2(); });
+
+    // outputs go out in source order, up to the first section that failed
+    this->error_flag = 0;
+    for(unsigned int i = 0; i < this->sections.size(); i++) {
+        control_section &section = *this->sections[i];
+        this->output_object->write(section.object.getString());
+        if(this->output_listing != nullptr) this->output_listing->write(section.listing.getString());
+        if(!section.result) {
+            this->error_flag = section.assembler->error_flag;
+            return false;
+        }
+    }
+    return true;
+}
+
+void SICXEAssembler::external_symbols(const instruction &line) {
+    // EXTREF names become external here, EXTDEF names are looked up when the D record is written
+    vector<string> names = split(line.operand, ",");
+    for(unsigned int i = 0; i < names.size(); i++) {
+        if(names[i] == "") { // invalid operand
+            this->error_flag |= 8;
+            return;
+        }
+        if(line.opcode != "EXTREF") continue;
+        int id = this->symbol_table.intern(names[i]);
+        if(this->symbol_table.isDefined(id)) this->error_flag |= 4; // duplicate symbol
+        else this->symbol_table.makeExternal(id);
+    }
+}
+
+bool SICXEAssembler::write_link_records(unsigned int first) {
+    // the D records and then the R records, one for every EXTDEF or EXTREF line; every name
+    // ends with a tab like the one of the H record
+    string d_records, r_records;
+    for(unsigned int i = first; i < this->program.size(); i++) {
+        const instruction &line = this->program[i];
+        if(line.comment || (line.opcode != "EXTDEF" && line.opcode != "EXTREF")) continue;
+
+        bool define = line.opcode == "EXTDEF";
+        string &records = define ? d_records : r_records;
+        vector<string> names = split(line.operand, ",");
+        records += define ? "D" : "R";
+        for(unsigned int j = 0; j < names.size(); j++) {
+            records += sep() + names[j] + '\t';
+            if(!define) continue;
+            int id = this->symbol_table.find(names[j]);
+            if(!this->symbol_table.isDefined(id)) { // undefined symbol
+                this->error_flag |= 64 | 4;
+                return false;
+            }
+            records += sep() + hex_field(this->symbol_table.getValue(id), 6);
+        }
+        records += '\n';
+    }
+    this->output_object->write_batch({d_records, r_records});
+    return true;
+}
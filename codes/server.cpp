@@ -0,0 +1,218 @@
+#include "server.hpp"
+#include<cstring>
+#ifndef _WIN32
+#include<sys/socket.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#include<cerrno>
+#endif
+
+// a request larger than this is taken for garbage
+static const unsigned int max_request = 1u << 30;
+
+AssemblerServer::AssemblerServer(unsigned int instances) {
+    this->listener = -1;
+    this->stopping = false;
+    this->requests = 0;
+    for(unsigned int i = 0; i < max(instances, 1u); i++) {
+        this->instances.push_back(unique_ptr<instance>(new instance()));
+        this->idle.push_back(this->instances.back().get());
+    }
+}
+
+bool AssemblerServer::listen(string socket_path) {
+#ifndef _WIN32
+    sockaddr_un address;
+    if(!socket_address(socket_path, address)) return false;
+    // only a socket is replaced, a file of any other kind at that path stays where it is
+    struct stat info;
+    if(lstat(socket_path.c_str(), &info) == 0) {
+        if(!S_ISSOCK(info.st_mode)) return false;
+        unlink(socket_path.c_str());
+    }
+    this->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(this->listener < 0) return false;
+    if(bind(this->listener, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(this->listener, 128) != 0) {
+        ::close(this->listener);
+        this->listener = -1;
+        return false;
+    }
+    this->socket_path = socket_path;
+    return true;
+#else
+    // no Unix domain sockets here
+    return false;
+#endif
+}
+
+void AssemblerServer::run() {
+#ifndef _WIN32
+    while(!this->stopping) {
+        int socket = accept(this->listener, nullptr, nullptr);
+        if(socket < 0) {
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        this->join_connections(false);
+        lock_guard<mutex> guard(this->lock);
+        if(this->stopping) {
+            ::close(socket);
+            break;
+        }
+        this->connections.push_back(connection{socket, thread(), false});
+        connection *c = &this->connections.back();
+        c->handler = thread([this, c] { this->serve(c); });
+    }
+
+    this->stop();
+    this->join_connections(true);
+    ::close(this->listener);
+    this->listener = -1;
+    unlink(this->socket_path.c_str());
+#endif
+}
+
+void AssemblerServer::join_connections(bool all) {
+    // threads are joined without the lock, they take it once more on their way out
+    list<connection> ended;
+    {
+        lock_guard<mutex> guard(this->lock);
+        for(list<connection>::iterator i = this->connections.begin(); i != this->connections.end();) {
+            list<connection>::iterator next = i;
+            next++;
+            if(all || i->done) ended.splice(ended.end(), this->connections, i);
+            i = next;
+        }
+    }
+    for(list<connection>::iterator i = ended.begin(); i != ended.end(); i++) i->handler.join();
+}
+
+void AssemblerServer::stop() {
+#ifndef _WIN32
+    // wakes accept() and every connection waiting for a request
+    lock_guard<mutex> guard(this->lock);
+    this->stopping = true;
+    if(this->listener >= 0) shutdown(this->listener, SHUT_RDWR);
+    for(list<connection>::iterator i = this->connections.begin(); i != this->connections.end(); i++) {
+        if(!i->done) shutdown(i->socket, SHUT_RDWR);
+    }
+#endif
+}
+
+void AssemblerServer::serve(connection *c) {
+    server_request request;
+    server_response response;
+    string source, output;
+    while(read_all(c->socket, &request, sizeof(request))) {
+        if(memcmp(request.magic, request_magic, 4) != 0 || request.source_length > max_request || request.output_length > max_request) break;
+        try {
+            source.resize(request.source_length);
+            output.resize(request.output_length);
+        } catch(exception &e) { // no memory for the request, the connection cannot go on
+            break;
+        }
+        if(!read_all(c->socket, &source[0], source.length()) || !read_all(c->socket, &output[0], output.length())) break;
+
+        // the outputs are sent from the instance's streams, it goes back once they are
+        instance &i = this->acquire();
+        try {
+            this->assemble(i, request, source, output, response);
+        } catch(exception &e) {
+            // the request fails alone, pass 1 of the next one clears what the instance was left with
+            memcpy(response.magic, response_magic, 4);
+            response.success = 0;
+            response.error_flag = -1;
+            response.object_length = response.listing_length = response.binary_length = 0;
+        }
+        bool sent = write_all(c->socket, &response, sizeof(response));
+        if(sent && response.object_length > 0) sent = write_all(c->socket, i.object.getString().data(), response.object_length);
+        if(sent && response.listing_length > 0) sent = write_all(c->socket, i.listing.getString().data(), response.listing_length);
+        if(sent && response.binary_length > 0) sent = write_all(c->socket, i.binary.getString().data(), response.binary_length);
+        this->release(i);
+        this->requests++;
+        if(request.flags & REQUEST_STOP) this->stop();
+        if(!sent || this->stopping) break;
+    }
+
+#ifndef _WIN32
+    lock_guard<mutex> guard(this->lock);
+    ::close(c->socket);
+    c->done = true;
+#endif
+}
+
+AssemblerServer::instance& AssemblerServer::acquire() {
+    unique_lock<mutex> guard(this->lock);
+    this->returned.wait(guard, [this] { return !this->idle.empty(); });
+    instance *i = this->idle.back();
+    this->idle.pop_back();
+    return *i;
+}
+
+void AssemblerServer::release(instance &i) {
+    lock_guard<mutex> guard(this->lock);
+    this->idle.push_back(&i);
+    this->returned.notify_one();
+}
+
+void AssemblerServer::assemble(instance &i, const server_request &request, const string &source, const string &output, server_response &response) {
+    // the instance's assembler is pointed at this job's streams; pass 1 clears whatever the last job left
+    unique_ptr<FileInputStream> file;
+    if(request.flags & REQUEST_SOURCE_PATH) {
+        file.reset(new FileInputStream(source));
+        i.input = MemoryInputStream(file->getContents());
+    } else {
+        i.input = MemoryInputStream(source);
+    }
+    i.object.clear();
+    i.listing.clear();
+    i.binary.clear();
+    i.assembler.setInputStream(&i.input);
+    i.assembler.setOutputListingStream(request.flags & REQUEST_LISTING ? &i.listing : nullptr);
+    i.assembler.setOutputBinaryStream(request.flags & REQUEST_BINARY ? &i.binary : nullptr, false);
+
+    memcpy(response.magic, response_magic, 4);
+    response.success = i.assembler.assemble();
+    response.error_flag = i.assembler.getErrorFlag();
+    response.object_length = i.object.getString().length();
+    response.listing_length = i.listing.getString().length();
+    response.binary_length = i.binary.getString().length();
+
+    if(request.flags & REQUEST_WRITE_FILES) {
+        // like the command line, a failed program still leaves what was written
+        FileOutputStream object_file(output + ".obj");
+        object_file.write(i.object.getString());
+        bool written = object_file.good();
+        if(request.flags & REQUEST_LISTING) {
+            FileOutputStream listing_file(output + ".lst");
+            listing_file.write(i.listing.getString());
+            written = listing_file.good() && written;
+        }
+        if(request.flags & REQUEST_BINARY) {
+            FileOutputStream binary_file(output + ".bin", true);
+            binary_file.write(i.binary.getString());
+            written = binary_file.good() && written;
+        }
+        // nothing comes back, so the client has to hear that the files are not there
+        if(!written) {
+            response.success = false;
+            response.error_flag |= response_write_failed;
+        }
+        response.object_length = response.listing_length = response.binary_length = 0;
+    }
+}
+
+unsigned long long AssemblerServer::getRequestCount() {
+    return this->requests;
+}
+
+AssemblerServer::~AssemblerServer() {
+#ifndef _WIN32
+    this->stop();
+    this->join_connections(true);
+    if(this->listener >= 0) {
+        ::close(this->listener);
+        unlink(this->socket_path.c_str());
+    }
+#endif
+}
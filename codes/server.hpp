@@ -0,0 +1,65 @@
+#pragma once
+#include<assembler.hpp>
+#include<client.hpp>
+#include<stream.hpp>
+#include<atomic>
+#include<condition_variable>
+#include<list>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+using namespace std;
+
+// serves assemble requests on a Unix domain socket; every connection has a thread of its own
+// and borrows one of the assemblers made up front for each request, so a request pays for
+// neither a process nor a new assembler
+class AssemblerServer {
+    // a warm assembler; its tables keep their memory from one job to the next
+    struct instance {
+        MemoryInputStream input;
+        StringOutputStream object;
+        StringOutputStream listing;
+        StringOutputStream binary;
+        SICXEAssembler assembler;
+        instance(): assembler(&this->input, &this->object) { }
+    };
+
+    struct connection {
+        int socket;
+        thread handler;
+        bool done; // the socket is closed, the thread is about to end
+    };
+
+    private:
+        string socket_path;
+        int listener;
+        vector<unique_ptr<instance>> instances;
+        vector<instance*> idle;
+        list<connection> connections;
+        mutex lock;
+        condition_variable returned;
+        atomic<bool> stopping;
+        atomic<unsigned long long> requests;
+
+        void serve(connection *c);
+        instance& acquire();
+        void release(instance &i);
+        void assemble(instance &i, const server_request &request, const string &source, const string &output, server_response &response);
+        void join_connections(bool all);
+
+    public:
+        AssemblerServer(unsigned int instances = thread::hardware_concurrency());
+        AssemblerServer(const AssemblerServer &other) = delete;
+        AssemblerServer& operator=(const AssemblerServer &other) = delete;
+        // binds 'socket_path', replacing a socket left there; false if the socket cannot be made
+        // or something other than a socket is in the way
+        bool listen(string socket_path);
+        // accepts connections until stop() or a STOP request
+        void run();
+        void stop();
+        unsigned long long getRequestCount();
+        ~AssemblerServer();
+};
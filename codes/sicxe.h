@@ -0,0 +1,65 @@
+#pragma once
+#include<stddef.h>
+
+/* the assembler as a library: the source goes in as one buffer, the object program, listing
+ * and symbol table come back in buffers of the caller or of the assembler, no files and no
+ * processes; a C interface, so its layout stays the same whatever compiled the library */
+
+/* SICXE_BUILD while building the shared library, SICXE_DLL in programs that use it on Windows;
+ * neither where the sources are compiled into the program */
+#if defined(_WIN32) && defined(SICXE_BUILD)
+#define SICXE_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(SICXE_DLL)
+#define SICXE_API __declspec(dllimport)
+#elif defined(_WIN32)
+#define SICXE_API
+#else
+#define SICXE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped when a function or a struct of this header changes */
+#define SICXE_API_VERSION 1
+
+/* what sicxe_assemble() writes besides the object program, and how */
+#define SICXE_LISTING 1u
+#define SICXE_SYMBOLS 2u
+#define SICXE_RELAX 4u
+
+/* an assembler and the memory it keeps from one call to the next */
+typedef struct sicxe_assembler sicxe_assembler;
+
+typedef struct sicxe_output {
+    char *buffer; /* set by the caller: memory to copy the output to, NULL for none */
+    size_t capacity; /* set by the caller: bytes 'buffer' holds */
+    const char *data; /* the output, in 'buffer' if it fits, else in the assembler's memory until its next call */
+    size_t length; /* bytes of the output */
+} sicxe_output;
+
+typedef struct sicxe_result {
+    int success;
+    int error_flag; /* the command line's error flags, 64 and up for pass 2; -1 if the call failed,
+                     * out of memory most likely, and the outputs are empty */
+    sicxe_output object; /* text object program */
+    sicxe_output listing; /* with SICXE_LISTING */
+    sicxe_output symbols; /* with SICXE_SYMBOLS, a line per defined symbol: name, hex value, A or R;
+                           * the first control section's if there are several */
+} sicxe_result;
+
+/* SICXE_API_VERSION of the library, to check it against the header */
+SICXE_API int sicxe_version(void);
+/* NULL if there is no memory for it */
+SICXE_API sicxe_assembler* sicxe_create(void);
+SICXE_API void sicxe_destroy(sicxe_assembler *assembler);
+/* bytes a text record holds at most, 30 by default and up to 255 */
+SICXE_API void sicxe_set_record_size(sicxe_assembler *assembler, unsigned int size);
+/* assembles 'length' bytes of 'source', which needs no terminating zero; returns 'success'.
+ * one call at a time per assembler, assemblers of their own may run on any threads */
+SICXE_API int sicxe_assemble(sicxe_assembler *assembler, const char *source, size_t length, unsigned int flags, sicxe_result *result);
+
+#ifdef __cplusplus
+}
+#endif
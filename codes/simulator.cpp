@@ -0,0 +1,496 @@
+#include "simulator.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+
+// condition code bits of SW
+#define CC_MASK 0xC0
+#define CC_LESS 0x40
+#define CC_EQUAL 0x00
+#define CC_GREATER 0x80
+#define WORD_MASK 0xFFFFFF
+#define ADDRESS_MASK 0xFFFFF
+// handler 0 decodes, 1 - 64 run the opcode at (handler - 1) << 2, 65 stops at an invalid instruction
+#define INVALID_HANDLER 65
+
+// mnemonic of every opcode, indexed by opcode >> 2
+struct opcode_index {
+    const mnemonic *entries[64];
+    constexpr opcode_index(): entries() {
+        for(int i = 0; i < MnemonicHash::entry_count; i++) {
+            const mnemonic &entry = MnemonicHash::entries[i];
+            if(entry.directive == mnemonic::INSTRUCTION) entries[entry.opcode >> 2] = &entry;
+        }
+    }
+};
+
+static constexpr opcode_index opcodes;
+
+static inline int signed_word(unsigned int value) {
+    return (int)(value << 8) >> 8;
+}
+
+static inline unsigned int condition(int left, int right) {
+    return left < right ? CC_LESS : left > right ? CC_GREATER : CC_EQUAL;
+}
+
+FileDevice::FileDevice(string filename) {
+    this->filename = filename;
+    this->input = nullptr;
+    this->position = 0;
+    this->file = nullptr;
+    this->output = nullptr;
+}
+
+unsigned char FileDevice::read() {
+    if(this->input == nullptr) this->input = new FileInputStream(this->filename);
+    string_view contents = this->input->getContents();
+    return this->position < contents.length() ? contents[this->position++] : 0;
+}
+
+void FileDevice::write(unsigned char c) {
+    if(this->output == nullptr) this->output = new BufferedOutputStream(this->file = new FileOutputStream(this->filename));
+    this->output->write(string(1, (char)c));
+}
+
+FileDevice::~FileDevice() {
+    delete this->input;
+    delete this->output;
+    delete this->file;
+}
+
+Simulator::Simulator(): memory(memory_size + 8, 0) {
+    // 8 spare bytes let a word or a float at the last address be read without a check
+    this->scratch = decoded();
+    this->code_begin = 0;
+    this->decoded_begin = this->decoded_end = 0;
+    this->f = 0;
+    this->instructions = 0;
+    this->evicted_cycles = 0;
+    this->seconds = 0;
+    this->error_flag = 0;
+    for(int i = 0; i < 10; i++) this->registers[i] = 0;
+    for(int i = 0; i < 64; i++) this->evicted[i] = 0;
+    for(int i = 0; i < 256; i++) this->devices[i] = nullptr;
+}
+
+bool Simulator::load(ObjectLoader &loader, InputStream *object, int load_address) {
+    if(!loader.load(object, load_address)) return false;
+    this->start(loader);
+    return true;
+}
+
+bool Simulator::loadBinary(ObjectLoader &loader, string_view image, int load_address) {
+    if(!loader.loadBinary(image, load_address)) return false;
+    this->start(loader);
+    return true;
+}
+
+void Simulator::start(ObjectLoader &loader) {
+    this->code_begin = loader.getStartAddress();
+    this->cache.assign(loader.getProgramLength(), decoded());
+    this->decoded_begin = this->decoded_end = 0;
+    this->registers[PC] = loader.getEntryAddress();
+    // returning through the initial L ends the program
+    this->registers[L] = halt_address;
+}
+
+void Simulator::attach(unsigned char device, Device *d) {
+    this->devices[device] = d;
+}
+
+void Simulator::decode(unsigned int address, decoded &d) const {
+    // fills every field but 'executed'
+    const unsigned char *code = this->memory.data() + address;
+    const mnemonic *entry = opcodes.entries[code[0] >> 2];
+    unsigned char opcode = code[0] & 0xFC;
+    int accesses = 0;
+
+    d.handler = INVALID_HANDLER;
+    d.length = 1;
+    d.mode = SIMPLE;
+    d.cycles = 1;
+    d.r1 = d.r2 = 0;
+    d.x_mask = d.b_mask = 0;
+    d.address = 0;
+    d.next = (address + 1) & ADDRESS_MASK;
+    if(entry == nullptr) return;
+
+    if(entry->formats & mnemonic::FORMAT_1) {
+        if(code[0] & 3) return;
+    } else if(entry->formats & mnemonic::FORMAT_2) {
+        if(code[0] & 3) return;
+        d.length = 2;
+        d.r1 = code[1] >> 4;
+        d.r2 = code[1] & 15;
+        // SVC takes a number, SHIFTL and SHIFTR a count; only A, X, L, B, S and T take part in arithmetic
+        bool one = opcode == 0xB4 || opcode == 0xB8 || opcode == 0xA4 || opcode == 0xA8;
+        if(opcode != 0xB0 && (d.r1 > T || (!one && d.r2 > T))) return;
+    } else {
+        bool n = code[0] & 2, i = code[0] & 1, x = code[1] & 0x80, b = code[1] & 0x40, p = code[1] & 0x20, e = code[1] & 0x10;
+        d.length = 3;
+        d.x_mask = x ? ADDRESS_MASK : 0;
+        if(!n && !i) { // SIC format, 15 bit address
+            d.address = (code[1] & 0x7F) << 8 | code[2];
+        } else {
+            d.mode = n && i ? SIMPLE : i ? IMMEDIATE : INDIRECT;
+            if(e) {
+                if(b || p) return;
+                d.length = 4;
+                d.cycles++;
+                d.address = (code[1] & 0x0F) << 16 | code[2] << 8 | code[3];
+            } else if(p) {
+                if(b) return;
+                int disp = (code[1] & 0x0F) << 8 | code[2];
+                d.address = (address + 3 + (disp >= 2048 ? disp - 4096 : disp)) & ADDRESS_MASK;
+            } else {
+                d.address = (code[1] & 0x0F) << 8 | code[2];
+                d.b_mask = b ? ADDRESS_MASK : 0;
+            }
+        }
+
+        switch(opcode) {
+            case 0x3C: case 0x30: case 0x34: case 0x38: case 0x48: // jumps only read memory through @
+                accesses = d.mode == INDIRECT;
+                break;
+            case 0x4C: // RSUB
+                break;
+            case 0x0C: case 0x10: case 0x14: case 0x78: case 0x7C: case 0x84: case 0x54: case 0x80: case 0xE8:
+            case 0x58: case 0x5C: case 0x60: case 0x64: case 0x70: case 0x88: // stores and floats need an address
+                if(d.mode == IMMEDIATE) return;
+                accesses = d.mode == INDIRECT ? 2 : 1;
+                break;
+            default:
+                accesses = d.mode == IMMEDIATE ? 0 : d.mode == INDIRECT ? 2 : 1;
+                break;
+        }
+        d.cycles += accesses;
+    }
+
+    d.next = (address + d.length) & ADDRESS_MASK;
+    d.handler = (opcode >> 2) + 1;
+}
+
+void Simulator::evict(decoded &d) {
+    if(d.handler > 0 && d.handler < INVALID_HANDLER) {
+        this->evicted[d.handler - 1] += d.executed;
+        this->evicted_cycles += d.executed * d.cycles;
+    }
+    d.handler = 0;
+    d.executed = 0;
+}
+
+void Simulator::invalidate(unsigned int address, unsigned int length) {
+    // an instruction starting up to 3 bytes before a written byte may contain it
+    unsigned int first = max(address, this->code_begin + 3) - 3, last = min(address + length, this->code_begin + (unsigned int)this->cache.size());
+    for(unsigned int i = first; i < last; i++) {
+        decoded &d = this->cache[i - this->code_begin];
+        if(d.handler != 0 && i + d.length > address) this->evict(d);
+    }
+}
+
+unsigned int Simulator::load_word(unsigned int address) const {
+    const unsigned char *m = this->memory.data() + address;
+    return m[0] << 16 | m[1] << 8 | m[2];
+}
+
+void Simulator::store_word(unsigned int address, unsigned int value) {
+    unsigned char *m = this->memory.data() + address;
+    m[0] = value >> 16;
+    m[1] = value >> 8;
+    m[2] = value;
+    if(address + 3 > this->decoded_begin && address < this->decoded_end) this->invalidate(address, 3);
+}
+
+void Simulator::store_byte(unsigned int address, unsigned char value) {
+    this->memory[address] = value;
+    if(address + 1 > this->decoded_begin && address < this->decoded_end) this->invalidate(address, 1);
+}
+
+bool Simulator::run(unsigned long long limit) {
+    static const void* const handlers[66] = {
+        &&decode,
+        &&lda, &&ldx, &&ldl, &&sta, &&stx, &&stl, &&add, &&sub, // 0x00 - 0x1C
+        &&mul, &&div, &&comp, &&tix, &&jeq, &&jgt, &&jlt, &&j, // 0x20 - 0x3C
+        &&and_, &&or_, &&jsub, &&rsub, &&ldch, &&stch, &&addf, &&subf, // 0x40 - 0x5C
+        &&mulf, &&divf, &&ldb, &&lds, &&ldf, &&ldt, &&stb, &&sts, // 0x60 - 0x7C
+        &&stf, &&stt, &&compf, &&invalid, &&addr, &&subr, &&mulr, &&divr, // 0x80 - 0x9C
+        &&compr, &&shiftl, &&shiftr, &&rmo, &&svc, &&clear, &&tixr, &&invalid, // 0xA0 - 0xBC
+        &&float_, &&fix, &&nop, &&invalid, &&nop, &&nop, &&rd, &&wd, // 0xC0 - 0xDC, LPS and STI do nothing
+        &&td, &&invalid, &&stsw, &&nop, &&nop, &&nop, &&nop, &&invalid, // 0xE0 - 0xFC, SSK and the I/O channels do nothing
+        &&invalid
+    };
+    unsigned int r[10], pc, target, value;
+    unsigned char *m = this->memory.data();
+    decoded *cache = this->cache.data(), *d;
+    unsigned int code_begin = this->code_begin, cache_size = this->cache.size();
+    unsigned long long count = 0, last = limit > 0 ? limit : ~0ULL;
+    double f = this->f;
+    Device *device;
+    auto start = chrono::steady_clock::now();
+
+    // registers live in a local array, stores to memory cannot alias them
+    for(int i = 0; i < 10; i++) r[i] = this->registers[i];
+    pc = r[PC] & ADDRESS_MASK;
+    this->error_flag = 0;
+
+    #define DISPATCH() do { \
+        if(count == last) goto limit_reached; \
+        count++; \
+        if(pc - code_begin < cache_size) d = cache + (pc - code_begin); \
+        else { this->evict(this->scratch); d = &this->scratch; } \
+        d->executed++; \
+        goto *handlers[d->handler]; \
+    } while(0)
+    #define NEXT() do { pc = d->next; DISPATCH(); } while(0)
+    #define TARGET() ((d->address + (r[X] & d->x_mask) + (r[B] & d->b_mask)) & ADDRESS_MASK)
+    // the address an operand is read from or written to
+    #define EFFECTIVE() (d->mode == INDIRECT ? this->load_word(TARGET()) & ADDRESS_MASK : TARGET())
+    #define WORD_OPERAND() (d->mode == IMMEDIATE ? TARGET() : this->load_word(EFFECTIVE()))
+    #define BYTE_OPERAND() (d->mode == IMMEDIATE ? TARGET() & 0xFF : m[EFFECTIVE()])
+    #define FLOAT_OPERAND() fromFloat48((unsigned long long)this->load_word(EFFECTIVE()) << 24 | this->load_word(EFFECTIVE() + 3))
+    #define JUMP(to) do { \
+        target = (to); \
+        if(target == halt_address) goto halted; \
+        pc = target & ADDRESS_MASK; \
+        DISPATCH(); \
+    } while(0)
+
+    DISPATCH();
+
+decode:
+    this->decode(pc, *d);
+    if(d != &this->scratch) {
+        if(this->decoded_end == 0) this->decoded_begin = pc;
+        this->decoded_begin = min(this->decoded_begin, pc);
+        this->decoded_end = max(this->decoded_end, pc + d->length);
+    }
+    goto *handlers[d->handler];
+
+lda: r[A] = WORD_OPERAND(); NEXT();
+ldx: r[X] = WORD_OPERAND(); NEXT();
+ldl: r[L] = WORD_OPERAND(); NEXT();
+ldb: r[B] = WORD_OPERAND(); NEXT();
+lds: r[S] = WORD_OPERAND(); NEXT();
+ldt: r[T] = WORD_OPERAND(); NEXT();
+ldch: r[A] = (r[A] & 0xFFFF00) | BYTE_OPERAND(); NEXT();
+ldf: f = FLOAT_OPERAND(); NEXT();
+sta: this->store_word(EFFECTIVE(), r[A]); NEXT();
+stx: this->store_word(EFFECTIVE(), r[X]); NEXT();
+stl: this->store_word(EFFECTIVE(), r[L]); NEXT();
+stb: this->store_word(EFFECTIVE(), r[B]); NEXT();
+sts: this->store_word(EFFECTIVE(), r[S]); NEXT();
+stt: this->store_word(EFFECTIVE(), r[T]); NEXT();
+stsw: this->store_word(EFFECTIVE(), r[SW]); NEXT();
+stch: this->store_byte(EFFECTIVE(), r[A] & 0xFF); NEXT();
+stf: {
+    unsigned long long bits = toFloat48(f);
+    target = EFFECTIVE();
+    this->store_word(target, bits >> 24);
+    this->store_word(target + 3, bits & WORD_MASK);
+    NEXT();
+}
+add: r[A] = (r[A] + WORD_OPERAND()) & WORD_MASK; NEXT();
+sub: r[A] = (r[A] - WORD_OPERAND()) & WORD_MASK; NEXT();
+mul: r[A] = (unsigned int)((long long)signed_word(r[A]) * signed_word(WORD_OPERAND())) & WORD_MASK; NEXT();
+div:
+    value = WORD_OPERAND();
+    if(value == 0) goto division_by_zero;
+    r[A] = (unsigned int)(signed_word(r[A]) / signed_word(value)) & WORD_MASK;
+    NEXT();
+and_: r[A] &= WORD_OPERAND(); NEXT();
+or_: r[A] |= WORD_OPERAND(); NEXT();
+comp: r[SW] = (r[SW] & ~CC_MASK) | condition(signed_word(r[A]), signed_word(WORD_OPERAND())); NEXT();
+tix:
+    r[X] = (r[X] + 1) & WORD_MASK;
+    r[SW] = (r[SW] & ~CC_MASK) | condition(signed_word(r[X]), signed_word(WORD_OPERAND()));
+    NEXT();
+addf: f += FLOAT_OPERAND(); NEXT();
+subf: f -= FLOAT_OPERAND(); NEXT();
+mulf: f *= FLOAT_OPERAND(); NEXT();
+divf: {
+    double divisor = FLOAT_OPERAND();
+    if(divisor == 0) goto division_by_zero;
+    f /= divisor;
+    NEXT();
+}
+compf: {
+    double operand = FLOAT_OPERAND();
+    r[SW] = (r[SW] & ~CC_MASK) | (f < operand ? CC_LESS : f > operand ? CC_GREATER : CC_EQUAL);
+    NEXT();
+}
+j:
+    // J * is how a program stops
+    target = d->mode == INDIRECT ? this->load_word(TARGET()) : TARGET();
+    if(target == pc) goto halted;
+    JUMP(target);
+jeq:
+    if((r[SW] & CC_MASK) != CC_EQUAL) NEXT();
+    JUMP(d->mode == INDIRECT ? this->load_word(TARGET()) : TARGET());
+jgt:
+    if((r[SW] & CC_MASK) != CC_GREATER) NEXT();
+    JUMP(d->mode == INDIRECT ? this->load_word(TARGET()) : TARGET());
+jlt:
+    if((r[SW] & CC_MASK) != CC_LESS) NEXT();
+    JUMP(d->mode == INDIRECT ? this->load_word(TARGET()) : TARGET());
+jsub:
+    r[L] = d->next;
+    JUMP(d->mode == INDIRECT ? this->load_word(TARGET()) : TARGET());
+rsub: JUMP(r[L]);
+addr: r[d->r2] = (r[d->r2] + r[d->r1]) & WORD_MASK; NEXT();
+subr: r[d->r2] = (r[d->r2] - r[d->r1]) & WORD_MASK; NEXT();
+mulr: r[d->r2] = (unsigned int)((long long)signed_word(r[d->r2]) * signed_word(r[d->r1])) & WORD_MASK; NEXT();
+divr:
+    if(r[d->r1] == 0) goto division_by_zero;
+    r[d->r2] = (unsigned int)(signed_word(r[d->r2]) / signed_word(r[d->r1])) & WORD_MASK;
+    NEXT();
+compr: r[SW] = (r[SW] & ~CC_MASK) | condition(signed_word(r[d->r1]), signed_word(r[d->r2])); NEXT();
+shiftl: {
+    // circular, the count is encoded minus one
+    unsigned int n = d->r2 + 1;
+    r[d->r1] = ((r[d->r1] << n) | (r[d->r1] >> (24 - n))) & WORD_MASK;
+    NEXT();
+}
+shiftr: r[d->r1] = (unsigned int)(signed_word(r[d->r1]) >> (d->r2 + 1)) & WORD_MASK; NEXT();
+rmo: r[d->r2] = r[d->r1]; NEXT();
+clear: r[d->r1] = 0; NEXT();
+tixr:
+    r[X] = (r[X] + 1) & WORD_MASK;
+    r[SW] = (r[SW] & ~CC_MASK) | condition(signed_word(r[X]), signed_word(r[d->r1]));
+    NEXT();
+float_: f = signed_word(r[A]); NEXT();
+fix: r[A] = (unsigned int)(long long)f & WORD_MASK; NEXT();
+nop: NEXT();
+td:
+    device = this->devices[BYTE_OPERAND()];
+    if(device == nullptr) goto no_device;
+    r[SW] = (r[SW] & ~CC_MASK) | (device->test() ? CC_LESS : CC_EQUAL);
+    NEXT();
+rd:
+    device = this->devices[BYTE_OPERAND()];
+    if(device == nullptr) goto no_device;
+    r[A] = (r[A] & 0xFFFF00) | device->read();
+    NEXT();
+wd:
+    device = this->devices[BYTE_OPERAND()];
+    if(device == nullptr) goto no_device;
+    device->write(r[A] & 0xFF);
+    NEXT();
+svc:
+    // a supervisor call ends the program
+    pc = d->next;
+    goto halted;
+
+    #undef DISPATCH
+    #undef NEXT
+    #undef TARGET
+    #undef EFFECTIVE
+    #undef WORD_OPERAND
+    #undef BYTE_OPERAND
+    #undef FLOAT_OPERAND
+    #undef JUMP
+
+invalid:
+    // nothing of the instruction ran, PC stays on it
+    this->error_flag |= 1;
+    d->executed--;
+    count--;
+    goto halted;
+division_by_zero:
+    this->error_flag |= 2;
+    goto halted;
+no_device:
+    this->error_flag |= 4;
+    goto halted;
+limit_reached:
+    this->error_flag |= 8;
+halted:
+    r[PC] = pc;
+    for(int i = 0; i < 10; i++) this->registers[i] = r[i];
+    this->f = f;
+    this->instructions += count;
+    this->seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return this->error_flag == 0;
+}
+
+unsigned char* Simulator::getMemory() {
+    return this->memory.data();
+}
+
+unsigned int Simulator::getRegister(reg r) const {
+    return this->registers[r];
+}
+
+void Simulator::setRegister(reg r, unsigned int value) {
+    this->registers[r] = value & WORD_MASK;
+}
+
+double Simulator::getF() const {
+    return this->f;
+}
+
+unsigned long long Simulator::getInstructionCount() const {
+    return this->instructions;
+}
+
+unsigned long long Simulator::getCycleCount() const {
+    unsigned long long cycles = this->evicted_cycles + this->scratch.executed * this->scratch.cycles;
+    for(size_t i = 0; i < this->cache.size(); i++) {
+        if(this->cache[i].handler != 0) cycles += this->cache[i].executed * this->cache[i].cycles;
+    }
+    return cycles;
+}
+
+int Simulator::getErrorFlag() {
+    return this->error_flag;
+}
+
+string Simulator::report() const {
+    char line[128];
+    string result;
+    unsigned long long counts[64];
+    vector<int> order;
+
+    for(int i = 0; i < 64; i++) counts[i] = this->evicted[i];
+    for(size_t i = 0; i < this->cache.size(); i++) {
+        const decoded &d = this->cache[i];
+        if(d.handler > 0 && d.handler < INVALID_HANDLER) counts[d.handler - 1] += d.executed;
+    }
+    if(this->scratch.handler > 0 && this->scratch.handler < INVALID_HANDLER) counts[this->scratch.handler - 1] += this->scratch.executed;
+
+    snprintf(line, sizeof(line), "A=%06X X=%06X L=%06X B=%06X S=%06X T=%06X PC=%06X SW=%06X F=%g\n",
+        registers[A], registers[X], registers[L], registers[B], registers[S], registers[T], registers[PC], registers[SW], this->f);
+    result += line;
+    snprintf(line, sizeof(line), "%llu instructions, %llu cycles, %.3f ms, %.1f M instructions/s\n",
+        this->instructions, this->getCycleCount(), this->seconds * 1e3, this->seconds > 0 ? this->instructions / this->seconds / 1e6 : 0.0);
+    result += line;
+
+    for(int i = 0; i < 64; i++) if(counts[i] > 0) order.push_back(i);
+    sort(order.begin(), order.end(), [&counts](int a, int b) { return counts[a] > counts[b]; });
+    for(unsigned int i = 0; i < order.size(); i++) {
+        snprintf(line, sizeof(line), "%-8s %16llu\n", string(opcodes.entries[order[i]]->name).c_str(), counts[order[i]]);
+        result += line;
+    }
+    return result;
+}
+
+double Simulator::fromFloat48(unsigned long long bits) {
+    // sign, 11 bit exponent biased by 1024 and a 36 bit fraction 0.f
+    unsigned long long fraction = bits & ((1ULL << 36) - 1);
+    int exponent = (bits >> 36) & 0x7FF;
+    if(fraction == 0) return 0;
+    double value = ldexp((double)fraction, exponent - 1024 - 36);
+    return (bits >> 47) & 1 ? -value : value;
+}
+
+unsigned long long Simulator::toFloat48(double value) {
+    int exponent;
+    if(value == 0 || !isfinite(value)) return 0;
+    double fraction = frexp(fabs(value), &exponent);
+    exponent += 1024;
+    if(exponent < 0) return 0;
+    if(exponent > 0x7FF) exponent = 0x7FF;
+    unsigned long long bits = (unsigned long long)ldexp(fraction, 36);
+    return (value < 0 ? 1ULL << 47 : 0) | (unsigned long long)exponent << 36 | bits;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include<stream.hpp>
+#include<loader.hpp>
+#include<mnemonic_table.hpp>
+#include<string>
+#include<vector>
+
+using namespace std;
+
+// an I/O device of TD, RD and WD, addressed by a one byte device number
+class Device {
+    public:
+        // TD: true when the device is ready
+        virtual bool test() { return true; }
+        virtual unsigned char read() = 0;
+        virtual void write(unsigned char c) = 0;
+        virtual ~Device() { }
+};
+
+// reads the bytes of a file and writes to the same file, whichever is used first opens it;
+// reading past the end returns 0 like the end of a record
+class FileDevice: public Device {
+    private:
+        string filename;
+        FileInputStream *input;
+        size_t position;
+        FileOutputStream *file;
+        BufferedOutputStream *output;
+    public:
+        FileDevice(string filename);
+        unsigned char read();
+        void write(unsigned char c);
+        ~FileDevice();
+};
+
+// runs SIC/XE machine code from a flat memory image; instructions of the loaded program are
+// decoded once into a cache indexed by address and dispatched through a table of labels
+class Simulator {
+    public:
+        enum reg { A = 0, X = 1, L = 2, B = 3, S = 4, T = 5, F = 6, PC = 8, SW = 9 };
+
+    private:
+        // how a format 3/4 instruction reaches its operand
+        enum addressing : unsigned char { IMMEDIATE, SIMPLE, INDIRECT };
+
+        // one predecoded instruction, 'handler' 0 means not decoded yet
+        struct decoded {
+            unsigned char handler;
+            unsigned char length;
+            unsigned char mode;
+            unsigned char cycles;
+            unsigned char r1; // format 2 operands, SHIFTL/SHIFTR keep the count in 'r2'
+            unsigned char r2;
+            unsigned int x_mask; // all ones if indexed
+            unsigned int b_mask; // all ones if base relative
+            unsigned int address; // target address without X and B
+            unsigned int next;
+            unsigned long long executed;
+        };
+
+        vector<unsigned char> memory;
+        vector<decoded> cache; // one entry per address of the loaded program
+        decoded scratch; // instructions outside of the loaded program are decoded every time
+        unsigned int code_begin;
+        // addresses covered by decoded instructions, only stores in here have to invalidate
+        unsigned int decoded_begin;
+        unsigned int decoded_end;
+        unsigned int registers[10];
+        double f; // F is kept as a double and converted by LDF and STF
+        Device *devices[256];
+        // executions of instructions that left the cache, by opcode
+        unsigned long long evicted[64];
+        unsigned long long evicted_cycles;
+        unsigned long long instructions;
+        double seconds;
+        int error_flag;
+
+        void decode(unsigned int address, decoded &d) const;
+        void invalidate(unsigned int address, unsigned int length);
+        void evict(decoded &d);
+        unsigned int load_word(unsigned int address) const;
+        void store_word(unsigned int address, unsigned int value);
+        void store_byte(unsigned int address, unsigned char value);
+        void start(ObjectLoader &loader);
+
+        static const unsigned int memory_size = 1 << 20;
+        static const unsigned int halt_address = 0xFFFFFF;
+
+    public:
+        Simulator();
+        Simulator(const Simulator &other) = delete;
+        Simulator& operator=(const Simulator &other) = delete;
+
+        // loads an object program and points PC at its entry; the loader keeps the error flag
+        bool load(ObjectLoader &loader, InputStream *object, int load_address = -1);
+        bool loadBinary(ObjectLoader &loader, string_view image, int load_address = -1);
+        // runs until the program returns through the initial L, jumps to itself or executes
+        // SVC; stops after 'limit' instructions if it is not 0
+        // error flags: 1 invalid instruction, 2 division by zero, 4 no such device, 8 limit reached
+        bool run(unsigned long long limit = 0);
+        void attach(unsigned char device, Device *d);
+
+        unsigned char* getMemory();
+        unsigned int getRegister(reg r) const;
+        void setRegister(reg r, unsigned int value);
+        double getF() const;
+        unsigned long long getInstructionCount() const;
+        // every instruction takes a cycle, format 4 one more and every memory operand access one more
+        unsigned long long getCycleCount() const;
+        int getErrorFlag();
+        // registers, counts, speed and the executions of every opcode
+        string report() const;
+
+        static double fromFloat48(unsigned long long bits);
+        static unsigned long long toFloat48(double value);
+};
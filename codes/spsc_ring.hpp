@@ -0,0 +1,82 @@
+#pragma once
+#include<atomic>
+#include<thread>
+#include<utility>
+#include<vector>
+
+using namespace std;
+
+// a bounded lock-free queue between one producer and one consumer thread; items are swapped
+// in and out of the slots, so the buffers of a popped item go back to the producer for reuse
+template<typename T>
+class SpscRing {
+    private:
+        vector<T> slots;
+        size_t mask;
+        // each index is written by one side only and lives on its own cache line
+        alignas(64) atomic<size_t> head; // next slot to pop
+        alignas(64) atomic<size_t> tail; // next slot to push
+        alignas(64) atomic<bool> closed; // the producer is done
+        atomic<bool> cancelled; // the consumer is done
+
+        static void wait(unsigned int &spins) {
+            // spin a little before giving the core away, the other side is usually close behind
+            if(++spins > 64) this_thread::yield();
+        }
+
+    public:
+        // 'capacity' is rounded up to a power of two
+        SpscRing(size_t capacity = 1024): head(0), tail(0), closed(false), cancelled(false) {
+            size_t size = 2;
+            while(size < capacity) size <<= 1;
+            this->slots.resize(size);
+            this->mask = size - 1;
+        }
+        SpscRing(const SpscRing &other) = delete;
+        SpscRing& operator=(const SpscRing &other) = delete;
+
+        bool try_push(T &item) {
+            size_t tail = this->tail.load(memory_order_relaxed);
+            if(tail - this->head.load(memory_order_acquire) > this->mask) return false;
+            swap(this->slots[tail & this->mask], item);
+            this->tail.store(tail + 1, memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T &item) {
+            size_t head = this->head.load(memory_order_relaxed);
+            if(head == this->tail.load(memory_order_acquire)) return false;
+            swap(this->slots[head & this->mask], item);
+            this->head.store(head + 1, memory_order_release);
+            return true;
+        }
+
+        // waits for a free slot, false if the consumer cancelled
+        bool push(T &item) {
+            unsigned int spins = 0;
+            while(!this->try_push(item)) {
+                if(this->cancelled.load(memory_order_relaxed)) return false;
+                wait(spins);
+            }
+            return true;
+        }
+
+        // waits for an item, false once the producer closed the ring and it ran empty
+        bool pop(T &item) {
+            unsigned int spins = 0;
+            while(!this->try_pop(item)) {
+                // items pushed before close are still seen after it
+                if(this->closed.load(memory_order_acquire)) return this->try_pop(item);
+                wait(spins);
+            }
+            return true;
+        }
+
+        void close() {
+            this->closed.store(true, memory_order_release);
+        }
+
+        void cancel() {
+            this->cancelled.store(true, memory_order_relaxed);
+        }
+};
@@ -0,0 +1,163 @@
+#include "stats.hpp"
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<ctime>
+#include<new>
+
+thread_local Stats::block *Stats::local = nullptr;
+thread_local bool Stats::ended = false;
+atomic<Stats::block*> Stats::blocks(nullptr);
+atomic<Stats::block*> Stats::shared(nullptr);
+
+#if STATS
+// the timer running on this thread, timers nest like the scopes they live in
+static thread_local Stats::Timer *active = nullptr;
+
+static long long wall_clock() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static long long cpu_clock() {
+    // cpu time of the whole process, a phase that runs on the thread pool shows more cpu than wall time
+#ifdef _WIN32
+    return (long long)clock() * (1000000000LL / CLOCKS_PER_SEC);
+#else
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+Stats::block* Stats::attach() {
+    // blocks are never freed, so the report still sees what ended threads counted, but a
+    // block whose thread ended is taken over by the next one, so a server that starts a
+    // thread per connection keeps as many blocks as it ever had threads at once; malloc
+    // keeps the allocation counter from counting itself
+    if(ended) {
+        // counted while the thread's own thread_local objects are destroyed, which is rare
+        // enough for one block kept for all of them, where two such adds at once may lose one
+        block *b = shared.load();
+        if(b == nullptr) {
+            b = new(malloc(sizeof(block))) block();
+            b->used.store(true);
+            block *expected = nullptr;
+            if(!shared.compare_exchange_strong(expected, b)) {
+                free(b);
+                return expected;
+            }
+            b->next = blocks.load();
+            while(!blocks.compare_exchange_weak(b->next, b));
+        }
+        return b;
+    }
+
+    static thread_local owner releaser;
+    (void)releaser;
+    for(block *b = blocks.load(); b != nullptr; b = b->next) {
+        // acquire, so what the thread that ended counted last is not overwritten
+        bool expected = false;
+        if(!b->used.load(memory_order_relaxed) && b->used.compare_exchange_strong(expected, true, memory_order_acquire)) {
+            local = b;
+            return b;
+        }
+    }
+    block *b = new(malloc(sizeof(block))) block();
+    b->used.store(true, memory_order_relaxed);
+    b->next = blocks.load();
+    while(!blocks.compare_exchange_weak(b->next, b));
+    local = b;
+    return b;
+}
+
+Stats::owner::~owner() {
+    if(local != nullptr) local->used.store(false, memory_order_release);
+    local = nullptr;
+    ended = true;
+}
+
+Stats::Timer::Timer(phase p): p(p), outer(active) {
+    this->wall_start = wall_clock();
+    this->cpu_start = cpu_clock();
+    if(this->outer != nullptr) this->outer->charge(this->wall_start, this->cpu_start);
+    active = this;
+}
+
+Stats::Timer::~Timer() {
+    long long wall = wall_clock(), cpu = cpu_clock();
+    this->charge(wall, cpu);
+    active = this->outer;
+    if(this->outer != nullptr) {
+        this->outer->wall_start = wall;
+        this->outer->cpu_start = cpu;
+    }
+}
+
+void Stats::Timer::charge(long long wall, long long cpu) {
+    block *b = local != nullptr ? local : attach();
+    add(b->wall[this->p], wall - this->wall_start);
+    add(b->cpu[this->p], max(cpu - this->cpu_start, 0LL));
+}
+#endif
+
+unsigned long long Stats::get(counter c) {
+    unsigned long long total = 0;
+    for(block *b = blocks.load(); b != nullptr; b = b->next) total += b->counters[c].load(memory_order_relaxed);
+    return total;
+}
+
+double Stats::getWallTime(phase p) {
+    unsigned long long total = 0;
+    for(block *b = blocks.load(); b != nullptr; b = b->next) total += b->wall[p].load(memory_order_relaxed);
+    return total / 1e9;
+}
+
+double Stats::getCpuTime(phase p) {
+    unsigned long long total = 0;
+    for(block *b = blocks.load(); b != nullptr; b = b->next) total += b->cpu[p].load(memory_order_relaxed);
+    return total / 1e9;
+}
+
+void Stats::reset() {
+    for(block *b = blocks.load(); b != nullptr; b = b->next) {
+        for(int i = 0; i < COUNTERS; i++) b->counters[i].store(0, memory_order_relaxed);
+        for(int i = 0; i < PHASES; i++) {
+            b->wall[i].store(0, memory_order_relaxed);
+            b->cpu[i].store(0, memory_order_relaxed);
+        }
+    }
+}
+
+const char* Stats::getName(phase p) {
+    static const char *names[PHASES] = {"read", "pass1", "relax", "pass2", "text_records", "output"};
+    return names[p];
+}
+
+const char* Stats::getName(counter c) {
+    static const char *names[COUNTERS] = {"lines", "comments", "symbol_lookups", "t_records", "m_records", "bytes_written", "allocations", "relaxed"};
+    return names[c];
+}
+
+string Stats::report(bool json) {
+    char line[128];
+    string result;
+    if(!STATS) return json ? "{\"enabled\":false}\n" : "statistics were compiled out\n";
+
+    // times in milliseconds
+    result = json ? "{\"enabled\":true,\"phases\":{" : "phase               wall ms      cpu ms\n";
+    for(int i = 0; i < PHASES; i++) {
+        phase p = (phase)i;
+        if(json) snprintf(line, sizeof(line), "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", i > 0 ? "," : "", getName(p), getWallTime(p) * 1e3, getCpuTime(p) * 1e3);
+        else snprintf(line, sizeof(line), "%-14s %12.3f %11.3f\n", getName(p), getWallTime(p) * 1e3, getCpuTime(p) * 1e3);
+        result += line;
+    }
+    result += json ? "},\"counters\":{" : "\ncounter                    value\n";
+    for(int i = 0; i < COUNTERS; i++) {
+        counter c = (counter)i;
+        if(json) snprintf(line, sizeof(line), "%s\"%s\":%llu", i > 0 ? "," : "", getName(c), get(c));
+        else snprintf(line, sizeof(line), "%-14s %17llu\n", getName(c), get(c));
+        result += line;
+    }
+    if(json) result += "}}\n";
+    return result;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include<atomic>
+#include<string>
+
+using namespace std;
+
+// build with -DSTATS=false to compile every counter and timer out
+#ifndef STATS
+#define STATS true
+#endif
+
+// process wide performance counters and phase timers; every thread counts into a block
+// of its own, so counting is a plain add and nothing is shared until the report sums them;
+// a thread that ends leaves its block to the next thread that starts counting
+class Stats {
+    public:
+        enum phase { READ, PASS1, RELAX, PASS2, TEXT_RECORDS, OUTPUT, PHASES };
+        // ALLOCATIONS counts in programs that link allocations.cpp, the shared library does not
+        enum counter { LINES, COMMENTS, SYMBOL_LOOKUPS, T_RECORDS, M_RECORDS, BYTES_WRITTEN, ALLOCATIONS, RELAXED, COUNTERS };
+
+        // charges the wall and process cpu time of its scope to a phase; a timer started
+        // inside another one on the same thread pauses it, so phases never count time twice
+        class Timer {
+#if STATS
+            private:
+                phase p;
+                long long wall_start;
+                long long cpu_start;
+                Timer *outer;
+
+                void charge(long long wall, long long cpu);
+#endif
+            public:
+                Timer(phase p);
+                Timer(const Timer &other) = delete;
+                Timer& operator=(const Timer &other) = delete;
+                ~Timer();
+        };
+
+    private:
+        struct block {
+            atomic<unsigned long long> counters[COUNTERS];
+            atomic<unsigned long long> wall[PHASES]; // nanoseconds
+            atomic<unsigned long long> cpu[PHASES];
+            atomic<bool> used; // a thread counts into it, false once that thread ended
+            block *next;
+        };
+
+        // gives the block of a thread back when the thread ends
+        struct owner {
+            ~owner();
+        };
+
+        static thread_local block *local;
+        static thread_local bool ended;
+        static atomic<block*> blocks;
+        static atomic<block*> shared;
+        static block* attach();
+        static void add(atomic<unsigned long long> &value, unsigned long long n);
+
+    public:
+        static void count(counter c, unsigned long long n = 1);
+        static unsigned long long get(counter c);
+        // seconds spent in 'p' so far
+        static double getWallTime(phase p);
+        static double getCpuTime(phase p);
+        static void reset();
+        // a table, or one JSON object if 'json' is set
+        static string report(bool json = false);
+
+        static const char* getName(phase p);
+        static const char* getName(counter c);
+};
+
+inline void Stats::count(counter c, unsigned long long n) {
+#if STATS
+    block *b = local != nullptr ? local : attach();
+    add(b->counters[c], n);
+#endif
+}
+
+inline void Stats::add(atomic<unsigned long long> &value, unsigned long long n) {
+    // only the owning thread writes a block, the report may read it at any time
+    value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+#if !STATS
+inline Stats::Timer::Timer(phase p) { }
+inline Stats::Timer::~Timer() { }
+#endif
@@ -1,36 +1,181 @@
 #include "stream.hpp"
+#include "stats.hpp"
+#include<cstring>
+#include<iterator>
+#ifndef _WIN32
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
 
-FileInputStream::FileInputStream(string filename) {
-    file.open(filename);
+MemoryInputStream::MemoryInputStream(string_view contents): data(contents.data()), size(contents.length()), position(0), end_of_file(false) { }
+
+string MemoryInputStream::readline() {
+    return string(readline_view());
 }
 
-string FileInputStream::readline() {
-    string s;
-    getline(file, s);
-    return s;
+string_view MemoryInputStream::readline_view() {
+    // same semantics as getline: eof is set once a read reaches the end without a newline;
+    // the buffer holds the bytes of the file, so the '\r' of a CRLF line end is dropped here,
+    // where a text mode stream would have done it
+    if(position >= size) {
+        end_of_file = true;
+        return string_view();
+    }
+
+    const char *begin = data + position;
+    const char *end = (const char*)memchr(begin, '\n', size - position);
+    if(end == nullptr) {
+        end_of_file = true;
+        position = size;
+        end = data + size;
+    } else {
+        position = end - data + 1;
+    }
+    if(end > begin && end[-1] == '\r') end--;
+    return string_view(begin, end - begin);
+}
+
+bool MemoryInputStream::eof() {
+    return end_of_file;
 }
 
-bool FileInputStream::eof() {
-    return file.eof();
+bool MemoryInputStream::isBuffered() const {
+    return true;
+}
+
+string_view MemoryInputStream::getContents() const {
+    return string_view(data, size);
+}
+
+FileInputStream::FileInputStream(string filename) {
+    // a mapped file is paged in while pass 1 reads it, that time counts as pass 1
+    Stats::Timer timer(Stats::READ);
+#ifdef _WIN32
+    ifstream file(filename, ios_base::binary);
+    contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    data = contents.data();
+    size = contents.length();
+#else
+    struct stat info;
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return;
+    if(fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped != MAP_FAILED) {
+            madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+            data = (const char*)mapped;
+            size = info.st_size;
+        }
+    }
+    close(fd);
+#endif
 }
 
 FileInputStream::~FileInputStream() {
-    file.close();
+#ifndef _WIN32
+    if(data != nullptr) munmap((void*)data, size);
+#endif
 }
 
-FileOutputStream::FileOutputStream(string filename) {
-    file.open(filename);
+FileOutputStream::FileOutputStream(string filename, bool binary) {
+    file.open(filename, binary ? ios::out | ios::binary : ios::out);
 }
 
 void FileOutputStream::write(string s) {
+    Stats::count(Stats::BYTES_WRITTEN, s.length());
     file.write(s.c_str(), s.length());
     file.flush();
 }
 
+void FileOutputStream::flush() {
+    file.flush();
+}
+
+bool FileOutputStream::tell(size_t &position) {
+    streampos p = file.tellp();
+    if(p < 0) return false;
+    position = p;
+    return true;
+}
+
+bool FileOutputStream::rewrite(size_t position, string_view bytes) {
+    // back to the end afterwards, so writing goes on where it was
+    streampos end = file.tellp();
+    if(end < 0 || !file.seekp(position)) {
+        file.clear();
+        return false;
+    }
+    file.write(bytes.data(), bytes.length());
+    file.seekp(end);
+    file.flush();
+    return file.good();
+}
+
+bool FileOutputStream::good() const {
+    return file.good();
+}
+
 FileOutputStream::~FileOutputStream() {
     file.close();
 }
 
+BufferedOutputStream::BufferedOutputStream(OutputStream *target, size_t buffer_size, int policy): target(target), buffer_size(buffer_size), policy(policy) {
+    buffer.reserve(buffer_size);
+}
+
+void BufferedOutputStream::append(const char *data, size_t length) {
+    if((policy & FLUSH_ON_THRESHOLD) && buffer.length() + length > buffer_size) {
+        flush();
+        if(length >= buffer_size) { // too large to be worth buffering
+            Stats::Timer timer(Stats::OUTPUT);
+            target->write(string(data, length));
+            return;
+        }
+    }
+    buffer.append(data, length);
+}
+
+void BufferedOutputStream::write(string s) {
+    append(s.c_str(), s.length());
+}
+
+void BufferedOutputStream::write_batch(const string_view *fragments, size_t count) {
+    for(size_t i = 0; i < count; i++) append(fragments[i].data(), fragments[i].length());
+}
+
+void BufferedOutputStream::flush() {
+    Stats::Timer timer(Stats::OUTPUT);
+    if(buffer.length() > 0) {
+        target->write(buffer);
+        buffer.clear();
+    }
+    target->flush();
+}
+
+bool BufferedOutputStream::tell(size_t &position) {
+    if(!target->tell(position)) return false;
+    position += buffer.length();
+    return true;
+}
+
+bool BufferedOutputStream::rewrite(size_t position, string_view bytes) {
+    size_t flushed;
+    if(!target->tell(flushed)) return false;
+    if(position >= flushed && position - flushed + bytes.length() <= buffer.length()) {
+        // still in the buffer
+        buffer.replace(position - flushed, bytes.length(), bytes.data(), bytes.length());
+        return true;
+    }
+    flush();
+    return target->rewrite(position, bytes);
+}
+
+BufferedOutputStream::~BufferedOutputStream() {
+    if(policy & FLUSH_ON_DESTROY) flush();
+}
+
 ConsoleInputStream::ConsoleInputStream(istream &console): console(console) { }
 
 string ConsoleInputStream::readline() {
@@ -46,7 +191,40 @@ bool ConsoleInputStream::eof() {
 ConsoleOutputStream::ConsoleOutputStream(ostream &console): console(console) { }
 
 void ConsoleOutputStream::write(string s) {
+    Stats::count(Stats::BYTES_WRITTEN, s.length());
     console << s;
 }
 
+void ConsoleOutputStream::flush() {
+    Stats::Timer timer(Stats::OUTPUT);
+    console.flush();
+}
+
+void StringOutputStream::write(string s) {
+    contents += s;
+}
+
+void StringOutputStream::write_batch(const string_view *fragments, size_t count) {
+    for(size_t i = 0; i < count; i++) contents.append(fragments[i]);
+}
+
+bool StringOutputStream::tell(size_t &position) {
+    position = contents.length();
+    return true;
+}
+
+bool StringOutputStream::rewrite(size_t position, string_view bytes) {
+    if(position + bytes.length() > contents.length()) return false;
+    contents.replace(position, bytes.length(), bytes.data(), bytes.length());
+    return true;
+}
+
+const string& StringOutputStream::getString() const {
+    return contents;
+}
+
+void StringOutputStream::clear() {
+    contents.clear();
+}
+
 void NoneOutputStream::write(string s) { }
\ No newline at end of file
@@ -1,16 +1,34 @@
+#pragma once
 #include<stream_interface.hpp>
 #include<fstream>
 #include<iostream>
 
 using namespace std;
 
-class FileInputStream: public InputStream {
-    private:
-        ifstream file;
+// hands out lines of a buffer owned by someone else without copying them
+class MemoryInputStream: public InputStream {
+    protected:
+        const char *data;
+        size_t size;
+        size_t position;
+        bool end_of_file;
     public:
-        FileInputStream(string filename);
+        MemoryInputStream(string_view contents = string_view());
         string readline();
+        string_view readline_view();
         bool eof();
+        bool isBuffered() const;
+        string_view getContents() const;
+};
+
+// maps the whole file into memory and reads it as a MemoryInputStream
+class FileInputStream: public MemoryInputStream {
+#ifdef _WIN32
+    private:
+        string contents;
+#endif
+    public:
+        FileInputStream(string filename);
         ~FileInputStream();
 };
 
@@ -18,11 +36,42 @@ class FileOutputStream: public OutputStream {
     private:
         ofstream file;
     public:
-        FileOutputStream(string filename);
+        // 'binary' keeps every byte as it is, text files get the platform's line endings
+        FileOutputStream(string filename, bool binary = false);
         void write(string s);
+        void flush();
+        bool tell(size_t &position);
+        bool rewrite(size_t position, string_view bytes);
+        // false if the file did not open or a write to it failed
+        bool good() const;
         ~FileOutputStream();
 };
 
+class BufferedOutputStream: public OutputStream {
+    public:
+        // flush policy flags, flush() can always be called explicitly
+        enum flush_policy {
+            FLUSH_EXPLICIT = 0,
+            FLUSH_ON_DESTROY = 1,
+            FLUSH_ON_THRESHOLD = 2,
+            FLUSH_DEFAULT = FLUSH_ON_DESTROY | FLUSH_ON_THRESHOLD
+        };
+    private:
+        OutputStream *target;
+        string buffer;
+        size_t buffer_size;
+        int policy;
+        void append(const char *data, size_t length);
+    public:
+        BufferedOutputStream(OutputStream *target, size_t buffer_size = 1 << 16, int policy = FLUSH_DEFAULT);
+        void write(string s);
+        void write_batch(const string_view *fragments, size_t count);
+        void flush();
+        bool tell(size_t &position);
+        bool rewrite(size_t position, string_view bytes);
+        ~BufferedOutputStream();
+};
+
 class ConsoleInputStream: public InputStream {
     private:
         istream &console;
@@ -38,6 +87,20 @@ class ConsoleOutputStream: public OutputStream {
     public:
         ConsoleOutputStream(ostream &console);
         void write(string s);
+        void flush();
+};
+
+// collects everything written in memory
+class StringOutputStream: public OutputStream {
+    private:
+        string contents;
+    public:
+        void write(string s);
+        void write_batch(const string_view *fragments, size_t count);
+        bool tell(size_t &position);
+        bool rewrite(size_t position, string_view bytes);
+        const string& getString() const;
+        void clear();
 };
 
 class NoneOutputStream: public OutputStream {
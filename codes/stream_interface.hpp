@@ -1,14 +1,43 @@
+#pragma once
 #include<string>
+#include<string_view>
+#include<initializer_list>
 
 using namespace std;
 
 class InputStream {
+    protected:
+        string line_buffer;
     public:
         virtual string readline() = 0;
+        // the view is valid until the next read, mapped streams keep it valid while they are open
+        virtual string_view readline_view() {
+            this->line_buffer = this->readline();
+            return this->line_buffer;
+        }
         virtual bool eof() = 0;
+        // true if the whole input already is one buffer in memory, a mapped file or a string,
+        // which getContents() then hands out without copying; streams read as they go are not
+        virtual bool isBuffered() const { return false; }
+        virtual string_view getContents() const { return string_view(); }
+        virtual ~InputStream() { }
 };
 
 class OutputStream {
     public:
         virtual void write(string s) = 0;
+        // write many fragments at once, implementations may avoid joining them
+        virtual void write_batch(const string_view *fragments, size_t count) {
+            for(size_t i = 0; i < count; i++) this->write(string(fragments[i]));
+        }
+        void write_batch(initializer_list<string_view> fragments) {
+            this->write_batch(fragments.begin(), fragments.size());
+        }
+        virtual void flush() { }
+        // for streams that can go back over what they wrote, like files: 'position' is where the
+        // next write goes, rewrite() overwrites bytes written before; both are false on streams
+        // that cannot seek, like the console or a pipe
+        virtual bool tell(size_t &) { return false; }
+        virtual bool rewrite(size_t, string_view) { return false; }
+        virtual ~OutputStream() { }
 };
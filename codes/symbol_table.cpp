@@ -0,0 +1,134 @@
+#include "symbol_table.hpp"
+#include "stats.hpp"
+#include<cstring>
+
+SymbolTable::SymbolTable() {
+    this->clear();
+}
+
+unsigned int SymbolTable::hash(string_view name) {
+    unsigned int h = 0x811C9DC5u;
+    for(size_t i = 0; i < name.length(); i++) h = (h ^ (unsigned char)name[i]) * 0x01000193u;
+    return h;
+}
+
+unsigned int SymbolTable::probe(string_view name, unsigned int h) const {
+    // linear probing, stops at the name or at the empty slot it would go into
+    unsigned int mask = this->slots.size() - 1;
+    for(unsigned int i = h & mask;; i = (i + 1) & mask) {
+        const slot &s = this->slots[i];
+        if(s.id < 0 || (s.hash == h && this->names[s.id] == name)) return i;
+    }
+}
+
+string_view SymbolTable::store(string_view name) {
+    // names are never freed one by one, so they are packed into large blocks
+    if(name.length() > block_size / 4) {
+        this->blocks.insert(this->blocks.begin(), unique_ptr<char[]>(new char[name.length()]));
+        memcpy(this->blocks.front().get(), name.data(), name.length());
+        return string_view(this->blocks.front().get(), name.length());
+    }
+    if(this->blocks.empty() || this->block_used + name.length() > block_size) {
+        this->blocks.push_back(unique_ptr<char[]>(new char[block_size]));
+        this->block_used = 0;
+    }
+    char *copy = this->blocks.back().get() + this->block_used;
+    memcpy(copy, name.data(), name.length());
+    this->block_used += name.length();
+    return string_view(copy, name.length());
+}
+
+void SymbolTable::grow() {
+    vector<slot> old;
+    old.swap(this->slots);
+    this->slots.assign(old.size() * 2, slot{0, -1});
+
+    unsigned int mask = this->slots.size() - 1;
+    for(size_t i = 0; i < old.size(); i++) {
+        if(old[i].id < 0) continue;
+        unsigned int j = old[i].hash & mask;
+        while(this->slots[j].id >= 0) j = (j + 1) & mask;
+        this->slots[j] = old[i];
+    }
+}
+
+int SymbolTable::intern(string_view name) {
+    Stats::count(Stats::SYMBOL_LOOKUPS);
+    unsigned int h = hash(name);
+    unsigned int i = this->probe(name, h);
+    if(this->slots[i].id >= 0) return this->slots[i].id;
+
+    // keep the table at most half full
+    if(2 * (this->names.size() + 1) > this->slots.size()) {
+        this->grow();
+        i = this->probe(name, h);
+    }
+    int id = this->names.size();
+    this->names.push_back(this->store(name));
+    this->values.push_back(0);
+    this->defined.push_back(false);
+    this->external.push_back(false);
+    this->absolute.push_back(false);
+    this->slots[i] = slot{h, id};
+    return id;
+}
+
+int SymbolTable::find(string_view name) const {
+    Stats::count(Stats::SYMBOL_LOOKUPS);
+    return this->slots[this->probe(name, hash(name))].id;
+}
+
+void SymbolTable::define(int id, int value, bool absolute) {
+    this->values[id] = value;
+    this->defined[id] = true;
+    this->absolute[id] = absolute;
+}
+
+void SymbolTable::undefine(int id) {
+    this->defined[id] = false;
+}
+
+void SymbolTable::shift(int from, int delta) {
+    for(size_t id = 0; id < this->values.size(); id++) {
+        if(this->defined[id] && !this->absolute[id] && !this->external[id] && this->values[id] >= from) this->values[id] += delta;
+    }
+}
+
+bool SymbolTable::isDefined(int id) const {
+    return id >= 0 && this->defined[id];
+}
+
+void SymbolTable::makeExternal(int id) {
+    this->external[id] = true;
+}
+
+bool SymbolTable::isExternal(int id) const {
+    return id >= 0 && this->external[id];
+}
+
+bool SymbolTable::isAbsolute(int id) const {
+    return id >= 0 && this->absolute[id];
+}
+
+int SymbolTable::getValue(int id) const {
+    return this->values[id];
+}
+
+string_view SymbolTable::getName(int id) const {
+    return this->names[id];
+}
+
+int SymbolTable::size() const {
+    return this->names.size();
+}
+
+void SymbolTable::clear() {
+    this->blocks.clear();
+    this->block_used = 0;
+    this->names.clear();
+    this->values.clear();
+    this->defined.clear();
+    this->external.clear();
+    this->absolute.clear();
+    this->slots.assign(64, slot{0, -1});
+}
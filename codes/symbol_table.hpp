@@ -0,0 +1,57 @@
+#pragma once
+#include<memory>
+#include<string>
+#include<string_view>
+#include<vector>
+
+using namespace std;
+
+// interns symbol names into an arena and hands out dense ids; names are found through
+// an open addressing table that keeps every name's hash, values are indexed by id
+class SymbolTable {
+    struct slot {
+        unsigned int hash;
+        int id; // -1 if the slot is empty
+    };
+
+    private:
+        vector<unique_ptr<char[]> > blocks;
+        size_t block_used;
+        vector<string_view> names;
+        vector<int> values;
+        vector<bool> defined;
+        vector<bool> external;
+        vector<bool> absolute;
+        vector<slot> slots;
+
+        static const size_t block_size = 1 << 16;
+        static unsigned int hash(string_view name);
+        unsigned int probe(string_view name, unsigned int h) const;
+        string_view store(string_view name);
+        void grow();
+
+    public:
+        SymbolTable();
+        SymbolTable(const SymbolTable &other) = delete;
+        SymbolTable& operator=(const SymbolTable &other) = delete;
+
+        // id of 'name', added undefined if it is new
+        int intern(string_view name);
+        // id of 'name', -1 if it was never interned
+        int find(string_view name) const;
+        // labels are relative, they move with the program; EQU may define absolute symbols
+        void define(int id, int value, bool absolute = false);
+        void undefine(int id);
+        // moves the relative symbols whose value is 'from' or more by 'delta'
+        void shift(int from, int delta);
+        bool isDefined(int id) const;
+        // named by EXTREF, the value comes from another control section at link time
+        void makeExternal(int id);
+        bool isExternal(int id) const;
+        bool isAbsolute(int id) const;
+        int getValue(int id) const;
+        string_view getName(int id) const;
+        // number of ids handed out, defined or not
+        int size() const;
+        void clear();
+};
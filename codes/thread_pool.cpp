@@ -0,0 +1,86 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(unsigned int threads): next_queue(0), queued(0), stopping(false) {
+    if(threads == 0) threads = 1;
+    for(unsigned int i = 0; i < threads; i++) queues.push_back(make_unique<worker_queue>());
+    for(unsigned int i = 0; i < threads; i++) workers.emplace_back(&ThreadPool::worker_loop, this, i);
+}
+
+bool ThreadPool::pop(unsigned int index, task &t) {
+    worker_queue &queue = *queues[index];
+    lock_guard<mutex> guard(queue.lock);
+    if(queue.tasks.empty()) return false;
+    t = move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned int index, task &t) {
+    for(unsigned int i = 1; i < queues.size(); i++) {
+        worker_queue &queue = *queues[(index + i) % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+        if(queue.tasks.empty()) continue;
+        t = move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::try_run(unsigned int index) {
+    task t;
+    if(!pop(index, t) && !steal(index, t)) return false;
+    queued--;
+    t.run();
+    t.group->pending--;
+    return true;
+}
+
+void ThreadPool::worker_loop(unsigned int index) {
+    while(true) {
+        if(try_run(index)) continue;
+
+        unique_lock<mutex> guard(sleep_lock);
+        wake.wait(guard, [this] { return stopping || queued > 0; });
+        if(stopping && queued == 0) return;
+    }
+}
+
+void ThreadPool::submit(TaskGroup &group, function<void()> run) {
+    unsigned int index = next_queue++ % queues.size();
+    group.pending++;
+    {
+        lock_guard<mutex> guard(queues[index]->lock);
+        queues[index]->tasks.push_back({move(run), &group});
+    }
+    {
+        lock_guard<mutex> guard(sleep_lock);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup &group) {
+    unsigned int index = next_queue % queues.size();
+    while(group.pending > 0) {
+        if(!try_run(index)) this_thread::yield();
+    }
+}
+
+unsigned int ThreadPool::size() const {
+    return workers.size();
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(unsigned int i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include<atomic>
+#include<condition_variable>
+#include<deque>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+using namespace std;
+
+// counts the unfinished tasks of one caller so it can wait for just its own work
+class TaskGroup {
+    friend class ThreadPool;
+    private:
+        atomic<int> pending;
+    public:
+        TaskGroup(): pending(0) { }
+};
+
+// every worker owns a deque, runs its own tasks newest first and steals the
+// oldest task of another worker when it runs dry
+class ThreadPool {
+    struct task {
+        function<void()> run;
+        TaskGroup *group;
+    };
+
+    struct worker_queue {
+        mutex lock;
+        deque<task> tasks;
+    };
+
+    private:
+        vector<unique_ptr<worker_queue>> queues;
+        vector<thread> workers;
+        atomic<unsigned int> next_queue;
+        atomic<int> queued;
+        mutex sleep_lock;
+        condition_variable wake;
+        bool stopping;
+
+        bool pop(unsigned int index, task &t);
+        bool steal(unsigned int index, task &t);
+        bool try_run(unsigned int index);
+        void worker_loop(unsigned int index);
+
+    public:
+        ThreadPool(unsigned int threads = thread::hardware_concurrency());
+        void submit(TaskGroup &group, function<void()> run);
+        // runs queued tasks on the calling thread until every task of 'group' is done
+        void wait(TaskGroup &group);
+        unsigned int size() const;
+        ~ThreadPool();
+
+        static ThreadPool& shared();
+};
@@ -0,0 +1,114 @@
+#include "tokenizer.hpp"
+#if defined(__SSE2__) || defined(__x86_64__)
+#include<immintrin.h>
+#define TOKENIZER_SSE2 true
+#endif
+
+#ifdef TOKENIZER_SSE2
+// bit i is set when byte i of the 16 at 'data' is a space or a tab
+static inline unsigned int space_mask(const char *data) {
+    __m128i bytes = _mm_loadu_si128((const __m128i*)data);
+    __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+    return _mm_movemask_epi8(spaces);
+}
+#endif
+
+size_t find_space(string_view line, size_t from) {
+    size_t i = from;
+#ifdef TOKENIZER_SSE2
+    // never loads past the end of the line, mapped files may end at a page boundary
+    for(; i + 16 <= line.length(); i += 16) {
+        unsigned int mask = space_mask(line.data() + i);
+        if(mask != 0) return i + __builtin_ctz(mask);
+    }
+#endif
+    for(; i < line.length(); i++) {
+        if(line[i] == ' ' || line[i] == '\t') return i;
+    }
+    return line.length();
+}
+
+size_t skip_space(string_view line, size_t from) {
+    size_t i = from;
+#ifdef TOKENIZER_SSE2
+    for(; i + 16 <= line.length(); i += 16) {
+        unsigned int mask = ~space_mask(line.data() + i) & 0xFFFF;
+        if(mask != 0) return i + __builtin_ctz(mask);
+    }
+#endif
+    for(; i < line.length(); i++) {
+        if(line[i] != ' ' && line[i] != '\t') return i;
+    }
+    return line.length();
+}
+
+// the mnemonic if 'token' can stand without a label or without an operand
+static const mnemonic* operation(string_view token) {
+    const mnemonic *entry = MnemonicTable::find(token);
+    if(entry == nullptr) return nullptr;
+    switch(entry->directive) {
+        case mnemonic::INSTRUCTION:
+        case mnemonic::START:
+        case mnemonic::END:
+        case mnemonic::BASE:
+        case mnemonic::NOBASE:
+        case mnemonic::LTORG:
+        case mnemonic::CSECT:
+        case mnemonic::EXTDEF:
+        case mnemonic::EXTREF:
+        case mnemonic::ORG:
+            return entry;
+        default:
+            return nullptr;
+    }
+}
+
+bool tokenize_line(string_view line, source_tokens &tokens) {
+    string_view found[3];
+    int count = 0;
+    size_t position, end;
+
+    while(line.length() > 0 && line.back() == '\t') line.remove_suffix(1);
+
+    // two whitespace separated tokens, the operand starts right after the second one's separator
+    position = skip_space(line, 0);
+    while(count < 2 && position < line.length()) {
+        end = find_space(line, position);
+        found[count++] = line.substr(position, end - position);
+        position = end == line.length() ? end : count < 2 ? skip_space(line, end + 1) : end + 1;
+    }
+    if(count == 2 && position < line.length()) {
+        string_view operand = line.substr(position);
+        while(operand.length() > 0 && operand.front() == ' ') operand.remove_prefix(1);
+        while(operand.length() > 0 && operand.back() == ' ') operand.remove_suffix(1);
+        if(operand.length() > 0) found[count++] = operand;
+    }
+
+    tokens.label = tokens.operand = string_view();
+    tokens.entry = nullptr;
+    if(count == 0) return false;
+    if(count == 1) {
+        tokens.opcode = found[0];
+    } else if(count == 2) {
+        // "OPCODE OPERAND" is far more common than "LABEL OPCODE", so it is probed first
+        if((tokens.entry = operation(found[0])) != nullptr) {
+            tokens.opcode = found[0];
+            tokens.operand = found[1];
+        } else if((tokens.entry = operation(found[1])) != nullptr) {
+            tokens.label = found[0];
+            tokens.opcode = found[1];
+        } else return false;
+    } else {
+        tokens.label = found[0];
+        tokens.opcode = found[1];
+        tokens.operand = found[2];
+    }
+    if(count != 2) tokens.entry = MnemonicTable::find(tokens.opcode);
+
+    // no mnemonic is that long, such an opcode is left as it is
+    if(tokens.opcode.length() < sizeof(tokens.folded)) {
+        for(size_t i = 0; i < tokens.opcode.length(); i++) tokens.folded[i] = MnemonicHash::fold(tokens.opcode[i]);
+        tokens.opcode = string_view(tokens.folded, tokens.opcode.length());
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include<mnemonic_table.hpp>
+#include<string>
+#include<string_view>
+
+using namespace std;
+
+// label, opcode and operand of a source line as views into the line, except the opcode:
+// it points into 'folded', an upper case copy, unless it is too long to be a mnemonic
+struct source_tokens {
+    string_view label;
+    string_view opcode;
+    string_view operand;
+    const mnemonic *entry; // table entry of the opcode, nullptr if it has none
+    char folded[16];
+};
+
+// a line split into owned fields, as the reader hands it to pass 1; comment lines keep their
+// text in 'operand' and so do lines that could not be split
+struct source_line {
+    bool comment;
+    bool valid; // false if a line that is not a comment could not be split
+    string label;
+    string opcode;
+    string operand;
+};
+
+// splits 'line' the way parse_input_line always has: trailing tabs are dropped, the first
+// two tokens end at a space or tab and the operand is the rest of the line without the
+// spaces around it; false if there is no token, or two tokens and neither is an operation
+bool tokenize_line(string_view line, source_tokens &tokens);
+// first space or tab at or after 'from', line.length() if there is none
+size_t find_space(string_view line, size_t from);
+// first character at or after 'from' that is not a space or tab, line.length() if there is none
+size_t skip_space(string_view line, size_t from);